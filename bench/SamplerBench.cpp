@@ -0,0 +1,379 @@
+// Console benchmarks for the sampler engine. Each section drives the engine
+// through its public API, the way the plugin does, and prints one table.
+//
+//   SamplerBench [--kit-mb=N] [section ...]
+//
+// Without a section every section runs. --kit-mb sets the size of the
+// storage section's kit, counted as float32 (2048 by default).
+
+#include <JuceHeader.h>
+#include <algorithm>
+#include <cstdio>
+#include <functional>
+#include <vector>
+#include "ParallelDecoder.h"
+#include "SamplePool.h"
+#include "SamplerEngine.h"
+#include "TestFixtures.h"
+
+namespace
+{
+    constexpr double sampleRate = 48000.0;
+    constexpr int blockSize = 256;
+
+    // Size of the storage section's kit as float32, set by --kit-mb
+    int kitMegabytes = 2048;
+
+    // Writes a 16-bit stereo test file of TestFixtures::fillSines, a WAV
+    // unless another format is given. Every file goes in one directory,
+    // removed when the bench exits.
+    juce::File writeTestFile (const juce::String& name, double seconds,
+                              juce::AudioFormat* format = nullptr, int qualityIndex = 0)
+    {
+        static const TestFixtures::ScopedTempDirectory directory ("Bench");
+        return TestFixtures::writeSineFile (directory.getChildFile (name), sampleRate, (int) (seconds * sampleRate),
+                                            16, format, qualityIndex);
+    }
+
+    void waitForLoads (SamplerEngine& engine)
+    {
+        while (engine.getLoadProgress().size() > 0)
+            juce::Thread::sleep (5);
+    }
+
+    // Adds numPlayers players all playing `file`, with the engine prepared
+    // for the bench's rate and block size.
+    std::vector<int> addPlayers (SamplerEngine& engine, const juce::File& file, int numPlayers)
+    {
+        engine.prepareToPlay (sampleRate, blockSize);
+
+        std::vector<int> ids;
+        for (int i = 0; i < numPlayers; ++i)
+        {
+            ids.push_back (engine.addSamplePlayer());
+            engine.loadSampleAsync (ids.back(), file, nullptr);
+        }
+
+        waitForLoads (engine);
+        return ids;
+    }
+
+    struct BlockTimes
+    {
+        double meanMicros { 0.0 };
+        double p99Micros { 0.0 };
+    };
+
+    // Runs the engine for warmUp blocks, then times numBlocks. `midiFor`
+    // fills in the MIDI for each block, counting from the first warm-up block.
+    BlockTimes timeBlocks (SamplerEngine& engine, int warmUp, int numBlocks,
+                           const std::function<void (int, juce::MidiBuffer&)>& midiFor = nullptr)
+    {
+        juce::AudioBuffer<float> buffer (2, blockSize);
+        juce::MidiBuffer midi;
+        std::vector<double> times;
+        times.reserve ((size_t) numBlocks);
+
+        for (int block = 0; block < warmUp + numBlocks; ++block)
+        {
+            midi.clear();
+            if (midiFor != nullptr)
+                midiFor (block, midi);
+
+            const auto start = juce::Time::getHighResolutionTicks();
+            engine.processBlock (buffer, midi);
+            const auto end = juce::Time::getHighResolutionTicks();
+
+            if (block >= warmUp)
+                times.push_back (juce::Time::highResolutionTicksToSeconds (end - start) * 1.0e6);
+        }
+
+        BlockTimes result;
+        for (auto t : times)
+            result.meanMicros += t;
+        result.meanMicros /= (double) times.size();
+
+        std::sort (times.begin(), times.end());
+        result.p99Micros = times[(size_t) ((double) (times.size() - 1) * 0.99)];
+        return result;
+    }
+
+    double blockBudgetMicros()
+    {
+        return (double) blockSize / sampleRate * 1.0e6;
+    }
+
+    //==========================================================================
+    // Per-block cost with 64, 128 and 256 players loaded, with every player
+    // sounding and with only eight of them sounding.
+    void benchPlayers()
+    {
+        std::printf ("\n== players: processBlock, %d frames at %.0f Hz (budget %.0f us)\n",
+                     blockSize, sampleRate, blockBudgetMicros());
+        std::printf ("%8s %9s %12s %12s %9s\n", "players", "sounding", "mean us", "p99 us", "budget");
+
+        const auto file = writeTestFile ("players.wav", 20.0);
+
+        for (int numPlayers : { 64, 128, 256 })
+        {
+            for (int numSounding : { numPlayers, 8 })
+            {
+                SamplerEngine engine;
+                const auto ids = addPlayers (engine, file, numPlayers);
+
+                // triggers land at the start of the next block
+                for (int i = 0; i < numSounding; ++i)
+                    engine.trigger (ids[(size_t) i]);
+
+                const auto times = timeBlocks (engine, 20, 1000);
+                std::printf ("%8d %9d %12.1f %12.1f %8.1f%%\n", numPlayers, numSounding,
+                             times.meanMicros, times.p99Micros, 100.0 * times.meanMicros / blockBudgetMicros());
+            }
+        }
+    }
+
+    //==========================================================================
+    // Per-block cost of each interpolation mode with 8, 32 and 64 voices held,
+    // pitched a fifth down, a fifth up and two octaves up from the root.
+    void benchInterpolation()
+    {
+        std::printf ("\n== interpolation: processBlock, %d frames at %.0f Hz (budget %.0f us)\n",
+                     blockSize, sampleRate, blockBudgetMicros());
+        std::printf ("%8s %7s %10s %12s %12s %9s\n", "mode", "voices", "semitones", "mean us", "p99 us", "budget");
+
+        const auto file = writeTestFile ("interpolation.wav", 20.0);
+        constexpr int rootKey = 60;
+        constexpr int voicesPerPlayer = 8;
+
+        for (const char* mode : { "linear", "hermite", "sinc" })
+        {
+            for (int numVoices : { 8, 32, 64 })
+            {
+                for (int semitones : { -7, 7, 24 })
+                {
+                    SamplerEngine engine;
+                    const auto ids = addPlayers (engine, file, numVoices / voicesPerPlayer);
+
+                    for (auto id : ids)
+                    {
+                        engine.setMidiRange (id, 0, 127);
+                        engine.setPitchSettings (id, rootKey, mode);
+                    }
+
+                    // every player hears every note-on, so each holds voicesPerPlayer
+                    // voices of the same note, started a frame apart
+                    const auto times = timeBlocks (engine, 20, 1000, [&] (int block, juce::MidiBuffer& midi)
+                    {
+                        if (block == 0)
+                            for (int v = 0; v < voicesPerPlayer; ++v)
+                                midi.addEvent (juce::MidiMessage::noteOn (1, rootKey + semitones, (juce::uint8) 100), v);
+                    });
+
+                    std::printf ("%8s %7d %+10d %12.1f %12.1f %8.1f%%\n", mode, numVoices, semitones,
+                                 times.meanMicros, times.p99Micros, 100.0 * times.meanMicros / blockBudgetMicros());
+                }
+            }
+        }
+    }
+
+    //==========================================================================
+    // Per-block cost and pooled RAM for each in-memory sample format, with
+    // 32 players sounding, each on its own file so the reads miss the caches.
+    // The files add up to kitMegabytes once decoded to float32.
+    void benchStorage()
+    {
+        constexpr int numPlayers = 32;
+        const double bytesPerSecond = sampleRate * 2 * sizeof (float);
+        const double seconds = (double) kitMegabytes * 1024.0 * 1024.0 / bytesPerSecond / numPlayers;
+
+        std::printf ("\n== storage: processBlock, %d frames at %.0f Hz (budget %.0f us), %d MB kit\n",
+                     blockSize, sampleRate, blockBudgetMicros(), kitMegabytes);
+        std::printf ("%8s %9s %12s %12s %9s\n", "format", "MB", "mean us", "p99 us", "budget");
+
+        std::vector<juce::File> files;
+        for (int i = 0; i < numPlayers; ++i)
+            files.push_back (writeTestFile ("storage" + juce::String (i) + ".wav", seconds));
+
+        for (const char* format : { "float32", "int16", "float16" })
+        {
+            SamplerEngine engine;
+            engine.prepareToPlay (sampleRate, blockSize);
+
+            std::vector<int> ids;
+            for (const auto& file : files)
+            {
+                ids.push_back (engine.addSamplePlayer());
+                engine.setStorage (ids.back(), "memory", format, nullptr);
+                engine.loadSampleAsync (ids.back(), file, nullptr);
+            }
+
+            waitForLoads (engine);
+            for (auto id : ids)
+                engine.trigger (id);
+
+            const auto times = timeBlocks (engine, 20, 1000);
+            const juce::SharedResourcePointer<SamplePool> pool;
+            std::printf ("%8s %9.1f %12.1f %12.1f %8.1f%%\n", format,
+                         (double) pool->getStats().bytesInMemory / (1024.0 * 1024.0),
+                         times.meanMicros, times.p99Micros, 100.0 * times.meanMicros / blockBudgetMicros());
+        }
+    }
+
+    //==========================================================================
+    // Per-block cost with 256 players sounding, from the audio thread alone up
+    // to one thread per core, and at least four threads on smaller machines.
+    void benchThreads()
+    {
+        const int maxThreads = juce::jlimit (4, RenderWorkers::maxWorkers + 1, juce::SystemStats::getNumCpus());
+
+        std::printf ("\n== threads: processBlock, %d frames at %.0f Hz (budget %.0f us), %d cores\n",
+                     blockSize, sampleRate, blockBudgetMicros(), juce::SystemStats::getNumCpus());
+        std::printf ("%8s %12s %12s %9s %8s\n", "threads", "mean us", "p99 us", "budget", "speedup");
+
+        const auto file = writeTestFile ("threads.wav", 20.0);
+        double singleMean = 0.0;
+
+        for (int numThreads = 1; numThreads <= maxThreads; ++numThreads)
+        {
+            SamplerEngine engine;
+            const auto ids = addPlayers (engine, file, 256);
+            engine.setRenderThreads (numThreads - 1);
+
+            for (auto id : ids)
+                engine.trigger (id);
+
+            const auto times = timeBlocks (engine, 20, 1000);
+            if (numThreads == 1)
+                singleMean = times.meanMicros;
+
+            std::printf ("%8d %12.1f %12.1f %8.1f%% %7.2fx\n", numThreads, times.meanMicros, times.p99Micros,
+                         100.0 * times.meanMicros / blockBudgetMicros(), singleMean / times.meanMicros);
+        }
+    }
+
+    //==========================================================================
+    // Decode speed of a long file per format: one reader straight through,
+    // then ParallelDecoder with the calling thread and 1..maxThreads loader
+    // threads. MB/s counts the float frames produced.
+    void benchDecode()
+    {
+        std::printf ("\n== decode: %.0f s stereo at %.0f Hz, %d cores\n",
+                     120.0, sampleRate, juce::SystemStats::getNumCpus());
+        std::printf ("%8s %8s %10s %10s %8s\n", "format", "threads", "ms", "MB/s", "speedup");
+
+        struct Codec
+        {
+            std::unique_ptr<juce::AudioFormat> format;
+            int qualityIndex;
+        };
+
+        std::vector<Codec> codecs;
+        codecs.push_back ({ std::make_unique<juce::WavAudioFormat>(), 0 });
+       #if JUCE_USE_FLAC
+        codecs.push_back ({ std::make_unique<juce::FlacAudioFormat>(), 0 });
+       #endif
+       #if JUCE_USE_OGGVORBIS
+        codecs.push_back ({ std::make_unique<juce::OggVorbisAudioFormat>(), 5 });
+       #endif
+
+        for (auto& codec : codecs)
+        {
+            auto& format = *codec.format;
+            const auto file = writeTestFile ("decode" + format.getFileExtensions()[0], 120.0, &format, codec.qualityIndex);
+            const auto openReader = [&format, file]
+            {
+                return std::unique_ptr<juce::AudioFormatReader> (format.createReaderFor (new juce::FileInputStream (file), true));
+            };
+
+            const int numFrames = (int) openReader()->lengthInSamples;
+            const double megabytes = (double) numFrames * 2.0 * sizeof (float) / (1024.0 * 1024.0);
+            double serialMs = 0.0;
+
+            const auto report = [&] (const char* threads, double ms)
+            {
+                std::printf ("%8s %8s %10.1f %10.1f %7.2fx\n", format.getFileExtensions()[0].toRawUTF8(), threads,
+                             ms, megabytes / (ms / 1000.0), serialMs / ms);
+            };
+
+            {
+                SampleData data;
+                data.buffer.setSize (2, numFrames);
+                auto reader = openReader();
+
+                const auto start = juce::Time::getMillisecondCounterHiRes();
+                for (int pos = 0; pos < numFrames; pos += ParallelDecoder::framesPerRead)
+                    ParallelDecoder::readPiece (*reader, data, pos, juce::jmin (ParallelDecoder::framesPerRead, numFrames - pos), data.buffer);
+                serialMs = juce::Time::getMillisecondCounterHiRes() - start;
+                report ("serial", serialMs);
+            }
+
+            // a format that cannot seek to any frame is only ever read straight through
+            if (! ParallelDecoder::canSplit (&format, numFrames))
+                continue;
+
+            for (int numThreads = 1; numThreads <= LoaderPool::maxThreads; ++numThreads)
+            {
+                SampleData data;
+                data.lengthInSamples = numFrames;
+                data.buffer.setSize (2, numFrames);
+                LoaderPool pool (numThreads);
+                auto reader = openReader();
+
+                const auto start = juce::Time::getMillisecondCounterHiRes();
+                ParallelDecoder::decode (*reader, openReader, data, numFrames, ParallelDecoder::framesPerRead,
+                                         pool, 0, nullptr, nullptr);
+                const auto label = "1+" + juce::String (numThreads);
+                report (label.toRawUTF8(), juce::Time::getMillisecondCounterHiRes() - start);
+            }
+        }
+    }
+
+    struct Section
+    {
+        const char* name;
+        void (*run)();
+    };
+
+    const Section sections[] = {
+        { "players", benchPlayers },
+        { "interpolation", benchInterpolation },
+        { "storage", benchStorage },
+        { "threads", benchThreads },
+        { "decode", benchDecode },
+    };
+}
+
+int main (int argc, char* argv[])
+{
+    juce::StringArray names;
+    for (int i = 1; i < argc; ++i)
+    {
+        const juce::String arg (argv[i]);
+        if (arg.startsWith ("--kit-mb="))
+            kitMegabytes = juce::jmax (1, arg.fromFirstOccurrenceOf ("=", false, false).getIntValue());
+        else
+            names.add (arg);
+    }
+
+    bool ranAny = false;
+
+    for (const auto& section : sections)
+    {
+        if (names.isEmpty() || names.contains (section.name))
+        {
+            section.run();
+            ranAny = true;
+        }
+    }
+
+    if (! ranAny)
+    {
+        std::printf ("usage: SamplerBench [--kit-mb=N] [section ...]\nsections:");
+        for (const auto& section : sections)
+            std::printf (" %s", section.name);
+        std::printf ("\n");
+        return 1;
+    }
+
+    return 0;
+}
@@ -0,0 +1,178 @@
+#include "CompactStorage.h"
+
+#include <cstring>
+
+#if JUCE_INTEL
+ #include <emmintrin.h>
+#elif JUCE_ARM && defined (__ARM_NEON)
+ #include <arm_neon.h>
+#endif
+
+namespace
+{
+    constexpr float int16Scale = 1.0f / 32768.0f;
+
+    inline uint32 floatBits (float f) noexcept
+    {
+        uint32 u;
+        std::memcpy (&u, &f, sizeof (u));
+        return u;
+    }
+
+    inline float bitsToFloat (uint32 u) noexcept
+    {
+        float f;
+        std::memcpy (&f, &u, sizeof (f));
+        return f;
+    }
+
+    // Shifting the exponent and mantissa into place and scaling by 2^112
+    // rebiases the exponent and handles subnormals in one multiply; values
+    // that land at 2^16 or above were inf/NaN and get the float exponent.
+    constexpr uint32 halfMagic = 0x77800000; // 2^112
+
+    inline float halfToFloat (uint16 h) noexcept
+    {
+        float f = bitsToFloat ((uint32) (h & 0x7fff) << 13) * bitsToFloat (halfMagic);
+        if (f >= 65536.0f)
+            f = bitsToFloat (floatBits (f) | 0x7f800000);
+        return bitsToFloat (floatBits (f) | ((uint32) (h & 0x8000) << 16));
+    }
+
+    inline uint16 floatToHalf (float value) noexcept
+    {
+        uint32 x = floatBits (value);
+        const auto sign = (uint16) ((x >> 16) & 0x8000);
+        x &= 0x7fffffff;
+
+        if (x >= 0x7f800000)                    // inf or NaN
+            return (uint16) (sign | 0x7c00 | (x > 0x7f800000 ? 0x200 : 0));
+        if (x >= 0x477ff000)                    // rounds past the largest half
+            return (uint16) (sign | 0x7c00);
+        if (x < 0x38800000)                     // half subnormal: let the FPU round
+            return (uint16) (sign | (floatBits (bitsToFloat (x) + 0.5f) - 0x3f000000));
+
+        // rebias, then round to nearest even on the dropped 13 bits
+        x += ((uint32) (15 - 127) << 23) + 0xfff + ((x >> 13) & 1);
+        return (uint16) (sign | (x >> 13));
+    }
+
+    void decodeInt16 (const uint16* src, float* dest, int numSamples) noexcept
+    {
+        int i = 0;
+
+       #if JUCE_INTEL
+        const __m128 scale = _mm_set1_ps (int16Scale);
+        const __m128i zero = _mm_setzero_si128();
+
+        for (; i + 8 <= numSamples; i += 8)
+        {
+            const __m128i v = _mm_loadu_si128 (reinterpret_cast<const __m128i*> (src + i));
+            // place each value in the top half of a lane, then sign-extend down
+            const __m128i lo = _mm_srai_epi32 (_mm_unpacklo_epi16 (zero, v), 16);
+            const __m128i hi = _mm_srai_epi32 (_mm_unpackhi_epi16 (zero, v), 16);
+            _mm_storeu_ps (dest + i,     _mm_mul_ps (_mm_cvtepi32_ps (lo), scale));
+            _mm_storeu_ps (dest + i + 4, _mm_mul_ps (_mm_cvtepi32_ps (hi), scale));
+        }
+       #elif JUCE_ARM && defined (__ARM_NEON)
+        for (; i + 8 <= numSamples; i += 8)
+        {
+            const int16x8_t v = vld1q_s16 (reinterpret_cast<const int16_t*> (src + i));
+            vst1q_f32 (dest + i,     vmulq_n_f32 (vcvtq_f32_s32 (vmovl_s16 (vget_low_s16 (v))), int16Scale));
+            vst1q_f32 (dest + i + 4, vmulq_n_f32 (vcvtq_f32_s32 (vmovl_s16 (vget_high_s16 (v))), int16Scale));
+        }
+       #endif
+
+        for (; i < numSamples; ++i)
+            dest[i] = (float) (int16) src[i] * int16Scale;
+    }
+
+    void decodeFloat16 (const uint16* src, float* dest, int numSamples) noexcept
+    {
+        int i = 0;
+
+       #if JUCE_INTEL
+        const __m128i zero = _mm_setzero_si128();
+        const __m128i magnitudeMask = _mm_set1_epi32 (0x7fff);
+        const __m128i signMask = _mm_set1_epi32 (0x8000);
+        const __m128 magic = _mm_castsi128_ps (_mm_set1_epi32 ((int) halfMagic));
+        const __m128 infLimit = _mm_set1_ps (65536.0f);
+        const __m128 infExponent = _mm_castsi128_ps (_mm_set1_epi32 (0x7f800000));
+
+        const auto convert = [&] (__m128i h) noexcept
+        {
+            const __m128i shifted = _mm_slli_epi32 (_mm_and_si128 (h, magnitudeMask), 13);
+            __m128 f = _mm_mul_ps (_mm_castsi128_ps (shifted), magic);
+            f = _mm_or_ps (f, _mm_and_ps (_mm_cmpge_ps (f, infLimit), infExponent));
+            return _mm_or_ps (f, _mm_castsi128_ps (_mm_slli_epi32 (_mm_and_si128 (h, signMask), 16)));
+        };
+
+        for (; i + 8 <= numSamples; i += 8)
+        {
+            const __m128i v = _mm_loadu_si128 (reinterpret_cast<const __m128i*> (src + i));
+            _mm_storeu_ps (dest + i,     convert (_mm_unpacklo_epi16 (v, zero)));
+            _mm_storeu_ps (dest + i + 4, convert (_mm_unpackhi_epi16 (v, zero)));
+        }
+       #elif JUCE_ARM && defined (__aarch64__)
+        for (; i + 8 <= numSamples; i += 8)
+        {
+            const float16x8_t v = vreinterpretq_f16_u16 (vld1q_u16 (src + i));
+            vst1q_f32 (dest + i,     vcvt_f32_f16 (vget_low_f16 (v)));
+            vst1q_f32 (dest + i + 4, vcvt_high_f32_f16 (v));
+        }
+       #endif
+
+        for (; i < numSamples; ++i)
+            dest[i] = halfToFloat (src[i]);
+    }
+}
+
+void CompactStorage::encode (Format format, const float* src, uint16* dest, int numSamples) noexcept
+{
+    switch (format)
+    {
+        case Format::int16:
+            for (int i = 0; i < numSamples; ++i)
+                dest[i] = (uint16) (int16) juce::jlimit (-32768, 32767, juce::roundToInt (src[i] * 32768.0f));
+            break;
+
+        case Format::float16:
+            for (int i = 0; i < numSamples; ++i)
+                dest[i] = floatToHalf (src[i]);
+            break;
+
+        case Format::float32:
+            jassertfalse; // float32 samples stay in the AudioBuffer
+            break;
+    }
+}
+
+void CompactStorage::decode (Format format, const uint16* src, float* dest, int numSamples) noexcept
+{
+    switch (format)
+    {
+        case Format::int16:   decodeInt16 (src, dest, numSamples); break;
+        case Format::float16: decodeFloat16 (src, dest, numSamples); break;
+        case Format::float32: jassertfalse; break;
+    }
+}
+
+juce::String CompactStorage::formatToString (Format format)
+{
+    switch (format)
+    {
+        case Format::int16:   return "int16";
+        case Format::float16: return "float16";
+        case Format::float32: break;
+    }
+    return "float32";
+}
+
+CompactStorage::Format CompactStorage::formatFromString (const juce::String& name)
+{
+    if (name == "int16")
+        return Format::int16;
+    if (name == "float16")
+        return Format::float16;
+    return Format::float32;
+}
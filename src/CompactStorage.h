@@ -0,0 +1,25 @@
+#pragma once
+
+#include <JuceHeader.h>
+
+// Formats for decoded samples held in RAM. The 16-bit formats halve the
+// memory of float32; int16 suits 16-bit source material exactly, float16
+// keeps float headroom at roughly 11 bits of precision. Samples are stored
+// planar, one contiguous run per channel, and decode() turns a run back into
+// float in the render kernel, eight frames per step where SSE2 or NEON is
+// available.
+class CompactStorage
+{
+public:
+    enum class Format { float32, int16, float16 };
+
+    // Load time only; rounds to nearest.
+    static void encode (Format format, const float* src, uint16* dest, int numSamples) noexcept;
+    static void decode (Format format, const uint16* src, float* dest, int numSamples) noexcept;
+
+    static juce::String formatToString (Format format);
+    static Format formatFromString (const juce::String& name);
+
+private:
+    CompactStorage() = delete;
+};
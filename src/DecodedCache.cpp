@@ -0,0 +1,333 @@
+#include "DecodedCache.h"
+#include "DiskStreamer.h"
+#include "SamplePool.h"
+#include <algorithm>
+#include <cstring>
+#include <limits>
+
+namespace
+{
+    constexpr char entryMagic[8] = { 'M', 'Y', 'K', 'D', 'E', 'C', '0', '1' };
+    constexpr uint32 byteOrderMark = 0x01020304;
+    constexpr uint32 entryAlignment = 4096;
+    const char* const entryExtension = ".sdc";
+
+    struct EntryHeader
+    {
+        char magic[8];
+        uint32 byteOrder;       // byteOrderMark as written; entries do not travel between endians
+        uint32 headerSize;      // offset of the frames, a multiple of entryAlignment
+        uint32 format;          // CompactStorage::Format
+        uint32 numChannels;
+        double sampleRate;
+        int64 lengthInSamples;
+        int64 fileLoopStart;
+        int64 fileLoopEnd;
+        uint32 keyBytes;        // UTF-8 entry key, straight after the header
+        uint32 svgBytes;        // UTF-8 waveform, after the key
+        uint64 payloadBytes;
+        uint64 payloadCheck;    // see sparseChecksum
+        uint64 headerCheck;     // over the fields above, the key and the waveform
+    };
+
+    uint64 fnv1a (const void* data, size_t numBytes, uint64 hash = 0xcbf29ce484222325ull) noexcept
+    {
+        auto* bytes = static_cast<const uint8*> (data);
+        for (size_t i = 0; i < numBytes; ++i)
+            hash = (hash ^ bytes[i]) * 0x100000001b3ull;
+        return hash;
+    }
+
+    // Hashes up to 17 evenly spaced 4 KB blocks of each channel, last block
+    // included, so opening an entry stays cheap but truncation or damage in
+    // any part of it is very likely to show.
+    uint64 sparseChecksum (const void* const* channels, int numChannels, size_t bytesPerChannel) noexcept
+    {
+        constexpr size_t blockBytes = 4096;
+        constexpr size_t numBlocks = 16;
+        uint64 hash = fnv1a (&bytesPerChannel, sizeof (bytesPerChannel));
+
+        for (int ch = 0; ch < numChannels; ++ch)
+        {
+            auto* bytes = static_cast<const uint8*> (channels[ch]);
+            const size_t len = juce::jmin (blockBytes, bytesPerChannel);
+            const size_t lastStart = bytesPerChannel - len;
+
+            for (size_t b = 0; b <= numBlocks; ++b)
+                hash = fnv1a (bytes + lastStart * b / numBlocks, len, hash);
+        }
+
+        return hash;
+    }
+
+    uint64 headerChecksum (EntryHeader header, const char* key, const char* svg) noexcept
+    {
+        header.headerCheck = 0;
+        auto hash = fnv1a (&header, sizeof (header));
+        hash = fnv1a (key, header.keyBytes, hash);
+        return fnv1a (svg, header.svgBytes, hash);
+    }
+
+    int getBytesPerSample (CompactStorage::Format format) noexcept
+    {
+        return format == CompactStorage::Format::float32 ? 4 : 2;
+    }
+
+    juce::String makeEntryKey (const juce::String& poolKey, double sampleRate)
+    {
+        return sampleRate > 0.0 ? SamplePool::makeRateKey (poolKey, sampleRate) : poolKey;
+    }
+}
+
+DecodedCache::DecodedCache()
+    : DecodedCache (getDefaultDirectory())
+{
+}
+
+DecodedCache::DecodedCache (const juce::File& cacheDirectory)
+    : directory (cacheDirectory)
+{
+}
+
+juce::File DecodedCache::getDefaultDirectory()
+{
+    return juce::File::getSpecialLocation (juce::File::userApplicationDataDirectory)
+        .getChildFile ("MykSuperSampler")
+        .getChildFile ("DecodedCache");
+}
+
+juce::File DecodedCache::getEntryFile (const juce::String& entryKey) const
+{
+    // the key itself is stored in the entry, so a hash collision is caught there
+    return directory.getChildFile (juce::String::toHexString (entryKey.hashCode64()) + entryExtension);
+}
+
+SampleDataPtr DecodedCache::load (const juce::String& poolKey, double sampleRate)
+{
+    if (poolKey.isEmpty())
+        return nullptr;
+
+    const auto entryKey = makeEntryKey (poolKey, sampleRate);
+    const auto file = getEntryFile (entryKey);
+    if (! file.existsAsFile())
+        return nullptr;
+
+    auto mapping = std::make_shared<juce::MemoryMappedFile> (file, juce::MemoryMappedFile::readOnly);
+    auto* base = static_cast<const char*> (mapping->getData());
+    const auto fileBytes = (uint64) mapping->getSize();
+
+    auto reject = [&file]() -> SampleDataPtr
+    {
+        file.deleteFile();
+        return nullptr;
+    };
+
+    if (base == nullptr || fileBytes < sizeof (EntryHeader))
+        return reject();
+
+    EntryHeader h;
+    std::memcpy (&h, base, sizeof (h));
+
+    const auto format = (CompactStorage::Format) h.format;
+    const bool headerSane = std::memcmp (h.magic, entryMagic, sizeof (entryMagic)) == 0
+                         && h.byteOrder == byteOrderMark
+                         && h.format <= (uint32) CompactStorage::Format::float16
+                         && h.numChannels >= 1 && h.numChannels <= 2
+                         && h.lengthInSamples > 0 && h.lengthInSamples <= (int64) std::numeric_limits<int>::max()
+                         && h.sampleRate > 0.0
+                         && h.headerSize % entryAlignment == 0
+                         && (uint64) sizeof (h) + h.keyBytes + h.svgBytes <= h.headerSize
+                         && h.payloadBytes == (uint64) h.numChannels * (uint64) h.lengthInSamples * (uint64) getBytesPerSample (format)
+                         && (uint64) h.headerSize + h.payloadBytes == fileBytes;
+    if (! headerSane)
+        return reject();
+
+    const char* key = base + sizeof (h);
+    const char* svg = key + h.keyBytes;
+    if (headerChecksum (h, key, svg) != h.headerCheck)
+        return reject();
+
+    // a different key hashed to the same name: leave the other entry alone
+    if (juce::String::fromUTF8 (key, (int) h.keyBytes) != entryKey)
+        return nullptr;
+
+    const char* payload = base + h.headerSize;
+    const size_t bytesPerChannel = (size_t) (h.payloadBytes / h.numChannels);
+    const void* channels[2] = { payload, payload + bytesPerChannel };
+    if (sparseChecksum (channels, (int) h.numChannels, bytesPerChannel) != h.payloadCheck)
+        return reject();
+
+    auto data = std::make_shared<SampleData>();
+    data->sampleRate = h.sampleRate;
+    data->lengthInSamples = h.lengthInSamples;
+    data->fileLoopStart = h.fileLoopStart;
+    data->fileLoopEnd = h.fileLoopEnd;
+    data->waveformSVG = juce::String::fromUTF8 (svg, (int) h.svgBytes);
+    data->poolKey = poolKey;
+
+    // played in place through read-only views of the mapping
+    if (format == CompactStorage::Format::float32)
+    {
+        data->floatChannels = (int) h.numChannels;
+        data->floatFrames = reinterpret_cast<const float*> (payload);
+    }
+    else
+    {
+        data->packedFormat = format;
+        data->packedChannels = (int) h.numChannels;
+        data->packedFrames = reinterpret_cast<const uint16*> (payload);
+    }
+
+    // Fault in each channel's opening pages before the data is published,
+    // so the first notes do not wait on the disk.
+    const size_t headBytes = (size_t) juce::jmin (h.lengthInSamples, (int64) DiskStreamer::headFrames)
+                           * (size_t) getBytesPerSample (format);
+    uint8 touched = 0;
+    for (uint32 ch = 0; ch < h.numChannels; ++ch)
+    {
+        const auto* bytes = reinterpret_cast<const volatile uint8*> (payload + ch * bytesPerChannel);
+        for (size_t offset = 0; offset < headBytes; offset += 4096)
+            touched ^= bytes[offset];
+    }
+    juce::ignoreUnused (touched);
+
+    data->cacheMapping = std::move (mapping);
+
+    // the access time orders entries for trimming
+    file.setLastAccessTime (juce::Time::getCurrentTime());
+    return data;
+}
+
+void DecodedCache::store (const juce::String& poolKey, double sampleRate, const SampleData& data)
+{
+    // only whole decoded samples, and nothing that came from here already
+    if (poolKey.isEmpty() || ! data.isDecoded() || data.cacheMapping != nullptr || data.lengthInSamples <= 0
+        || (! data.isPacked() && data.getNumFramesInMemory() != data.lengthInSamples))
+        return;
+
+    const auto format = data.isPacked() ? data.packedFormat : CompactStorage::Format::float32;
+    const int numChannels = juce::jlimit (0, 2, data.getNumChannels());
+    if (numChannels == 0)
+        return;
+
+    const auto entryKey = makeEntryKey (poolKey, sampleRate);
+    const size_t bytesPerChannel = (size_t) data.lengthInSamples * (size_t) getBytesPerSample (format);
+    const void* channels[2] {};
+    for (int ch = 0; ch < numChannels; ++ch)
+        channels[ch] = data.isPacked() ? static_cast<const void*> (data.getPackedChannel (ch))
+                                       : static_cast<const void*> (data.getFloatChannel (ch));
+
+    const juce::String svg = data.waveformSVG;
+    EntryHeader h {};
+    std::memcpy (h.magic, entryMagic, sizeof (entryMagic));
+    h.byteOrder = byteOrderMark;
+    h.format = (uint32) format;
+    h.numChannels = (uint32) numChannels;
+    h.sampleRate = data.sampleRate;
+    h.lengthInSamples = data.lengthInSamples;
+    h.fileLoopStart = data.fileLoopStart;
+    h.fileLoopEnd = data.fileLoopEnd;
+    h.keyBytes = (uint32) entryKey.getNumBytesAsUTF8();
+    h.svgBytes = (uint32) svg.getNumBytesAsUTF8();
+    h.headerSize = (uint32) ((sizeof (h) + h.keyBytes + h.svgBytes + entryAlignment - 1) / entryAlignment * entryAlignment);
+    h.payloadBytes = (uint64) bytesPerChannel * (uint64) numChannels;
+    h.payloadCheck = sparseChecksum (channels, numChannels, bytesPerChannel);
+    h.headerCheck = headerChecksum (h, entryKey.toRawUTF8(), svg.toRawUTF8());
+
+    if (! directory.createDirectory())
+        return;
+
+    // written aside and renamed, so readers only ever see whole entries
+    const auto target = getEntryFile (entryKey);
+    const auto temp = target.getSiblingFile (target.getFileName() + "."
+                                             + juce::String::toHexString (juce::Random::getSystemRandom().nextInt64())
+                                             + ".tmp");
+    {
+        juce::FileOutputStream out (temp);
+        if (! out.openedOk())
+            return;
+
+        out.write (&h, sizeof (h));
+        out.write (entryKey.toRawUTF8(), h.keyBytes);
+        out.write (svg.toRawUTF8(), h.svgBytes);
+        out.writeRepeatedByte (0, h.headerSize - sizeof (h) - h.keyBytes - h.svgBytes);
+
+        for (int ch = 0; ch < numChannels; ++ch)
+            out.write (channels[ch], bytesPerChannel);
+
+        out.flush();
+        if (out.getStatus().failed())
+        {
+            temp.deleteFile();
+            return;
+        }
+    }
+
+    if (! temp.moveFileTo (target))
+    {
+        temp.deleteFile();
+        return;
+    }
+
+    // the directory is scanned on the first store and then only when the
+    // running total crosses the limit; that scan also counts what other
+    // processes have written since
+    const int64 entryBytes = (int64) h.headerSize + (int64) h.payloadBytes;
+    if (knownBytes.load() < 0 || knownBytes.fetch_add (entryBytes) + entryBytes > maxBytes.load())
+        trim();
+}
+
+void DecodedCache::trim()
+{
+    const std::lock_guard<std::mutex> guard (trimLock);
+
+    struct Item
+    {
+        juce::File file;
+        int64 bytes;
+        juce::Time lastUsed;
+    };
+
+    std::vector<Item> items;
+    int64 total = 0;
+    const auto staleBefore = juce::Time::getCurrentTime() - juce::RelativeTime::days (1);
+
+    for (const auto& file : directory.findChildFiles (juce::File::findFiles, false, "*"))
+    {
+        // temporaries left behind by a crash
+        if (file.getFileExtension() == ".tmp")
+        {
+            if (file.getLastModificationTime() < staleBefore)
+                file.deleteFile();
+            continue;
+        }
+
+        if (file.getFileExtension() != entryExtension)
+            continue;
+
+        items.push_back ({ file, file.getSize(), file.getLastAccessTime() });
+        total += items.back().bytes;
+    }
+
+    const int64 limit = maxBytes.load();
+    if (total <= limit)
+    {
+        knownBytes.store (total);
+        return;
+    }
+
+    std::sort (items.begin(), items.end(), [] (const Item& a, const Item& b) { return a.lastUsed < b.lastUsed; });
+
+    // an entry still mapped somewhere stays readable where unlinking is
+    // allowed, and where it is not the delete fails and is tried next time
+    for (const auto& item : items)
+    {
+        if (total <= limit)
+            break;
+
+        if (item.file.deleteFile())
+            total -= item.bytes;
+    }
+
+    knownBytes.store (total);
+}
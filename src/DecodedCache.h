@@ -0,0 +1,50 @@
+#pragma once
+
+#include <JuceHeader.h>
+#include <atomic>
+#include <mutex>
+#include "SampleData.h"
+
+// Decoded audio kept on disk between sessions, so that reopening a session
+// with compressed or resampled sources costs a memory map rather than a
+// decode. Shared by every plugin instance (hold it through
+// juce::SharedResourcePointer); separate processes may share the directory.
+//
+// An entry holds one fully decoded SampleData at one rate: a header with
+// the pool key and waveform, then each channel's frames in their packed
+// format, starting on a page boundary so the entry is mapped and played in
+// place. Entries are keyed by SamplePool key (path, size, modification time
+// and storage variant) plus the rate. They are written under a temporary
+// name and renamed into place, and checked against their header and a
+// sparse checksum of the frames when opened. The least recently used
+// entries are deleted once the directory grows past its size limit.
+class DecodedCache
+{
+public:
+    static constexpr int64 defaultMaxBytes = (int64) 4 << 30;
+
+    DecodedCache();
+    explicit DecodedCache (const juce::File& cacheDirectory);
+
+    static juce::File getDefaultDirectory();
+
+    void setMaxBytes (int64 bytes) noexcept { maxBytes.store (juce::jmax ((int64) 0, bytes)); }
+    int64 getMaxBytes() const noexcept { return maxBytes.load(); }
+
+    // The entry for a pool key at a rate (0 for the file's own rate), mapped
+    // from disk, or nullptr if there is none or it fails its checks.
+    SampleDataPtr load (const juce::String& poolKey, double sampleRate);
+    // Writes an entry for fully decoded data; anything else is skipped.
+    void store (const juce::String& poolKey, double sampleRate, const SampleData& data);
+
+private:
+    juce::File getEntryFile (const juce::String& entryKey) const;
+    void trim();
+
+    const juce::File directory;
+    std::atomic<int64> maxBytes { defaultMaxBytes };
+    std::atomic<int64> knownBytes { -1 };   // size at the last trim plus stores since; -1 before the first
+    std::mutex trimLock;
+
+    JUCE_DECLARE_NON_COPYABLE (DecodedCache)
+};
@@ -0,0 +1,154 @@
+#include "DiskStreamer.h"
+
+StreamSource::StreamSource (std::unique_ptr<juce::AudioFormatReader> sourceReader, int numChannelsToRead)
+    : reader (std::move (sourceReader)),
+      numChannels (juce::jlimit (1, DiskStreamer::maxChannels, numChannelsToRead)),
+      lengthInSamples (reader != nullptr ? reader->lengthInSamples : 0)
+{
+}
+
+void StreamSource::read (juce::AudioBuffer<float>& dest, int64 startFrame, int numFrames)
+{
+    const std::lock_guard<std::mutex> guard (readLock);
+    reader->read (&dest, 0, numFrames, startFrame, true, numChannels > 1);
+}
+
+DiskStreamer::DiskStreamer()
+    : juce::Thread ("Sampler disk streamer"),
+      slots (new Slot[(size_t) numSlots])
+{
+}
+
+DiskStreamer::~DiskStreamer()
+{
+    stopThread (2000);
+}
+
+void DiskStreamer::prepare()
+{
+    if (prepared.load (std::memory_order_acquire))
+        return;
+
+    const std::lock_guard<std::mutex> guard (prepareLock);
+    if (prepared.load (std::memory_order_relaxed))
+        return;
+
+    for (int i = 0; i < numSlots; ++i)
+        slots[(size_t) i].ring.setSize (maxChannels, ringFrames);
+
+    readBuffer.setSize (maxChannels, 8192);
+    startThread (juce::Thread::Priority::high);
+    prepared.store (true, std::memory_order_release);
+}
+
+int DiskStreamer::acquire (const std::shared_ptr<StreamSource>& source, int64 startFrame) noexcept
+{
+    if (! prepared.load (std::memory_order_acquire))
+        return -1;
+
+    for (int i = 0; i < numSlots; ++i)
+    {
+        auto& slot = slots[(size_t) i];
+        int expected = Slot::free;
+
+        // claimed keeps the disk thread away while the slot is set up
+        if (! slot.state.compare_exchange_strong (expected, Slot::claimed, std::memory_order_acquire))
+            continue;
+
+        slot.source = source;
+        slot.numChannels = source->getNumChannels();
+        slot.startFrame = startFrame;
+        slot.readPos.store (startFrame, std::memory_order_relaxed);
+        slot.writePos.store (startFrame, std::memory_order_relaxed);
+        slot.state.store (Slot::active, std::memory_order_release);
+        return i;
+    }
+
+    return -1;
+}
+
+void DiskStreamer::release (int slot) noexcept
+{
+    if (slot >= 0)
+        slots[(size_t) slot].state.store (Slot::releasing, std::memory_order_release);
+}
+
+void DiskStreamer::setConsumed (int slot, int64 frame) noexcept
+{
+    auto& s = slots[(size_t) slot];
+    s.readPos.store (juce::jmax (s.startFrame, frame), std::memory_order_release);
+}
+
+int DiskStreamer::read (int slot, int channel, int64 startFrame, int numFrames, float* dest) const noexcept
+{
+    const auto& s = slots[(size_t) slot];
+    const int64 written = s.writePos.load (std::memory_order_acquire);
+
+    if (startFrame < s.startFrame || numFrames <= 0)
+        return 0;
+
+    const int available = (int) juce::jlimit ((int64) 0, (int64) numFrames, written - startFrame);
+    const float* ring = s.ring.getReadPointer (juce::jmin (channel, s.numChannels - 1));
+    const int index = (int) (startFrame & (ringFrames - 1));
+    const int firstPart = juce::jmin (available, ringFrames - index);
+
+    juce::FloatVectorOperations::copy (dest, ring + index, firstPart);
+    if (available > firstPart)
+        juce::FloatVectorOperations::copy (dest + firstPart, ring, available - firstPart);
+
+    return available;
+}
+
+void DiskStreamer::run()
+{
+    while (! threadShouldExit())
+    {
+        bool didWork = false;
+
+        for (int i = 0; i < numSlots; ++i)
+        {
+            auto& slot = slots[(size_t) i];
+            const int state = slot.state.load (std::memory_order_acquire);
+
+            if (state == Slot::active)
+            {
+                didWork = fillSlot (slot) || didWork;
+            }
+            else if (state == Slot::releasing)
+            {
+                // may close the file, so it happens here rather than on the audio thread
+                slot.source.reset();
+                slot.state.store (Slot::free, std::memory_order_release);
+            }
+        }
+
+        if (! didWork)
+            wait (2);
+    }
+}
+
+bool DiskStreamer::fillSlot (Slot& slot)
+{
+    const int64 written = slot.writePos.load (std::memory_order_relaxed);
+    const int64 consumed = slot.readPos.load (std::memory_order_acquire);
+    const int64 limit = juce::jmin (slot.source->getLengthInSamples(), consumed + ringFrames);
+    const int num = (int) juce::jmin ((int64) readBuffer.getNumSamples(), limit - written);
+
+    if (num <= 0)
+        return false;
+
+    slot.source->read (readBuffer, written, num);
+
+    const int index = (int) (written & (ringFrames - 1));
+    const int firstPart = juce::jmin (num, ringFrames - index);
+
+    for (int ch = 0; ch < slot.numChannels; ++ch)
+    {
+        slot.ring.copyFrom (ch, index, readBuffer, ch, 0, firstPart);
+        if (num > firstPart)
+            slot.ring.copyFrom (ch, 0, readBuffer, ch, firstPart, num - firstPart);
+    }
+
+    slot.writePos.store (written + num, std::memory_order_release);
+    return true;
+}
@@ -0,0 +1,83 @@
+#pragma once
+
+#include <JuceHeader.h>
+#include <atomic>
+#include <memory>
+#include <mutex>
+
+// An open file for a streamed sample. Pooled samples are shared between
+// plugin instances, each with its own DiskStreamer thread, so reads are
+// serialised here; the audio thread never reads through it.
+class StreamSource
+{
+public:
+    StreamSource (std::unique_ptr<juce::AudioFormatReader> sourceReader, int numChannelsToRead);
+
+    int getNumChannels() const noexcept { return numChannels; }
+    int64 getLengthInSamples() const noexcept { return lengthInSamples; }
+
+    void read (juce::AudioBuffer<float>& dest, int64 startFrame, int numFrames);
+
+private:
+    std::unique_ptr<juce::AudioFormatReader> reader;
+    std::mutex readLock;
+    int numChannels;
+    int64 lengthInSamples;
+
+    JUCE_DECLARE_NON_COPYABLE (StreamSource)
+};
+
+// Background reader for streamed samples. Each sounding voice of a streamed
+// sample owns one slot: a fixed ring that this thread keeps filled ahead of
+// the voice's read position. All rings are allocated together, the first time
+// a streamed sample is loaded, so the RAM used for streaming does not grow
+// with the size of the files and costs nothing in instances that never stream.
+//
+// acquire/release/read/setConsumed are for the audio thread and never block.
+class DiskStreamer : private juce::Thread
+{
+public:
+    static constexpr int numSlots = 64;
+    static constexpr int ringFrames = 32768;   // per slot, power of two
+    static constexpr int headFrames = 65536;   // preloaded in RAM per streamed sample
+    static constexpr int maxChannels = 2;
+
+    DiskStreamer();
+    ~DiskStreamer() override;
+
+    // Allocates the rings and starts the disk thread, if not done already.
+    // Loader threads call this before a streamed sample reaches a player.
+    void prepare();
+
+    // Claims a slot that streams `source` from startFrame on; -1 if none is free.
+    int acquire (const std::shared_ptr<StreamSource>& source, int64 startFrame) noexcept;
+    void release (int slot) noexcept;
+    // Frames before `frame` are no longer needed and may be overwritten.
+    void setConsumed (int slot, int64 frame) noexcept;
+    // Copies up to numFrames from startFrame; returns how many were ready.
+    int read (int slot, int channel, int64 startFrame, int numFrames, float* dest) const noexcept;
+
+private:
+    struct Slot
+    {
+        enum State { free, claimed, active, releasing };
+
+        std::atomic<int> state { free };
+        std::shared_ptr<StreamSource> source;   // dropped by the disk thread, never the audio thread
+        int numChannels { 1 };
+        int64 startFrame { 0 };
+        std::atomic<int64> readPos { 0 };
+        std::atomic<int64> writePos { 0 };
+        juce::AudioBuffer<float> ring;
+    };
+
+    void run() override;
+    bool fillSlot (Slot& slot);
+
+    std::unique_ptr<Slot[]> slots;
+    juce::AudioBuffer<float> readBuffer;   // disk thread only
+    std::mutex prepareLock;
+    std::atomic<bool> prepared { false };  // acquire fails until the rings exist
+
+    JUCE_DECLARE_NON_COPYABLE (DiskStreamer)
+};
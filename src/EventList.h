@@ -0,0 +1,67 @@
+#pragma once
+
+#include <JuceHeader.h>
+#include <atomic>
+#include <vector>
+
+// A timestamped event for the current audio block.
+struct SamplerEvent
+{
+    enum class Type { noteOn, noteOff, controller, trigger };
+
+    Type type { Type::noteOn };
+    int sampleOffset { 0 };
+    int channel { 1 };
+    int number { 0 };    // note or controller number
+    int value { 0 };     // velocity or controller value
+    int playerId { 0 };  // trigger only
+};
+
+// Fixed-capacity, time-ordered list of the events for one block. Storage is
+// sized in prepare() so adding events on the audio thread never allocates;
+// events that do not fit are dropped and counted. The count can be read from
+// any thread.
+class EventList
+{
+public:
+    void prepare (int capacity)
+    {
+        events.resize ((size_t) juce::jmax (1, capacity));
+        numEvents = 0;
+    }
+
+    void clear() noexcept { numEvents = 0; }
+
+    bool add (const SamplerEvent& ev) noexcept
+    {
+        if (numEvents >= (int) events.size())
+        {
+            numDropped.store (numDropped.load (std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+            return false;
+        }
+
+        // MIDI arrives in time order, so this normally appends
+        int pos = numEvents;
+        while (pos > 0 && events[(size_t) pos - 1].sampleOffset > ev.sampleOffset)
+        {
+            events[(size_t) pos] = events[(size_t) pos - 1];
+            --pos;
+        }
+
+        events[(size_t) pos] = ev;
+        ++numEvents;
+        return true;
+    }
+
+    int size() const noexcept { return numEvents; }
+    int getCapacity() const noexcept { return (int) events.size(); }
+    int getNumDropped() const noexcept { return numDropped.load (std::memory_order_relaxed); }
+
+    const SamplerEvent* begin() const noexcept { return events.data(); }
+    const SamplerEvent* end() const noexcept { return events.data() + numEvents; }
+
+private:
+    std::vector<SamplerEvent> events;
+    int numEvents { 0 };
+    std::atomic<int> numDropped { 0 };   // written by the audio thread only
+};
@@ -8,6 +8,28 @@ HttpServerThread::HttpServerThread(PluginProcessor& _pluginProc)  :
     initAPI();
 }
 
+// Reads a zone from optional query params; anything left out keeps its Zone default.
+// Throws std::invalid_argument if a param is present but not a number.
+static Zone readZoneParams (const httplib::Request& req)
+{
+    Zone zone;
+
+    auto readInt = [&req] (const char* name, int& value)
+    {
+        auto it = req.params.find (name);
+        if (it != req.params.end())
+            value = std::stoi (it->second);
+    };
+
+    readInt ("low", zone.keyLow);
+    readInt ("high", zone.keyHigh);
+    readInt ("velLow", zone.velocityLow);
+    readInt ("velHigh", zone.velocityHigh);
+    readInt ("rr", zone.roundRobin);
+    readInt ("root", zone.rootKey);
+    return zone;
+}
+
 
 void HttpServerThread::initAPI()
 {
@@ -74,6 +96,27 @@ void HttpServerThread::initAPI()
         this->pluginProc.addSamplePlayerFromWeb();
         res.set_content("{\"status\":\"ok\"}", "application/json");
     });
+    svr.Post("/removeSamplePlayer", [this](const httplib::Request& req, httplib::Response& res) {
+        auto it = req.params.find("id");
+        if (it == req.params.end())
+        {
+            res.status = 400;
+            res.set_content("{\"status\":\"error\",\"message\":\"missing id\"}", "application/json");
+            return;
+        }
+
+        try
+        {
+            int id = std::stoi (it->second);
+            pluginProc.removeSamplePlayerFromWeb (id);
+            res.set_content("{\"status\":\"ok\"}", "application/json");
+        }
+        catch (const std::exception&)
+        {
+            res.status = 400;
+            res.set_content("{\"status\":\"error\",\"message\":\"invalid id\"}", "application/json");
+        }
+    });
     svr.Post("/loadSample", [this](const httplib::Request& req, httplib::Response& res) {
         auto it = req.params.find("id");
         if (it == req.params.end())
@@ -131,6 +174,37 @@ void HttpServerThread::initAPI()
         res.set_content (jsonStr, "application/json");
     });
 
+    svr.Get("/loadProgress", [this](const httplib::Request& req, httplib::Response& res) {
+        juce::ignoreUnused (req);
+        const auto json = juce::JSON::toString (pluginProc.getLoadProgress()).toStdString();
+        res.set_content (json, "application/json");
+    });
+
+    svr.Post("/cancelLoad", [this](const httplib::Request& req, httplib::Response& res) {
+        auto idIt = req.params.find("id");
+        if (idIt == req.params.end())
+        {
+            res.status = 400;
+            res.set_content("{\"status\":\"error\",\"message\":\"missing id\"}", "application/json");
+            return;
+        }
+
+        try
+        {
+            // zone defaults to the main sample
+            int id = std::stoi (idIt->second);
+            auto zoneIt = req.params.find("zone");
+            int zoneId = zoneIt != req.params.end() ? std::stoi (zoneIt->second) : 0;
+            pluginProc.cancelLoadFromWeb (id, zoneId);
+            res.set_content("{\"status\":\"ok\"}", "application/json");
+        }
+        catch (const std::exception&)
+        {
+            res.status = 400;
+            res.set_content("{\"status\":\"error\",\"message\":\"invalid parameters\"}", "application/json");
+        }
+    });
+
     svr.Post("/setRange", [this](const httplib::Request& req, httplib::Response& res) {
         auto idIt = req.params.find("id");
         auto lowIt = req.params.find("low");
@@ -158,6 +232,375 @@ void HttpServerThread::initAPI()
         }
     });
 
+    svr.Post("/setMidiChannel", [this](const httplib::Request& req, httplib::Response& res) {
+        auto idIt = req.params.find("id");
+        auto channelIt = req.params.find("channel");
+
+        if (idIt == req.params.end() || channelIt == req.params.end())
+        {
+            res.status = 400;
+            res.set_content("{\"status\":\"error\",\"message\":\"missing parameters\"}", "application/json");
+            return;
+        }
+
+        try
+        {
+            // channel: 0 for omni, 1-16 for a single channel
+            int id = std::stoi (idIt->second);
+            int channel = std::stoi (channelIt->second);
+            pluginProc.setMidiChannelFromWeb (id, channel);
+            res.set_content("{\"status\":\"ok\"}", "application/json");
+        }
+        catch (const std::exception&)
+        {
+            res.status = 400;
+            res.set_content("{\"status\":\"error\",\"message\":\"invalid parameters\"}", "application/json");
+        }
+    });
+
+    svr.Post("/setVoices", [this](const httplib::Request& req, httplib::Response& res) {
+        auto idIt = req.params.find("id");
+        auto polyIt = req.params.find("polyphony");
+
+        if (idIt == req.params.end() || polyIt == req.params.end())
+        {
+            res.status = 400;
+            res.set_content("{\"status\":\"error\",\"message\":\"missing parameters\"}", "application/json");
+            return;
+        }
+
+        // steal is optional: oldest, quietest or sameNote
+        auto stealIt = req.params.find("steal");
+        const juce::String steal = stealIt != req.params.end() ? juce::String (stealIt->second) : juce::String ("oldest");
+
+        try
+        {
+            int id = std::stoi (idIt->second);
+            int polyphony = std::stoi (polyIt->second);
+            pluginProc.setVoiceSettingsFromWeb (id, polyphony, steal);
+            res.set_content("{\"status\":\"ok\"}", "application/json");
+        }
+        catch (const std::exception&)
+        {
+            res.status = 400;
+            res.set_content("{\"status\":\"error\",\"message\":\"invalid parameters\"}", "application/json");
+        }
+    });
+
+    svr.Post("/setPitch", [this](const httplib::Request& req, httplib::Response& res) {
+        auto idIt = req.params.find("id");
+        auto rootIt = req.params.find("root");
+
+        if (idIt == req.params.end() || rootIt == req.params.end())
+        {
+            res.status = 400;
+            res.set_content("{\"status\":\"error\",\"message\":\"missing parameters\"}", "application/json");
+            return;
+        }
+
+        // interp is optional: linear, hermite or sinc
+        auto interpIt = req.params.find("interp");
+        const juce::String interp = interpIt != req.params.end() ? juce::String (interpIt->second) : juce::String ("hermite");
+
+        try
+        {
+            int id = std::stoi (idIt->second);
+            int root = std::stoi (rootIt->second);
+            pluginProc.setPitchSettingsFromWeb (id, root, interp);
+            res.set_content("{\"status\":\"ok\"}", "application/json");
+        }
+        catch (const std::exception&)
+        {
+            res.status = 400;
+            res.set_content("{\"status\":\"error\",\"message\":\"invalid parameters\"}", "application/json");
+        }
+    });
+
+    svr.Post("/setEnvelope", [this](const httplib::Request& req, httplib::Response& res) {
+        auto idIt = req.params.find("id");
+        if (idIt == req.params.end())
+        {
+            res.status = 400;
+            res.set_content("{\"status\":\"error\",\"message\":\"missing id\"}", "application/json");
+            return;
+        }
+
+        try
+        {
+            // attack/decay/release in ms, sustain 0-1, curve linear or exponential,
+            // oneShot 0 or 1; anything left out takes its default
+            SamplePlayer::Envelope envelope;
+
+            auto readFloat = [&req] (const char* name, float& value)
+            {
+                auto it = req.params.find (name);
+                if (it != req.params.end())
+                    value = std::stof (it->second);
+            };
+
+            readFloat ("attack", envelope.attackMs);
+            readFloat ("decay", envelope.decayMs);
+            readFloat ("sustain", envelope.sustain);
+            readFloat ("release", envelope.releaseMs);
+
+            auto curveIt = req.params.find("curve");
+            if (curveIt != req.params.end())
+                envelope.curve = SamplePlayer::envelopeCurveFromString (juce::String (curveIt->second));
+
+            auto oneShotIt = req.params.find("oneShot");
+            if (oneShotIt != req.params.end())
+                envelope.oneShot = std::stoi (oneShotIt->second) != 0;
+
+            int id = std::stoi (idIt->second);
+            pluginProc.setEnvelopeFromWeb (id, envelope);
+            res.set_content("{\"status\":\"ok\"}", "application/json");
+        }
+        catch (const std::exception&)
+        {
+            res.status = 400;
+            res.set_content("{\"status\":\"error\",\"message\":\"invalid parameters\"}", "application/json");
+        }
+    });
+
+    svr.Post("/setLoop", [this](const httplib::Request& req, httplib::Response& res) {
+        auto idIt = req.params.find("id");
+        if (idIt == req.params.end())
+        {
+            res.status = 400;
+            res.set_content("{\"status\":\"error\",\"message\":\"missing id\"}", "application/json");
+            return;
+        }
+
+        try
+        {
+            // enabled 0 or 1; start/end in file frames, -1 for the file's smpl loop;
+            // crossfade in frames; anything left out takes its default
+            SamplePlayer::Loop loop;
+
+            auto enabledIt = req.params.find("enabled");
+            if (enabledIt != req.params.end())
+                loop.enabled = std::stoi (enabledIt->second) != 0;
+
+            auto startIt = req.params.find("start");
+            if (startIt != req.params.end())
+                loop.start = std::stoll (startIt->second);
+
+            auto endIt = req.params.find("end");
+            if (endIt != req.params.end())
+                loop.end = std::stoll (endIt->second);
+
+            auto crossfadeIt = req.params.find("crossfade");
+            if (crossfadeIt != req.params.end())
+                loop.crossfade = std::stoi (crossfadeIt->second);
+
+            int id = std::stoi (idIt->second);
+            pluginProc.setLoopFromWeb (id, loop);
+            res.set_content("{\"status\":\"ok\"}", "application/json");
+        }
+        catch (const std::exception&)
+        {
+            res.status = 400;
+            res.set_content("{\"status\":\"error\",\"message\":\"invalid parameters\"}", "application/json");
+        }
+    });
+
+    svr.Post("/setStorage", [this](const httplib::Request& req, httplib::Response& res) {
+        auto idIt = req.params.find("id");
+        auto modeIt = req.params.find("mode");
+        auto formatIt = req.params.find("format");
+
+        // mode: memory, stream or mapped; format: float32, int16 or float16
+        if (idIt == req.params.end() || (modeIt == req.params.end() && formatIt == req.params.end()))
+        {
+            res.status = 400;
+            res.set_content("{\"status\":\"error\",\"message\":\"missing parameters\"}", "application/json");
+            return;
+        }
+
+        try
+        {
+            int id = std::stoi (idIt->second);
+            const juce::String mode = modeIt != req.params.end() ? juce::String (modeIt->second) : juce::String();
+            const juce::String format = formatIt != req.params.end() ? juce::String (formatIt->second) : juce::String();
+            pluginProc.setStorageFromWeb (id, mode, format);
+            res.set_content("{\"status\":\"ok\"}", "application/json");
+        }
+        catch (const std::exception&)
+        {
+            res.status = 400;
+            res.set_content("{\"status\":\"error\",\"message\":\"invalid parameters\"}", "application/json");
+        }
+    });
+
+    svr.Post("/setOutput", [this](const httplib::Request& req, httplib::Response& res) {
+        auto idIt = req.params.find("id");
+        auto busIt = req.params.find("bus");
+
+        if (idIt == req.params.end() || busIt == req.params.end())
+        {
+            res.status = 400;
+            res.set_content("{\"status\":\"error\",\"message\":\"missing parameters\"}", "application/json");
+            return;
+        }
+
+        try
+        {
+            // bus: 0 for the main output, 1-16 for the aux outputs
+            int id = std::stoi (idIt->second);
+            int bus = std::stoi (busIt->second);
+            pluginProc.setOutputBusFromWeb (id, bus);
+            res.set_content("{\"status\":\"ok\"}", "application/json");
+        }
+        catch (const std::exception&)
+        {
+            res.status = 400;
+            res.set_content("{\"status\":\"error\",\"message\":\"invalid parameters\"}", "application/json");
+        }
+    });
+
+    svr.Post("/addZone", [this](const httplib::Request& req, httplib::Response& res) {
+        auto idIt = req.params.find("id");
+        if (idIt == req.params.end())
+        {
+            res.status = 400;
+            res.set_content("{\"status\":\"error\",\"message\":\"missing id\"}", "application/json");
+            return;
+        }
+
+        try
+        {
+            // low/high/velLow/velHigh/rr/root are optional; a file chooser picks the sample
+            int id = std::stoi (idIt->second);
+            pluginProc.addZoneFromWeb (id, readZoneParams (req));
+            res.set_content("{\"status\":\"ok\"}", "application/json");
+        }
+        catch (const std::exception&)
+        {
+            res.status = 400;
+            res.set_content("{\"status\":\"error\",\"message\":\"invalid parameters\"}", "application/json");
+        }
+    });
+
+    svr.Post("/setZone", [this](const httplib::Request& req, httplib::Response& res) {
+        auto idIt = req.params.find("id");
+        auto zoneIt = req.params.find("zone");
+
+        if (idIt == req.params.end() || zoneIt == req.params.end())
+        {
+            res.status = 400;
+            res.set_content("{\"status\":\"error\",\"message\":\"missing parameters\"}", "application/json");
+            return;
+        }
+
+        try
+        {
+            int id = std::stoi (idIt->second);
+            int zoneId = std::stoi (zoneIt->second);
+            pluginProc.setZoneFromWeb (id, zoneId, readZoneParams (req));
+            res.set_content("{\"status\":\"ok\"}", "application/json");
+        }
+        catch (const std::exception&)
+        {
+            res.status = 400;
+            res.set_content("{\"status\":\"error\",\"message\":\"invalid parameters\"}", "application/json");
+        }
+    });
+
+    svr.Post("/removeZone", [this](const httplib::Request& req, httplib::Response& res) {
+        auto idIt = req.params.find("id");
+        auto zoneIt = req.params.find("zone");
+
+        if (idIt == req.params.end() || zoneIt == req.params.end())
+        {
+            res.status = 400;
+            res.set_content("{\"status\":\"error\",\"message\":\"missing parameters\"}", "application/json");
+            return;
+        }
+
+        try
+        {
+            int id = std::stoi (idIt->second);
+            int zoneId = std::stoi (zoneIt->second);
+            pluginProc.removeZoneFromWeb (id, zoneId);
+            res.set_content("{\"status\":\"ok\"}", "application/json");
+        }
+        catch (const std::exception&)
+        {
+            res.status = 400;
+            res.set_content("{\"status\":\"error\",\"message\":\"invalid parameters\"}", "application/json");
+        }
+    });
+
+    svr.Post("/setVelocityCurve", [this](const httplib::Request& req, httplib::Response& res) {
+        auto idIt = req.params.find("id");
+        auto curveIt = req.params.find("curve");
+
+        if (idIt == req.params.end() || curveIt == req.params.end())
+        {
+            res.status = 400;
+            res.set_content("{\"status\":\"error\",\"message\":\"missing parameters\"}", "application/json");
+            return;
+        }
+
+        try
+        {
+            // curve: fixed, linear, soft or hard
+            int id = std::stoi (idIt->second);
+            pluginProc.setVelocityCurveFromWeb (id, juce::String (curveIt->second));
+            res.set_content("{\"status\":\"ok\"}", "application/json");
+        }
+        catch (const std::exception&)
+        {
+            res.status = 400;
+            res.set_content("{\"status\":\"error\",\"message\":\"invalid parameters\"}", "application/json");
+        }
+    });
+
+    svr.Post("/setRenderThreads", [this](const httplib::Request& req, httplib::Response& res) {
+        auto it = req.params.find("count");
+        if (it == req.params.end())
+        {
+            res.status = 400;
+            res.set_content("{\"status\":\"error\",\"message\":\"missing count\"}", "application/json");
+            return;
+        }
+
+        try
+        {
+            // helper threads besides the audio thread; 0 turns parallel rendering off
+            int count = std::stoi (it->second);
+            pluginProc.setRenderThreadsFromWeb (count);
+            res.set_content("{\"status\":\"ok\"}", "application/json");
+        }
+        catch (const std::exception&)
+        {
+            res.status = 400;
+            res.set_content("{\"status\":\"error\",\"message\":\"invalid count\"}", "application/json");
+        }
+    });
+
+    svr.Post("/setMetering", [this](const httplib::Request& req, httplib::Response& res) {
+        auto it = req.params.find("truePeak");
+        if (it == req.params.end())
+        {
+            res.status = 400;
+            res.set_content("{\"status\":\"error\",\"message\":\"missing truePeak\"}", "application/json");
+            return;
+        }
+
+        try
+        {
+            // truePeak 0 or 1
+            pluginProc.setTruePeakMeteringFromWeb (std::stoi (it->second) != 0);
+            res.set_content("{\"status\":\"ok\"}", "application/json");
+        }
+        catch (const std::exception&)
+        {
+            res.status = 400;
+            res.set_content("{\"status\":\"error\",\"message\":\"invalid truePeak\"}", "application/json");
+        }
+    });
+
     svr.Post("/trigger", [this](const httplib::Request& req, httplib::Response& res) {
         auto it = req.params.find("id");
         if (it == req.params.end())
@@ -0,0 +1,192 @@
+#include "Interpolator.h"
+
+#include <array>
+#include <cmath>
+#include <memory>
+
+namespace
+{
+    // Blackman-windowed sinc, one row per phase. Each row also stores the
+    // difference to the next row so the kernel can interpolate between phases.
+    // `ratio` stretches the sinc to lower its cutoff to 1 / ratio of the
+    // source's Nyquist, for reading the source that much faster.
+    struct SincTable
+    {
+        explicit SincTable (double ratio = 1.0)
+        {
+            constexpr int half = Interpolator::sincTaps / 2;
+
+            for (int phase = 0; phase <= Interpolator::sincPhases; ++phase)
+            {
+                const double frac = (double) phase / (double) Interpolator::sincPhases;
+                double sum = 0.0;
+
+                for (int k = 0; k < Interpolator::sincTaps; ++k)
+                {
+                    // tap k sits at source offset (k - half + 1) from the read frame
+                    const double x = (double) (k - half + 1) - frac;
+                    const double xs = x / ratio;
+                    const double sinc = std::abs (xs) < 1.0e-9 ? 1.0 : std::sin (juce::MathConstants<double>::pi * xs) / (juce::MathConstants<double>::pi * xs);
+                    const double w = (x + (double) half) / (double) Interpolator::sincTaps;
+                    const double window = 0.42 - 0.5 * std::cos (juce::MathConstants<double>::twoPi * w)
+                                               + 0.08 * std::cos (2.0 * juce::MathConstants<double>::twoPi * w);
+                    coeffs[(size_t) phase][(size_t) k] = (float) (sinc * window);
+                    sum += sinc * window;
+                }
+
+                // unity gain at DC for every phase, so a lowered cutoff does not dip the level
+                for (auto& c : coeffs[(size_t) phase])
+                    c = (float) (c / sum);
+            }
+
+            for (int phase = 0; phase < Interpolator::sincPhases; ++phase)
+                for (int k = 0; k < Interpolator::sincTaps; ++k)
+                    deltas[(size_t) phase][(size_t) k] = coeffs[(size_t) phase + 1][(size_t) k] - coeffs[(size_t) phase][(size_t) k];
+        }
+
+        std::array<std::array<float, Interpolator::sincTaps>, Interpolator::sincPhases + 1> coeffs {};
+        std::array<std::array<float, Interpolator::sincTaps>, Interpolator::sincPhases> deltas {};
+    };
+
+    // Band b is for increments up to 2^(b / bandsPerOctave): a voice reads
+    // with the first band whose cutoff is low enough for its increment.
+    struct SincTables
+    {
+        static constexpr int bandsPerOctave = 4;
+
+        SincTables()
+        {
+            for (int band = 0; band < Interpolator::sincBands; ++band)
+                tables[(size_t) band] = std::make_unique<SincTable> (std::exp2 ((double) band / bandsPerOctave));
+        }
+
+        const SincTable& forIncrement (double increment) const noexcept
+        {
+            const int band = increment <= 1.0 ? 0 : (int) std::ceil (std::log2 (increment) * bandsPerOctave - 1.0e-9);
+            return *tables[(size_t) juce::jmin (band, Interpolator::sincBands - 1)];
+        }
+
+        std::array<std::unique_ptr<SincTable>, Interpolator::sincBands> tables;
+    };
+
+    const SincTables& getSincTables()
+    {
+        static const SincTables tables;
+        return tables;
+    }
+
+    void processLinear (const float* src, double startPhase, double increment, float* dest, int numOut) noexcept
+    {
+        for (int i = 0; i < numOut; ++i)
+        {
+            const double p = startPhase + increment * (double) i;
+            const int idx = (int) p;
+            const float f = (float) (p - (double) idx);
+            const float a = src[idx];
+            dest[i] = a + f * (src[idx + 1] - a);
+        }
+    }
+
+    void processHermite (const float* src, double startPhase, double increment, float* dest, int numOut) noexcept
+    {
+        for (int i = 0; i < numOut; ++i)
+        {
+            const double p = startPhase + increment * (double) i;
+            const int idx = (int) p;
+            const float f = (float) (p - (double) idx);
+            const float* s = src + idx;
+
+            // 4-point, 3rd-order Hermite (Catmull-Rom)
+            const float c0 = s[0];
+            const float c1 = 0.5f * (s[1] - s[-1]);
+            const float c2 = s[-1] - 2.5f * s[0] + 2.0f * s[1] - 0.5f * s[2];
+            const float c3 = 0.5f * (s[2] - s[-1]) + 1.5f * (s[0] - s[1]);
+            dest[i] = ((c3 * f + c2) * f + c1) * f + c0;
+        }
+    }
+
+    void processSinc (const float* src, double startPhase, double increment, float* dest, int numOut) noexcept
+    {
+        constexpr int half = Interpolator::sincTaps / 2;
+        const auto& table = getSincTables().forIncrement (increment);
+
+        for (int i = 0; i < numOut; ++i)
+        {
+            const double p = startPhase + increment * (double) i;
+            const int idx = (int) p;
+            const double phasePos = (p - (double) idx) * (double) Interpolator::sincPhases;
+            const int phase = juce::jmin ((int) phasePos, Interpolator::sincPhases - 1);
+            const float pf = (float) (phasePos - (double) phase);
+
+            const float* s = src + idx - half + 1;
+            const float* c = table.coeffs[(size_t) phase].data();
+            const float* d = table.deltas[(size_t) phase].data();
+
+            // four independent partial sums so the taps map onto vector lanes
+            float acc[4] = { 0.0f, 0.0f, 0.0f, 0.0f };
+            for (int k = 0; k < Interpolator::sincTaps; k += 4)
+                for (int lane = 0; lane < 4; ++lane)
+                    acc[lane] += s[k + lane] * (c[k + lane] + pf * d[k + lane]);
+
+            dest[i] = (acc[0] + acc[1]) + (acc[2] + acc[3]);
+        }
+    }
+}
+
+int Interpolator::getPreFrames (Mode mode) noexcept
+{
+    switch (mode)
+    {
+        case Mode::hermite: return 1;
+        case Mode::sinc:    return sincTaps / 2 - 1;
+        case Mode::linear:  break;
+    }
+    return 0;
+}
+
+int Interpolator::getPostFrames (Mode mode) noexcept
+{
+    switch (mode)
+    {
+        case Mode::hermite: return 2;
+        case Mode::sinc:    return sincTaps / 2;
+        case Mode::linear:  break;
+    }
+    return 1;
+}
+
+void Interpolator::process (Mode mode, const float* src, double startPhase, double increment,
+                            float* dest, int numOut) noexcept
+{
+    switch (mode)
+    {
+        case Mode::linear:  processLinear (src, startPhase, increment, dest, numOut); break;
+        case Mode::hermite: processHermite (src, startPhase, increment, dest, numOut); break;
+        case Mode::sinc:    processSinc (src, startPhase, increment, dest, numOut); break;
+    }
+}
+
+void Interpolator::prepareTables()
+{
+    juce::ignoreUnused (getSincTables());
+}
+
+juce::String Interpolator::modeToString (Mode mode)
+{
+    switch (mode)
+    {
+        case Mode::hermite: return "hermite";
+        case Mode::sinc:    return "sinc";
+        case Mode::linear:  break;
+    }
+    return "linear";
+}
+
+Interpolator::Mode Interpolator::modeFromString (const juce::String& name)
+{
+    if (name == "hermite")
+        return Mode::hermite;
+    if (name == "sinc")
+        return Mode::sinc;
+    return Mode::linear;
+}
@@ -0,0 +1,41 @@
+#pragma once
+
+#include <JuceHeader.h>
+
+// Fractional-rate resampling kernels used for pitched playback.
+//
+// All kernels read from a staged source block that the caller has padded with
+// getPreFrames() frames before and getPostFrames() frames after the region
+// being read, so the inner loops carry no bounds checks. Each output frame is
+// computed independently from (startPhase + i * increment), which keeps the
+// loops free of carried dependencies so the compiler can vectorise them.
+class Interpolator
+{
+public:
+    // Only sinc filters out what a raised pitch would fold back: its cutoff
+    // drops with the increment, a quarter octave at a time, down to a quarter
+    // of the source's Nyquist at two octaves up. Higher still, and with
+    // linear or hermite at any pitch above the root, some aliasing remains.
+    enum class Mode { linear, hermite, sinc };
+
+    static constexpr int sincTaps = 16;
+    static constexpr int sincPhases = 256;
+    static constexpr int sincBands = 9;   // cutoffs for increments up to 4
+
+    static int getPreFrames (Mode mode) noexcept;
+    static int getPostFrames (Mode mode) noexcept;
+
+    // Writes numOut frames to dest. src[0] is the frame at the integer part of
+    // the read position, startPhase is the fractional part in [0, 1).
+    static void process (Mode mode, const float* src, double startPhase, double increment,
+                         float* dest, int numOut) noexcept;
+
+    // Builds the polyphase sinc table. Call once off the audio thread.
+    static void prepareTables();
+
+    static juce::String modeToString (Mode mode);
+    static Mode modeFromString (const juce::String& name);
+
+private:
+    Interpolator() = delete;
+};
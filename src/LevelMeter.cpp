@@ -0,0 +1,178 @@
+#include "LevelMeter.h"
+#include <cmath>
+
+namespace
+{
+    constexpr float floorGain = 0.001f;   // LevelMeter::floorDb
+
+    // Windowed-sinc taps for the three points between samples at quarter
+    // steps. Point p lies p/4 of the way from tap 7 to tap 8.
+    struct TruePeakFilter
+    {
+        static constexpr int taps = 16;
+        float coefs[3][taps];
+
+        TruePeakFilter()
+        {
+            for (int p = 0; p < 3; ++p)
+            {
+                float sum = 0.0f;
+
+                for (int k = 0; k < taps; ++k)
+                {
+                    const double x = 7.0 + (p + 1) * 0.25 - k;
+                    const double sinc = juce::MathConstants<double>::pi * x;
+                    const double window = 0.5 + 0.5 * std::cos (juce::MathConstants<double>::pi * x / (taps / 2));
+                    coefs[p][k] = (float) (std::sin (sinc) / sinc * window);
+                    sum += coefs[p][k];
+                }
+
+                // unity gain at DC
+                for (int k = 0; k < taps; ++k)
+                    coefs[p][k] /= sum;
+            }
+        }
+    };
+
+    const TruePeakFilter truePeakFilter;
+
+    // Four independent sums so the loop vectorises without reassociation.
+    double sumOfSquares (const float* samples, int numSamples) noexcept
+    {
+        float s0 = 0.0f, s1 = 0.0f, s2 = 0.0f, s3 = 0.0f;
+        int i = 0;
+
+        for (; i + 4 <= numSamples; i += 4)
+        {
+            s0 += samples[i] * samples[i];
+            s1 += samples[i + 1] * samples[i + 1];
+            s2 += samples[i + 2] * samples[i + 2];
+            s3 += samples[i + 3] * samples[i + 3];
+        }
+
+        for (; i < numSamples; ++i)
+            s0 += samples[i] * samples[i];
+
+        return (double) s0 + s1 + s2 + s3;
+    }
+}
+
+void LevelMeter::prepare (double newSampleRate) noexcept
+{
+    sampleRate = newSampleRate;
+    coefBlockSize = 0;
+}
+
+void LevelMeter::reset() noexcept
+{
+    peak = 0.0f;
+    meanSquare = 0.0f;
+    blockPeak = 0.0f;
+    blockSumSquares = 0.0;
+    blockChannels = 0;
+    std::fill (&history[0][0], &history[0][0] + maxChannels * truePeakHistory, 0.0f);
+}
+
+void LevelMeter::beginBlock (bool truePeak) noexcept
+{
+    blockPeak = 0.0f;
+    blockSumSquares = 0.0;
+    blockChannels = 0;
+
+    if (truePeak != truePeakOn)
+    {
+        truePeakOn = truePeak;
+        std::fill (&history[0][0], &history[0][0] + maxChannels * truePeakHistory, 0.0f);
+    }
+}
+
+void LevelMeter::addSamples (const float* const* channels, int numChannels, int startSample, int numSamples) noexcept
+{
+    numChannels = juce::jmin (numChannels, maxChannels);
+    blockChannels = juce::jmax (blockChannels, numChannels);
+
+    for (int ch = 0; ch < numChannels; ++ch)
+    {
+        const float* samples = channels[ch] + startSample;
+        const auto range = juce::FloatVectorOperations::findMinAndMax (samples, numSamples);
+        blockPeak = juce::jmax (blockPeak, -range.getStart(), range.getEnd());
+        blockSumSquares += sumOfSquares (samples, numSamples);
+
+        if (truePeakOn)
+            blockPeak = juce::jmax (blockPeak, findTruePeak (ch, samples, numSamples));
+    }
+}
+
+float LevelMeter::findTruePeak (int channel, const float* samples, int numSamples) noexcept
+{
+    // the last samples of the previous call lead into this one
+    float staged[truePeakHistory + truePeakChunk];
+    float interp[truePeakChunk];
+    float* tail = history[channel];
+    std::copy (tail, tail + truePeakHistory, staged);
+
+    float result = 0.0f;
+
+    for (int done = 0; done < numSamples;)
+    {
+        const int num = juce::jmin (truePeakChunk, numSamples - done);
+        std::copy (samples + done, samples + done + num, staged + truePeakHistory);
+
+        for (const auto& coefs : truePeakFilter.coefs)
+        {
+            juce::FloatVectorOperations::clear (interp, num);
+            for (int k = 0; k < truePeakTaps; ++k)
+                juce::FloatVectorOperations::addWithMultiply (interp, staged + k, coefs[k], num);
+
+            const auto range = juce::FloatVectorOperations::findMinAndMax (interp, num);
+            result = juce::jmax (result, -range.getStart(), range.getEnd());
+        }
+
+        std::copy (staged + num, staged + num + truePeakHistory, staged);
+        done += num;
+    }
+
+    std::copy (staged, staged + truePeakHistory, tail);
+    return result;
+}
+
+void LevelMeter::endBlock (int numSamples) noexcept
+{
+    if (numSamples <= 0)
+        return;
+
+    // exact for any split of the same stretch of time into blocks
+    if (numSamples != coefBlockSize)
+    {
+        coefBlockSize = numSamples;
+        peakFall = (float) std::pow (0.1, numSamples / (peakReleaseMs * 0.001 * sampleRate));
+        rmsCoef = (float) std::exp (-numSamples / (rmsWindowMs * 0.001 * sampleRate));
+    }
+
+    const float blockMeanSquare = (float) (blockSumSquares / ((double) numSamples * juce::jmax (1, blockChannels)));
+    peak = juce::jmax (blockPeak, peak * peakFall);
+    meanSquare = blockMeanSquare + (meanSquare - blockMeanSquare) * rmsCoef;
+
+    // settle on silence rather than creep toward it
+    if (peak < floorGain)
+    {
+        peak = 0.0f;
+        meanSquare = 0.0f;
+    }
+}
+
+bool LevelMeter::isSilent() const noexcept
+{
+    return peak < floorGain;
+}
+
+float LevelMeter::getPeakDb() const noexcept
+{
+    return juce::jlimit (floorDb, ceilingDb, juce::Decibels::gainToDecibels (peak, floorDb));
+}
+
+float LevelMeter::getRmsDb() const noexcept
+{
+    const float rmsDb = juce::Decibels::gainToDecibels (std::sqrt (meanSquare), floorDb);
+    return juce::jlimit (floorDb, ceilingDb, juce::jmin (rmsDb, getPeakDb()));
+}
@@ -0,0 +1,59 @@
+#pragma once
+
+#include <JuceHeader.h>
+
+// Peak and RMS meter for one player's output, fed every stretch of audio it
+// renders on all of its channels. The readings move by ballistics given in
+// milliseconds and applied once per host block according to its length, so
+// they behave the same at any block size. With true-peak on, peaks between
+// samples are also caught by 4x oversampling, as in ITU-R BS.1770.
+//
+// Everything here runs on the audio thread, or on the render worker that
+// owns the player for the current chunk.
+class LevelMeter
+{
+public:
+    static constexpr int maxChannels = 2;
+    static constexpr float floorDb = -60.0f;
+    static constexpr float ceilingDb = 6.0f;
+    static constexpr double peakReleaseMs = 300.0;   // time for the peak reading to fall 20 dB
+    static constexpr double rmsWindowMs = 300.0;     // time constant of the RMS average
+
+    void prepare (double sampleRate) noexcept;
+    void reset() noexcept;
+
+    // Starts a host block. Turning true-peak on or off clears its history.
+    void beginBlock (bool truePeak) noexcept;
+    void addSamples (const float* const* channels, int numChannels, int startSample, int numSamples) noexcept;
+    // Applies the block to the readings. numSamples is the whole host block,
+    // counting any stretches where nothing was added as silence.
+    void endBlock (int numSamples) noexcept;
+
+    float getPeakDb() const noexcept;
+    // Never above the peak reading, which decays faster.
+    float getRmsDb() const noexcept;
+    // True once the peak reading has settled below floorDb.
+    bool isSilent() const noexcept;
+
+private:
+    static constexpr int truePeakTaps = 16;
+    static constexpr int truePeakHistory = truePeakTaps - 1;
+    static constexpr int truePeakChunk = 64;
+
+    float findTruePeak (int channel, const float* samples, int numSamples) noexcept;
+
+    double sampleRate { 44100.0 };
+    int coefBlockSize { 0 };   // block length the coefficients below were made for
+    float peakFall { 0.0f };
+    float rmsCoef { 0.0f };
+
+    float peak { 0.0f };
+    float meanSquare { 0.0f };
+
+    float blockPeak { 0.0f };
+    double blockSumSquares { 0.0 };
+    int blockChannels { 0 };
+
+    bool truePeakOn { false };
+    float history[maxChannels][truePeakHistory] {};
+};
@@ -0,0 +1,125 @@
+#include "LoaderPool.h"
+#include <algorithm>
+
+class LoaderPool::Worker : public juce::Thread
+{
+public:
+    Worker (LoaderPool& ownerToUse, int index)
+        : juce::Thread ("Sample loader " + juce::String (index)),
+          owner (ownerToUse)
+    {
+    }
+
+    void run() override
+    {
+        while (auto job = owner.next (*this))
+        {
+            job->startMs = juce::Time::getMillisecondCounterHiRes();
+            job->started.store (true, std::memory_order_release);
+
+            job->work (*job);
+
+            job->endMs.store (juce::Time::getMillisecondCounterHiRes(), std::memory_order_relaxed);
+            job->finished.store (true, std::memory_order_release);
+            job->work = nullptr;   // drop whatever the work captured
+
+            const std::lock_guard<std::mutex> guard (owner.lock);
+            current = nullptr;
+        }
+    }
+
+    LoaderPool& owner;
+    JobPtr current;   // guarded by the pool's lock
+};
+
+double LoaderPool::Job::getElapsedMs() const noexcept
+{
+    if (! hasStarted())
+        return 0.0;
+
+    const double end = finished.load (std::memory_order_acquire) ? endMs.load (std::memory_order_relaxed)
+                                                                 : juce::Time::getMillisecondCounterHiRes();
+    return end - startMs;
+}
+
+bool LoaderPool::runsAfter (const JobPtr& a, const JobPtr& b) noexcept
+{
+    return a->priority != b->priority ? a->priority < b->priority : a->order > b->order;
+}
+
+LoaderPool::LoaderPool (int numThreads)
+{
+    numThreads = juce::jlimit (1, maxThreads, numThreads);
+
+    for (int i = 0; i < numThreads; ++i)
+    {
+        workers.push_back (std::make_unique<Worker> (*this, i));
+        workers.back()->startThread();
+    }
+}
+
+LoaderPool::~LoaderPool()
+{
+    {
+        const std::lock_guard<std::mutex> guard (lock);
+        shuttingDown = true;
+        queue.clear();
+
+        for (auto& w : workers)
+            if (w->current != nullptr)
+                w->current->cancel();
+    }
+
+    wake.notify_all();
+
+    // running jobs stop at their next cancellation check
+    for (auto& w : workers)
+        w->stopThread (10000);
+}
+
+LoaderPool::JobPtr LoaderPool::add (int priority, std::function<void (Job&)> work)
+{
+    auto job = std::make_shared<Job>();
+    job->priority = priority;
+    job->work = std::move (work);
+
+    {
+        const std::lock_guard<std::mutex> guard (lock);
+        if (shuttingDown)
+        {
+            job->cancel();
+            return job;
+        }
+
+        job->order = nextOrder++;
+        queue.push_back (job);
+        std::push_heap (queue.begin(), queue.end(), runsAfter);
+    }
+
+    wake.notify_one();
+    return job;
+}
+
+LoaderPool::JobPtr LoaderPool::next (Worker& worker)
+{
+    std::unique_lock<std::mutex> guard (lock);
+
+    for (;;)
+    {
+        wake.wait (guard, [this] { return shuttingDown || ! queue.empty(); });
+
+        if (shuttingDown)
+            return nullptr;
+
+        std::pop_heap (queue.begin(), queue.end(), runsAfter);
+        auto job = std::move (queue.back());
+        queue.pop_back();
+
+        // cancelled while queued: never runs
+        if (! job->isCancelled())
+        {
+            worker.current = job;
+            return job;
+        }
+    }
+}
@@ -0,0 +1,83 @@
+#pragma once
+
+#include <JuceHeader.h>
+#include <atomic>
+#include <condition_variable>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+// Fixed set of background threads for loading and converting samples, so
+// dropping many files at once queues them rather than starting a thread per
+// file. Jobs run highest priority first, and in the order they were added
+// within a priority.
+//
+// Cancellation is cooperative: a job cancelled while queued is dropped
+// without running, and a running one is expected to poll isCancelled between
+// steps and return early.
+class LoaderPool
+{
+public:
+    static constexpr int maxThreads = 4;
+
+    class Job
+    {
+    public:
+        void cancel() noexcept { cancelled.store (true, std::memory_order_relaxed); }
+        bool isCancelled() const noexcept { return cancelled.load (std::memory_order_relaxed); }
+
+        // Progress, reported by the work function in bytes of decoded audio
+        // and readable from any thread.
+        void setTotalBytes (int64 bytes) noexcept { totalBytes.store (bytes, std::memory_order_relaxed); }
+        void addBytesDone (int64 bytes) noexcept { bytesDone.fetch_add (bytes, std::memory_order_relaxed); }
+        int64 getTotalBytes() const noexcept { return totalBytes.load (std::memory_order_relaxed); }
+        int64 getBytesDone() const noexcept { return bytesDone.load (std::memory_order_relaxed); }
+
+        bool hasStarted() const noexcept { return started.load (std::memory_order_acquire); }
+        // Time spent running so far; 0 while still queued.
+        double getElapsedMs() const noexcept;
+
+    private:
+        friend class LoaderPool;
+
+        int priority { 0 };
+        uint64 order { 0 };
+        std::function<void (Job&)> work;
+
+        std::atomic<bool> cancelled { false };
+        std::atomic<bool> started { false };
+        std::atomic<bool> finished { false };
+        double startMs { 0.0 };    // set before `started`
+        std::atomic<double> endMs { 0.0 };
+        std::atomic<int64> totalBytes { 0 };
+        std::atomic<int64> bytesDone { 0 };
+    };
+
+    using JobPtr = std::shared_ptr<Job>;
+
+    explicit LoaderPool (int numThreads);
+    // Drops queued jobs, cancels running ones and waits for them to return.
+    ~LoaderPool();
+
+    JobPtr add (int priority, std::function<void (Job&)> work);
+
+    int getNumThreads() const noexcept { return (int) workers.size(); }
+
+private:
+    class Worker;
+
+    // Blocks until there is a job to run; nullptr once shutting down.
+    JobPtr next (Worker& worker);
+    // Heap order: the job to run next compares greatest.
+    static bool runsAfter (const JobPtr& a, const JobPtr& b) noexcept;
+
+    std::vector<std::unique_ptr<Worker>> workers;
+    std::mutex lock;
+    std::condition_variable wake;
+    std::vector<JobPtr> queue;   // heap ordered by runsAfter
+    uint64 nextOrder { 0 };
+    bool shuttingDown { false };
+
+    JUCE_DECLARE_NON_COPYABLE (LoaderPool)
+};
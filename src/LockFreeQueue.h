@@ -0,0 +1,101 @@
+#pragma once
+
+#include <JuceHeader.h>
+#include <atomic>
+#include <memory>
+
+// Bounded multi-producer / multi-consumer queue (Vyukov style).
+// All storage is allocated up front, so push and pop never allocate and never
+// block; push fails when the queue is full and pop fails when it is empty.
+// Items are moved in and out of preconstructed cells, so T must be default
+// constructible and cheaply move-assignable.
+template <typename T>
+class LockFreeQueue
+{
+public:
+    explicit LockFreeQueue (int minCapacity)
+        : capacity ((size_t) juce::nextPowerOfTwo (juce::jmax (2, minCapacity))),
+          mask (capacity - 1),
+          cells (new Cell[capacity])
+    {
+        for (size_t i = 0; i < capacity; ++i)
+            cells[i].sequence.store (i, std::memory_order_relaxed);
+    }
+
+    bool push (T&& item) noexcept
+    {
+        auto pos = enqueuePos.load (std::memory_order_relaxed);
+
+        for (;;)
+        {
+            auto& cell = cells[pos & mask];
+            const auto seq = cell.sequence.load (std::memory_order_acquire);
+            const auto diff = (std::ptrdiff_t) seq - (std::ptrdiff_t) pos;
+
+            if (diff == 0)
+            {
+                if (enqueuePos.compare_exchange_weak (pos, pos + 1, std::memory_order_relaxed))
+                {
+                    cell.value = std::move (item);
+                    cell.sequence.store (pos + 1, std::memory_order_release);
+                    return true;
+                }
+            }
+            else if (diff < 0)
+            {
+                return false; // full
+            }
+            else
+            {
+                pos = enqueuePos.load (std::memory_order_relaxed);
+            }
+        }
+    }
+
+    bool pop (T& item) noexcept
+    {
+        auto pos = dequeuePos.load (std::memory_order_relaxed);
+
+        for (;;)
+        {
+            auto& cell = cells[pos & mask];
+            const auto seq = cell.sequence.load (std::memory_order_acquire);
+            const auto diff = (std::ptrdiff_t) seq - (std::ptrdiff_t) (pos + 1);
+
+            if (diff == 0)
+            {
+                if (dequeuePos.compare_exchange_weak (pos, pos + 1, std::memory_order_relaxed))
+                {
+                    item = std::move (cell.value);
+                    cell.sequence.store (pos + mask + 1, std::memory_order_release);
+                    return true;
+                }
+            }
+            else if (diff < 0)
+            {
+                return false; // empty
+            }
+            else
+            {
+                pos = dequeuePos.load (std::memory_order_relaxed);
+            }
+        }
+    }
+
+    int getCapacity() const noexcept { return (int) capacity; }
+
+private:
+    struct Cell
+    {
+        std::atomic<size_t> sequence { 0 };
+        T value {};
+    };
+
+    const size_t capacity;
+    const size_t mask;
+    std::unique_ptr<Cell[]> cells;
+    alignas (64) std::atomic<size_t> enqueuePos { 0 };
+    alignas (64) std::atomic<size_t> dequeuePos { 0 };
+
+    JUCE_DECLARE_NON_COPYABLE (LockFreeQueue)
+};
@@ -0,0 +1,126 @@
+#include "OfflineResampler.h"
+
+#include <cmath>
+#include <vector>
+
+namespace
+{
+    constexpr int zeroCrossings = 32;     // kernel half-width in zero crossings
+    constexpr int tableResolution = 512;  // kernel points per zero crossing
+    constexpr double kaiserBeta = 9.0;    // roughly -90dB stopband
+    constexpr double rolloff = 0.95;      // cutoff as a fraction of the lower Nyquist
+
+    double besselI0 (double x)
+    {
+        double sum = 1.0, term = 1.0;
+        const double halfX = x * 0.5;
+
+        for (int k = 1; k < 50; ++k)
+        {
+            term *= (halfX / (double) k) * (halfX / (double) k);
+            sum += term;
+            if (term < sum * 1.0e-12)
+                break;
+        }
+
+        return sum;
+    }
+
+    // One side of the windowed sinc, sampled finely enough that linear
+    // interpolation between points is well below the stopband.
+    struct KernelTable
+    {
+        KernelTable()
+        {
+            const int size = zeroCrossings * tableResolution + 2;
+            values.resize ((size_t) size);
+            const double norm = besselI0 (kaiserBeta);
+
+            for (int i = 0; i < size; ++i)
+            {
+                const double x = (double) i / (double) tableResolution;
+                const double sinc = i == 0 ? 1.0 : std::sin (juce::MathConstants<double>::pi * x) / (juce::MathConstants<double>::pi * x);
+                const double r = x / (double) zeroCrossings;
+                const double window = r < 1.0 ? besselI0 (kaiserBeta * std::sqrt (1.0 - r * r)) / norm : 0.0;
+                values[(size_t) i] = (float) (sinc * window);
+            }
+        }
+
+        float lookup (double x) const noexcept
+        {
+            const double pos = std::abs (x) * (double) tableResolution;
+            const int idx = (int) pos;
+
+            if (idx >= (int) values.size() - 1)
+                return 0.0f;
+
+            const float f = (float) (pos - (double) idx);
+            return values[(size_t) idx] + f * (values[(size_t) idx + 1] - values[(size_t) idx]);
+        }
+
+        std::vector<float> values;
+    };
+
+    const KernelTable& getKernel()
+    {
+        static const KernelTable table;
+        return table;
+    }
+}
+
+bool OfflineResampler::needsConversion (double sourceRate, double targetRate) noexcept
+{
+    return sourceRate > 0.0 && targetRate > 0.0 && std::abs (sourceRate - targetRate) > 0.5;
+}
+
+std::unique_ptr<juce::AudioBuffer<float>> OfflineResampler::resample (const juce::AudioBuffer<float>& source,
+                                                                      double sourceRate,
+                                                                      double targetRate)
+{
+    const int numChannels = source.getNumChannels();
+    const int numIn = source.getNumSamples();
+
+    if (! needsConversion (sourceRate, targetRate) || numIn == 0)
+        return std::make_unique<juce::AudioBuffer<float>> (source);
+
+    const auto& kernel = getKernel();
+    const double step = sourceRate / targetRate;                        // input frames per output frame
+    const double cutoff = juce::jmin (1.0, targetRate / sourceRate) * rolloff;
+    const double halfWidth = (double) zeroCrossings / cutoff;          // in input frames
+    const int numOut = (int) std::ceil ((double) numIn / step);
+
+    auto result = std::make_unique<juce::AudioBuffer<float>> (numChannels, numOut);
+    std::vector<float> weights;
+
+    for (int i = 0; i < numOut; ++i)
+    {
+        const double t = (double) i * step;
+        const int first = juce::jmax (0, (int) std::ceil (t - halfWidth));
+        const int last = juce::jmin (numIn - 1, (int) std::floor (t + halfWidth));
+        const int numTaps = last - first + 1;
+
+        if (numTaps <= 0)
+        {
+            for (int ch = 0; ch < numChannels; ++ch)
+                result->setSample (ch, i, 0.0f);
+            continue;
+        }
+
+        // the weights are shared by every channel
+        weights.resize ((size_t) numTaps);
+        for (int n = 0; n < numTaps; ++n)
+            weights[(size_t) n] = (float) cutoff * kernel.lookup ((t - (double) (first + n)) * cutoff);
+
+        for (int ch = 0; ch < numChannels; ++ch)
+        {
+            const float* src = source.getReadPointer (ch, first);
+            float acc = 0.0f;
+            for (int n = 0; n < numTaps; ++n)
+                acc += src[n] * weights[(size_t) n];
+
+            result->setSample (ch, i, acc);
+        }
+    }
+
+    return result;
+}
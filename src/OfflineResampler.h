@@ -0,0 +1,23 @@
+#pragma once
+
+#include <JuceHeader.h>
+#include <memory>
+
+// High-quality sample-rate conversion of whole buffers, used by the loader
+// threads so playback at the host rate needs no real-time resampling.
+class OfflineResampler
+{
+public:
+    // Kaiser-windowed sinc conversion. When downsampling the cutoff follows the
+    // target Nyquist so the result is band-limited. Slow; never call this on
+    // the audio thread.
+    static std::unique_ptr<juce::AudioBuffer<float>> resample (const juce::AudioBuffer<float>& source,
+                                                               double sourceRate,
+                                                               double targetRate);
+
+    // True when the rates differ by more than rounding noise.
+    static bool needsConversion (double sourceRate, double targetRate) noexcept;
+
+private:
+    OfflineResampler() = delete;
+};
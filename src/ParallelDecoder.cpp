@@ -0,0 +1,303 @@
+#include "ParallelDecoder.h"
+#include <atomic>
+#include <cmath>
+#include <condition_variable>
+#include <mutex>
+#include <vector>
+
+struct ParallelDecoder::Shared
+{
+    struct Range
+    {
+        int64 start { 0 };
+        int num { 0 };
+
+        // under lock
+        int done { 0 };
+        std::vector<float> leadIn;   // the preroll's last frames, seamCheckFrames per channel
+        bool leadInReady { false };
+        bool seamMatched { false };
+    };
+
+    SampleData* data { nullptr };
+    LoaderPool::Job* job { nullptr };
+    int numFrames { 0 };
+    int headFrames { 0 };
+    int numChannels { 0 };
+    std::function<void()> onHeadReady;   // caller only
+
+    std::unique_ptr<Range[]> ranges;
+    int numRanges { 0 };
+
+    Range& getRange (int index) noexcept { return ranges[(size_t) index]; }
+    std::atomic<int> nextRange { 1 };    // range 0 is the caller's
+    std::atomic<bool> stop { false };    // cancelled, or the caller takes over
+
+    std::mutex lock;
+    std::condition_variable finished;
+    int numFinished { 0 };
+    int verified { 0 };   // ranges before this are complete and their seams matched
+    bool failed { false };
+    bool headReady { false };
+
+    bool shouldStop() const noexcept
+    {
+        return stop.load (std::memory_order_relaxed) || (job != nullptr && job->isCancelled());
+    }
+};
+
+bool ParallelDecoder::canSplit (const juce::AudioFormat* format, int64 numFrames)
+{
+    if (format == nullptr || numFrames < 2 * framesPerRange)
+        return false;
+
+   #if JUCE_USE_FLAC
+    if (dynamic_cast<const juce::FlacAudioFormat*> (format) != nullptr)
+        return true;
+   #endif
+   #if JUCE_USE_OGGVORBIS
+    if (dynamic_cast<const juce::OggVorbisAudioFormat*> (format) != nullptr)
+        return true;
+   #endif
+
+    return false;
+}
+
+void ParallelDecoder::readPiece (juce::AudioFormatReader& reader, SampleData& data, int64 start, int num,
+                                 juce::AudioBuffer<float>& scratch)
+{
+    if (! data.isPacked())
+    {
+        reader.read (&data.buffer, (int) start, num, start, true, true);
+        return;
+    }
+
+    reader.read (&scratch, 0, num, start, true, true);
+    for (int ch = 0; ch < data.packedChannels; ++ch)
+        CompactStorage::encode (data.packedFormat, scratch.getReadPointer (ch),
+                                data.packed.data() + (size_t) ch * (size_t) data.lengthInSamples + (size_t) start, num);
+}
+
+bool ParallelDecoder::decode (juce::AudioFormatReader& reader, const ReaderFactory& openReader, SampleData& data,
+                              int numFrames, int headFrames, LoaderPool& pool, int helperPriority,
+                              LoaderPool::Job* job, const std::function<void()>& onHeadReady)
+{
+    auto shared = std::make_shared<Shared>();
+    shared->data = &data;
+    shared->job = job;
+    shared->numFrames = numFrames;
+    shared->headFrames = headFrames;
+    shared->numChannels = data.isPacked() ? data.packedChannels : data.buffer.getNumChannels();
+    shared->onHeadReady = onHeadReady;
+    shared->numRanges = (int) juce::jlimit ((int64) 1, (int64) maxRanges, (int64) numFrames / framesPerRange);
+    shared->ranges.reset (new Shared::Range[(size_t) shared->numRanges]);
+
+    for (int i = 0; i < shared->numRanges; ++i)
+    {
+        auto& range = shared->getRange (i);
+        range.start = (int64) numFrames * i / shared->numRanges;
+        range.num = (int) ((int64) numFrames * (i + 1) / shared->numRanges - range.start);
+    }
+
+    data.framesLoaded.store (0, std::memory_order_release);
+
+    if (job != nullptr)
+        job->setTotalBytes ((int64) numFrames * shared->numChannels * (int64) sizeof (float));
+
+    // One helper per range; a helper that finds every range taken returns at
+    // once. Helpers only hold the shared state, so any still queued after the
+    // decode has finished are harmless.
+    for (int i = 1; i < shared->numRanges; ++i)
+    {
+        pool.add (helperPriority, [shared, openReader] (LoaderPool::Job& helper)
+        {
+            const int index = shared->nextRange.fetch_add (1);
+            if (index >= shared->numRanges)
+                return;
+
+            std::unique_ptr<juce::AudioFormatReader> rangeReader;
+            if (! helper.isCancelled())
+                rangeReader = openReader();
+
+            decodeRange (*shared, index, rangeReader.get());
+        });
+    }
+
+    decodeRange (*shared, 0, &reader);
+
+    for (int index = shared->nextRange.fetch_add (1); index < shared->numRanges; index = shared->nextRange.fetch_add (1))
+        decodeRange (*shared, index, &reader);
+
+    int resumeRange = 0;
+    {
+        std::unique_lock<std::mutex> guard (shared->lock);
+        shared->finished.wait (guard, [&] { return shared->numFinished == shared->numRanges; });
+
+        if (job != nullptr && job->isCancelled())
+            return false;
+
+        if (! shared->failed || shared->verified == shared->numRanges)
+            return true;
+
+        // the first range not verified carries on from its own start if its
+        // seam matched, and otherwise from the previous range's
+        resumeRange = shared->verified;
+        if (resumeRange > 0 && ! shared->getRange (resumeRange).seamMatched)
+            --resumeRange;
+    }
+
+    // Decode straight through from there. Frames before framesLoaded are in
+    // use and stay as they are; the ones after are written again.
+    const int64 resumeAt = data.framesLoaded.load (std::memory_order_acquire);
+    int64 pos = juce::jmax ((int64) 0, shared->getRange (resumeRange).start - (resumeRange > 0 ? prerollFrames : 0));
+    juce::AudioBuffer<float> scratch (shared->numChannels, juce::jmax (framesPerRead, headFrames));
+
+    while (pos < numFrames)
+    {
+        if (job != nullptr && job->isCancelled())
+            return false;
+
+        if (pos < resumeAt)
+        {
+            const int num = (int) juce::jmin ((int64) framesPerRead, resumeAt - pos);
+            reader.read (&scratch, 0, num, pos, true, true);
+            pos += num;
+            continue;
+        }
+
+        const int num = (int) juce::jmin ((int64) framesPerRead, (int64) numFrames - pos);
+        readPiece (reader, data, pos, num, scratch);
+        pos += num;
+        data.framesLoaded.store (pos, std::memory_order_release);
+
+        if (! shared->headReady && pos >= headFrames && pos < numFrames)
+        {
+            shared->headReady = true;
+            if (onHeadReady != nullptr)
+                onHeadReady();
+        }
+    }
+
+    return true;
+}
+
+void ParallelDecoder::decodeRange (Shared& shared, int index, juce::AudioFormatReader* reader)
+{
+    auto& range = shared.getRange (index);
+    const int64 bytesPerFrame = (int64) shared.numChannels * (int64) sizeof (float);
+
+    if (reader == nullptr)
+    {
+        shared.stop.store (true, std::memory_order_relaxed);
+
+        const std::lock_guard<std::mutex> guard (shared.lock);
+        shared.failed = true;
+    }
+    else
+    {
+        juce::AudioBuffer<float> scratch (shared.numChannels, juce::jmax (framesPerRead, shared.headFrames));
+
+        if (index > 0 && ! shared.shouldStop())
+        {
+            const int64 from = juce::jmax ((int64) 0, range.start - prerollFrames);
+            const int lead = (int) (range.start - from);
+            const int numToCheck = juce::jmin (seamCheckFrames, lead);
+            reader->read (&scratch, 0, lead, from, true, true);
+
+            // compared as stored, so packed frames are checked after packing
+            std::vector<float> leadIn ((size_t) (shared.numChannels * numToCheck));
+            std::vector<uint16> packed ((size_t) numToCheck);
+
+            for (int ch = 0; ch < shared.numChannels; ++ch)
+            {
+                float* dest = leadIn.data() + (size_t) (ch * numToCheck);
+                juce::FloatVectorOperations::copy (dest, scratch.getReadPointer (ch, lead - numToCheck), numToCheck);
+
+                if (shared.data->isPacked())
+                {
+                    CompactStorage::encode (shared.data->packedFormat, dest, packed.data(), numToCheck);
+                    CompactStorage::decode (shared.data->packedFormat, packed.data(), dest, numToCheck);
+                }
+            }
+
+            const std::lock_guard<std::mutex> guard (shared.lock);
+            range.leadIn = std::move (leadIn);
+            range.leadInReady = true;
+            advance (shared);
+        }
+
+        for (int pos = 0; pos < range.num;)
+        {
+            if (shared.shouldStop())
+                break;
+
+            // the caller's first piece is just the head, handed out before the rest is read
+            const int num = juce::jmin (index == 0 && pos == 0 ? shared.headFrames : framesPerRead, range.num - pos);
+            readPiece (*reader, *shared.data, range.start + pos, num, scratch);
+            pos += num;
+
+            if (shared.job != nullptr)
+                shared.job->addBytesDone ((int64) num * bytesPerFrame);
+
+            bool headReady = false;
+            {
+                const std::lock_guard<std::mutex> guard (shared.lock);
+                range.done = pos;
+                advance (shared);
+
+                if (index == 0 && ! shared.headReady && pos >= shared.headFrames && pos < shared.numFrames)
+                    headReady = shared.headReady = true;
+            }
+
+            if (headReady && shared.onHeadReady != nullptr)
+                shared.onHeadReady();
+        }
+    }
+
+    const std::lock_guard<std::mutex> guard (shared.lock);
+    ++shared.numFinished;
+    shared.finished.notify_all();
+}
+
+void ParallelDecoder::advance (Shared& shared)
+{
+    // Under lock. Moves framesLoaded up through the ranges written so far,
+    // checking each seam once the range before it is complete.
+    while (shared.verified < shared.numRanges)
+    {
+        auto& range = shared.getRange (shared.verified);
+
+        if (shared.verified > 0 && ! range.seamMatched)
+        {
+            if (! range.leadInReady)
+                return;
+
+            const int numToCheck = (int) range.leadIn.size() / shared.numChannels;
+            std::vector<float> written ((size_t) numToCheck);
+
+            for (int ch = 0; ch < shared.numChannels; ++ch)
+            {
+                shared.data->readFrames (ch, range.start - numToCheck, numToCheck, written.data());
+                const float* expected = range.leadIn.data() + (size_t) (ch * numToCheck);
+
+                for (int i = 0; i < numToCheck; ++i)
+                {
+                    if (std::abs (written[(size_t) i] - expected[i]) > 1.0e-6f)
+                    {
+                        shared.failed = true;
+                        shared.stop.store (true, std::memory_order_relaxed);
+                        return;
+                    }
+                }
+            }
+
+            range.seamMatched = true;
+        }
+
+        shared.data->framesLoaded.store (range.start + range.done, std::memory_order_release);
+        if (range.done < range.num)
+            return;
+
+        ++shared.verified;
+    }
+}
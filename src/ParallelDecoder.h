@@ -0,0 +1,58 @@
+#pragma once
+
+#include <JuceHeader.h>
+#include <functional>
+#include <memory>
+#include "LoaderPool.h"
+#include "SampleData.h"
+
+// Decodes one long compressed file on several loader threads at once. The
+// file is split into ranges, each read by its own reader straight into the
+// sample's buffer or packed frames.
+//
+// A reader seeking into the middle of a file can produce different frames
+// from one decoding it from the start: lapped transforms and bit
+// reservoirs reach back into earlier frames. Each range therefore starts
+// decoding prerollFrames early and throws them away. The last of those are
+// also compared against what the previous range wrote there. Frames only
+// count as loaded once the seam before them has matched. On a mismatch the
+// rest of the file is decoded on the calling thread, carrying on from the
+// last range that matched.
+//
+// The calling thread works through ranges too, so the decode never waits on
+// pool threads that are busy elsewhere.
+class ParallelDecoder
+{
+public:
+    static constexpr int framesPerRead = 65536;
+    static constexpr int64 framesPerRange = 1 << 20;
+    static constexpr int maxRanges = 32;
+    static constexpr int prerollFrames = 8192;     // covers a Vorbis block
+    static constexpr int seamCheckFrames = 64;
+
+    using ReaderFactory = std::function<std::unique_ptr<juce::AudioFormatReader>()>;
+
+    // Formats whose readers seek to any frame, for files long enough to be
+    // worth more than one range. MP3 is not among them: JUCE's MP3 reader
+    // does not seek to the exact frame, so no preroll makes its seams match.
+    static bool canSplit (const juce::AudioFormat* format, int64 numFrames);
+
+    // Decodes frames [start, start + num) into the same frames of data,
+    // through scratch when data is packed. scratch must hold num frames.
+    static void readPiece (juce::AudioFormatReader& reader, SampleData& data, int64 start, int num,
+                           juce::AudioBuffer<float>& scratch);
+
+    // Decodes the opening numFrames into data as readAudio does, with helper
+    // jobs added to pool at helperPriority. Returns false if job is cancelled.
+    static bool decode (juce::AudioFormatReader& reader, const ReaderFactory& openReader, SampleData& data,
+                        int numFrames, int headFrames, LoaderPool& pool, int helperPriority,
+                        LoaderPool::Job* job, const std::function<void()>& onHeadReady);
+
+private:
+    struct Shared;
+
+    static void decodeRange (Shared& shared, int index, juce::AudioFormatReader* reader);
+    static void advance (Shared& shared);
+
+    ParallelDecoder() = delete;
+};
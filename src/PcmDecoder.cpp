@@ -0,0 +1,170 @@
+#include "PcmDecoder.h"
+
+#include <cstring>
+
+namespace
+{
+    // Each loop handles one encoding with the frame stride known, so the
+    // common little-endian cases compile to plain strided converts.
+    template <bool littleEndian>
+    void decodeInt16 (const uint8* src, int stride, float* dest, int numFrames) noexcept
+    {
+        constexpr float scale = 1.0f / 32768.0f;
+
+        for (int i = 0; i < numFrames; ++i, src += stride)
+        {
+            const auto v = littleEndian ? (int16) (src[0] | (src[1] << 8))
+                                        : (int16) ((src[0] << 8) | src[1]);
+            dest[i] = (float) v * scale;
+        }
+    }
+
+    template <bool littleEndian>
+    void decodeInt24 (const uint8* src, int stride, float* dest, int numFrames) noexcept
+    {
+        constexpr float scale = 1.0f / 8388608.0f;
+
+        for (int i = 0; i < numFrames; ++i, src += stride)
+        {
+            // assemble in the top three bytes so the shift sign-extends
+            const auto v = littleEndian ? (int32) (((uint32) src[2] << 24) | ((uint32) src[1] << 16) | ((uint32) src[0] << 8))
+                                        : (int32) (((uint32) src[0] << 24) | ((uint32) src[1] << 16) | ((uint32) src[2] << 8));
+            dest[i] = (float) (v >> 8) * scale;
+        }
+    }
+
+    template <bool littleEndian>
+    uint32 readWord (const uint8* src) noexcept
+    {
+        return littleEndian ? ((uint32) src[0] | ((uint32) src[1] << 8) | ((uint32) src[2] << 16) | ((uint32) src[3] << 24))
+                            : (((uint32) src[0] << 24) | ((uint32) src[1] << 16) | ((uint32) src[2] << 8) | (uint32) src[3]);
+    }
+
+    template <bool littleEndian>
+    void decodeInt32 (const uint8* src, int stride, float* dest, int numFrames) noexcept
+    {
+        constexpr float scale = 1.0f / 2147483648.0f;
+
+        for (int i = 0; i < numFrames; ++i, src += stride)
+            dest[i] = (float) (int32) readWord<littleEndian> (src) * scale;
+    }
+
+    template <bool littleEndian>
+    void decodeFloat32 (const uint8* src, int stride, float* dest, int numFrames) noexcept
+    {
+        for (int i = 0; i < numFrames; ++i, src += stride)
+        {
+            const auto bits = readWord<littleEndian> (src);
+            std::memcpy (dest + i, &bits, sizeof (float));
+        }
+    }
+
+    template <bool littleEndian>
+    void decodeWithOrder (const PcmDecoder::Format& format, const uint8* src, float* dest, int numFrames) noexcept
+    {
+        const int stride = format.bytesPerFrame;
+
+        switch (format.encoding)
+        {
+            case PcmDecoder::Encoding::int16:   decodeInt16<littleEndian>   (src, stride, dest, numFrames); break;
+            case PcmDecoder::Encoding::int24:   decodeInt24<littleEndian>   (src, stride, dest, numFrames); break;
+            case PcmDecoder::Encoding::int32:   decodeInt32<littleEndian>   (src, stride, dest, numFrames); break;
+            case PcmDecoder::Encoding::float32: decodeFloat32<littleEndian> (src, stride, dest, numFrames); break;
+        }
+    }
+}
+
+bool PcmDecoder::describe (const juce::AudioFormatReader& reader, bool littleEndian, Format& format) noexcept
+{
+    if (reader.numChannels == 0)
+        return false;
+
+    if (reader.usesFloatingPointData)
+    {
+        if (reader.bitsPerSample != 32)
+            return false;
+
+        format.encoding = Encoding::float32;
+    }
+    else
+    {
+        switch (reader.bitsPerSample)
+        {
+            case 16: format.encoding = Encoding::int16; break;
+            case 24: format.encoding = Encoding::int24; break;
+            case 32: format.encoding = Encoding::int32; break;
+            default: return false;
+        }
+    }
+
+    format.littleEndian = littleEndian;
+    format.numChannels = (int) reader.numChannels;
+    format.bytesPerFrame = format.numChannels * (int) (reader.bitsPerSample / 8);
+    return true;
+}
+
+bool PcmDecoder::findSampleData (const void* fileData, int64 fileSize, bool littleEndian,
+                                 int64& dataOffset, int64& dataBytes) noexcept
+{
+    const auto* file = static_cast<const uint8*> (fileData);
+    if (fileSize < 12)
+        return false;
+
+    // WAV chunks are little-endian and AIFF chunks big-endian, as their samples are
+    const auto readSize = [littleEndian] (const uint8* p) { return (int64) (littleEndian ? readWord<true> (p) : readWord<false> (p)); };
+    const bool isWav = std::memcmp (file, "RIFF", 4) == 0 || std::memcmp (file, "RF64", 4) == 0;
+    const bool isAiff = std::memcmp (file, "FORM", 4) == 0;
+
+    if (littleEndian ? ! (isWav && std::memcmp (file + 8, "WAVE", 4) == 0)
+                     : ! (isAiff && (std::memcmp (file + 8, "AIFF", 4) == 0 || std::memcmp (file + 8, "AIFC", 4) == 0)))
+        return false;
+
+    int64 rf64DataBytes = -1;
+
+    // chunks are padded to an even length
+    for (int64 pos = 12; pos + 8 <= fileSize;)
+    {
+        const uint8* chunk = file + pos;
+        const int64 body = pos + 8;
+        int64 size = readSize (chunk + 4);
+
+        if (littleEndian && std::memcmp (chunk, "ds64", 4) == 0 && body + 16 <= fileSize)
+            rf64DataBytes = (int64) (readWord<true> (file + body + 8) | ((uint64) readWord<true> (file + body + 12) << 32));
+
+        if (littleEndian && std::memcmp (chunk, "data", 4) == 0)
+        {
+            // an RF64 data chunk gives its real length in the ds64 chunk
+            if (size == 0xffffffff && rf64DataBytes >= 0)
+                size = rf64DataBytes;
+
+            dataOffset = body;
+            dataBytes = juce::jmin (size, fileSize - body);
+            return true;
+        }
+
+        if (! littleEndian && std::memcmp (chunk, "SSND", 4) == 0 && body + 8 <= fileSize)
+        {
+            // the samples follow an offset and a block size
+            const int64 skip = readSize (file + body);
+            dataOffset = body + 8 + skip;
+            dataBytes = juce::jmin (size - 8 - skip, fileSize - dataOffset);
+            return dataBytes >= 0;
+        }
+
+        pos = body + size + (size & 1);
+    }
+
+    return false;
+}
+
+void PcmDecoder::decode (const Format& format, const void* firstFrame, int channel,
+                         float* dest, int numFrames) noexcept
+{
+    const int bytesPerSample = format.bytesPerFrame / format.numChannels;
+    const auto* src = static_cast<const uint8*> (firstFrame) + channel * bytesPerSample;
+
+    if (format.littleEndian)
+        decodeWithOrder<true> (format, src, dest, numFrames);
+    else
+        decodeWithOrder<false> (format, src, dest, numFrames);
+}
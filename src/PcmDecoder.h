@@ -0,0 +1,38 @@
+#pragma once
+
+#include <JuceHeader.h>
+
+// Converts interleaved PCM frames, as laid out in an uncompressed WAV or AIFF
+// file, to float. Used by the render kernels to read memory-mapped samples
+// without an intermediate float copy of the file.
+class PcmDecoder
+{
+public:
+    enum class Encoding { int16, int24, int32, float32 };
+
+    struct Format
+    {
+        Encoding encoding { Encoding::int16 };
+        bool littleEndian { true };
+        int numChannels { 1 };    // channels stored per frame
+        int bytesPerFrame { 2 };
+    };
+
+    // Describes the reader's data, or returns false for layouts the decoder
+    // does not handle (8-bit, 64-bit float, odd frame sizes).
+    static bool describe (const juce::AudioFormatReader& reader, bool littleEndian, Format& format) noexcept;
+
+    // Walks the chunks of a whole WAV (RIFF or RF64) or AIFF/AIFC file image
+    // to its sample data, giving the data's offset from the start of the file
+    // and its length in bytes. Returns false if no sample data is found.
+    static bool findSampleData (const void* fileData, int64 fileSize, bool littleEndian,
+                                int64& dataOffset, int64& dataBytes) noexcept;
+
+    // Writes numFrames of one channel to dest. firstFrame points at the first
+    // byte of the first frame to read.
+    static void decode (const Format& format, const void* firstFrame, int channel,
+                        float* dest, int numFrames) noexcept;
+
+private:
+    PcmDecoder() = delete;
+};
@@ -1,13 +1,10 @@
 #include "PluginProcessor.h"
 #include "PluginEditor.h"
+#include <sstream>
 
 //==============================================================================
 PluginProcessor::PluginProcessor()
-     : AudioProcessor (BusesProperties()
-                     #if ! JucePlugin_IsMidiEffect
-                       .withOutput ("Output", juce::AudioChannelSet::stereo(), true)
-                     #endif
-                       ),
+     : AudioProcessor (createBusesProperties()),
        apiServer{*this},
        apvts (*this, nullptr, "Params", createParameterLayout())
 {
@@ -25,6 +22,19 @@ juce::AudioProcessorValueTreeState::ParameterLayout PluginProcessor::createParam
     return {};
 }
 
+juce::AudioProcessor::BusesProperties PluginProcessor::createBusesProperties()
+{
+    BusesProperties props;
+   #if ! JucePlugin_IsMidiEffect
+    props = props.withOutput ("Output", juce::AudioChannelSet::stereo(), true);
+
+    // off until the host enables them
+    for (int i = 1; i <= SamplePlayer::numAuxOutputs; ++i)
+        props = props.withOutput ("Aux " + juce::String (i), juce::AudioChannelSet::stereo(), false);
+   #endif
+    return props;
+}
+
 //==============================================================================
 const juce::String PluginProcessor::getName() const
 {
@@ -95,7 +105,9 @@ void PluginProcessor::prepareToPlay (double sampleRate, int samplesPerBlock)
 {
     // Use this method as the place to do any pre-playback
     // initialisation that you need..
-    juce::ignoreUnused (sampleRate, samplesPerBlock);
+    sampler.prepareToPlay (sampleRate, samplesPerBlock);
+    outputMeter.prepare (sampleRate);
+    outputMeter.reset();
 }
 
 void PluginProcessor::releaseResources()
@@ -118,6 +130,14 @@ bool PluginProcessor::isBusesLayoutSupported (const BusesLayout& layouts) const
      && layouts.getMainOutputChannelSet() != juce::AudioChannelSet::stereo())
         return false;
 
+    // aux outputs are stereo or off
+    for (int bus = 1; bus < layouts.outputBuses.size(); ++bus)
+    {
+        const auto set = layouts.getChannelSet (false, bus);
+        if (! set.isDisabled() && set != juce::AudioChannelSet::stereo())
+            return false;
+    }
+
     // This checks if the input layout matches the output layout
    #if ! JucePlugin_IsSynth
     if (layouts.getMainOutputChannelSet() != layouts.getMainInputChannelSet())
@@ -131,34 +151,44 @@ bool PluginProcessor::isBusesLayoutSupported (const BusesLayout& layouts) const
 void PluginProcessor::processBlock (juce::AudioBuffer<float>& buffer,
                                               juce::MidiBuffer& midiMessages)
 {
-    juce::ignoreUnused (midiMessages);
     juce::ScopedNoDenormals noDenormals;
-    auto totalNumInputChannels  = getTotalNumInputChannels();
-    auto totalNumOutputChannels = getTotalNumOutputChannels();
-
-    // In case we have more outputs than inputs, this code clears any output
-    // channels that didn't contain input data, (because these aren't
-    // guaranteed to be empty - they may contain garbage).
-    // This is here to avoid people getting screaming feedback
-    // when they first compile a plugin, but obviously you don't need to keep
-    // this code if your algorithm always overwrites all the output channels.
-    for (auto i = totalNumInputChannels; i < totalNumOutputChannels; ++i)
-        buffer.clear (i, 0, buffer.getNumSamples());
-
-    // This is the place where you'd normally do the guts of your plugin's
-    // audio processing...
-    // Make sure to reset the state if your inner loop is processing
-    // the samples and the outer loop is handling the channels.
-    // Alternatively, you can process the samples with the channels
-    // interleaved by keeping the same state.
-    for (int channel = 0; channel < totalNumInputChannels; ++channel)
+
+    // the engine clears every channel before rendering, so nothing is cleared here
+    SamplerEngine::OutputBus buses[SamplerEngine::maxOutputBuses];
+    const int numBuses = juce::jmin (getBusCount (false), SamplerEngine::maxOutputBuses);
+
+    for (int bus = 0; bus < numBuses; ++bus)
+    {
+        if (auto* outputBus = getBus (false, bus); outputBus != nullptr && outputBus->isEnabled())
+        {
+            buses[bus].firstChannel = getChannelIndexInProcessBlockBuffer (false, bus, 0);
+            buses[bus].numChannels = outputBus->getNumberOfChannels();
+        }
+    }
+
+    const bool audible = sampler.processBlock (buffer, midiMessages, buses, numBuses);
+
+    // A silent block is not scanned: its meter readings just fall, and once
+    // they are at the floor the meter is left alone until sound comes back.
+    if (! audible && outputMeter.isSilent())
+        return;
+
+    const int numSamples = buffer.getNumSamples();
+    outputMeter.beginBlock (false);
+
+    if (audible && numBuses > 0 && buses[0].numChannels > 0)
     {
-        auto* channelData = buffer.getWritePointer (channel);
-        juce::ignoreUnused (channelData);
-        // ..do something to the data...
+        const float* mainChannels[LevelMeter::maxChannels] {};
+        const int numMain = juce::jmin (LevelMeter::maxChannels, buses[0].numChannels);
+        for (int ch = 0; ch < numMain; ++ch)
+            mainChannels[ch] = buffer.getReadPointer (buses[0].firstChannel + ch);
+
+        outputMeter.addSamples (mainChannels, numMain, 0, numSamples);
     }
 
-    sampler.processBlock (buffer, midiMessages);
+    outputMeter.endBlock (numSamples);
+    outputPeakDb.store (outputMeter.getPeakDb(), std::memory_order_relaxed);
+    outputRmsDb.store (outputMeter.getRmsDb(), std::memory_order_relaxed);
 }
 
 //==============================================================================
@@ -195,8 +225,9 @@ void PluginProcessor::setStateInformation (const void* data, int sizeInBytes)
         apvts.replaceState (paramsTree);
 
     auto samplerTree = tree.getChildWithName ("SamplerState");
+    // returns before the files are loaded; the UI follows each one in
     if (samplerTree.isValid())
-        sampler.importFromValueTree (samplerTree);
+        sampler.importFromValueTree (samplerTree, [this] (bool, juce::String) { sendSamplerStateToUI(); });
 
     sendSamplerStateToUI();
 }
@@ -222,6 +253,14 @@ void PluginProcessor::addSamplePlayerFromWeb()
     sendSamplerStateToUI();
 }
 
+void PluginProcessor::removeSamplePlayerFromWeb (int playerId)
+{
+    if (! sampler.removeSamplePlayer (playerId))
+        broadcastMessage ("Failed to remove player " + juce::String (playerId));
+
+    sendSamplerStateToUI();
+}
+
 void PluginProcessor::requestSampleLoadFromWeb (int playerId)
 {
     auto chooser = std::make_shared<juce::FileChooser> ("Select an audio file",
@@ -263,6 +302,152 @@ void PluginProcessor::setSampleRangeFromWeb (int playerId, int low, int high)
         broadcastMessage ("Failed to set range for player " + juce::String (playerId));
 }
 
+void PluginProcessor::setMidiChannelFromWeb (int playerId, int channel)
+{
+    if (sampler.setMidiChannel (playerId, channel))
+        sendSamplerStateToUI();
+    else
+        broadcastMessage ("Failed to set MIDI channel for player " + juce::String (playerId));
+}
+
+void PluginProcessor::setVoiceSettingsFromWeb (int playerId, int polyphony, const juce::String& stealPolicy)
+{
+    if (sampler.setVoiceSettings (playerId, polyphony, stealPolicy))
+        sendSamplerStateToUI();
+    else
+        broadcastMessage ("Failed to set voices for player " + juce::String (playerId));
+}
+
+void PluginProcessor::setPitchSettingsFromWeb (int playerId, int rootKey, const juce::String& interpolation)
+{
+    if (sampler.setPitchSettings (playerId, rootKey, interpolation))
+        sendSamplerStateToUI();
+    else
+        broadcastMessage ("Failed to set pitch for player " + juce::String (playerId));
+}
+
+void PluginProcessor::setStorageFromWeb (int playerId, const juce::String& storage, const juce::String& sampleFormat)
+{
+    const bool ok = sampler.setStorage (playerId, storage, sampleFormat, [this] (bool loaded, juce::String error)
+    {
+        if (! loaded)
+            broadcastMessage ("Reload failed: " + error);
+
+        sendSamplerStateToUI();
+    });
+
+    if (ok)
+        sendSamplerStateToUI();
+    else
+        broadcastMessage ("Failed to set storage for player " + juce::String (playerId));
+}
+
+void PluginProcessor::setRenderThreadsFromWeb (int numThreads)
+{
+    sampler.setRenderThreads (numThreads);
+    sendSamplerStateToUI();
+}
+
+void PluginProcessor::setTruePeakMeteringFromWeb (bool enabled)
+{
+    sampler.setTruePeakMetering (enabled);
+    sendSamplerStateToUI();
+}
+
+void PluginProcessor::setEnvelopeFromWeb (int playerId, const SamplePlayer::Envelope& envelope)
+{
+    if (sampler.setEnvelope (playerId, envelope))
+        sendSamplerStateToUI();
+    else
+        broadcastMessage ("Failed to set envelope for player " + juce::String (playerId));
+}
+
+void PluginProcessor::setLoopFromWeb (int playerId, const SamplePlayer::Loop& loop)
+{
+    if (sampler.setLoop (playerId, loop))
+        sendSamplerStateToUI();
+    else
+        broadcastMessage ("Failed to set loop for player " + juce::String (playerId));
+}
+
+void PluginProcessor::setOutputBusFromWeb (int playerId, int bus)
+{
+    if (sampler.setOutputBus (playerId, bus))
+        sendSamplerStateToUI();
+    else
+        broadcastMessage ("Failed to set output for player " + juce::String (playerId));
+}
+
+void PluginProcessor::addZoneFromWeb (int playerId, const Zone& zone)
+{
+    auto chooser = std::make_shared<juce::FileChooser> ("Select an audio file for the zone",
+                                                        lastSampleDirectory,
+                                                        "*.wav;*.aif;*.aiff;*.mp3;*.flac;*.ogg;*.*");
+
+    auto chooserFlags = juce::FileBrowserComponent::openMode
+                      | juce::FileBrowserComponent::canSelectFiles;
+
+    chooser->launchAsync (chooserFlags, [this, chooser, playerId, zone] (const juce::FileChooser& fc)
+    {
+        juce::ignoreUnused (chooser);
+
+        auto file = fc.getResult();
+
+        if (! file.existsAsFile())
+        {
+            broadcastMessage ("Load cancelled");
+            return;
+        }
+
+        lastSampleDirectory = file.getParentDirectory();
+
+        auto started = sampler.addZoneAsync (playerId, file, zone, [this] (bool ok, juce::String error)
+        {
+            if (! ok)
+                broadcastMessage ("Zone load failed: " + error);
+
+            sendSamplerStateToUI();
+        });
+
+        if (! started)
+            broadcastMessage ("Failed to add zone to player " + juce::String (playerId));
+
+        sendSamplerStateToUI();
+    });
+}
+
+void PluginProcessor::setZoneFromWeb (int playerId, int zoneId, const Zone& zone)
+{
+    if (sampler.setZone (playerId, zoneId, zone))
+        sendSamplerStateToUI();
+    else
+        broadcastMessage ("Failed to set zone " + juce::String (zoneId) + " for player " + juce::String (playerId));
+}
+
+void PluginProcessor::removeZoneFromWeb (int playerId, int zoneId)
+{
+    if (sampler.removeZone (playerId, zoneId))
+        sendSamplerStateToUI();
+    else
+        broadcastMessage ("Failed to remove zone " + juce::String (zoneId) + " from player " + juce::String (playerId));
+}
+
+void PluginProcessor::cancelLoadFromWeb (int playerId, int zoneId)
+{
+    if (sampler.cancelLoad (playerId, zoneId))
+        sendSamplerStateToUI();
+    else
+        broadcastMessage ("No load to cancel for zone " + juce::String (zoneId) + " of player " + juce::String (playerId));
+}
+
+void PluginProcessor::setVelocityCurveFromWeb (int playerId, const juce::String& curve)
+{
+    if (sampler.setVelocityCurve (playerId, curve))
+        sendSamplerStateToUI();
+    else
+        broadcastMessage ("Failed to set velocity curve for player " + juce::String (playerId));
+}
+
 void PluginProcessor::triggerFromWeb (int playerId)
 {
     sampler.trigger(playerId);
@@ -291,11 +476,22 @@ juce::String PluginProcessor::getWaveformSVGForPlayer (int playerId) const
 
 std::string PluginProcessor::getVuStateJson() const
 {
-    auto ptr = sampler.getVuJson();
-    if (ptr != nullptr)
-        return *ptr;
+    // the engine's object with the main output's level added at the end
+    auto json = sampler.getVuJson();
+    jassert (! json.empty() && json.back() == '}');
+    json.pop_back();
 
-    return "{\"dB_out\":[]}";
+    std::ostringstream output;
+    output.setf (std::ios::fixed);
+    output.precision (2);
+    output << ",\"master_dB\":" << outputPeakDb.load (std::memory_order_relaxed)
+           << ",\"master_rms\":" << outputRmsDb.load (std::memory_order_relaxed) << "}";
+    return json + output.str();
+}
+
+juce::var PluginProcessor::getLoadProgress() const
+{
+    return sampler.getLoadProgress();
 }
 
 void PluginProcessor::broadcastMessage (const juce::String& msg)
@@ -5,7 +5,9 @@
 
 // #define CPPHTTPLIB_OPENSSL_SUPPORT
 #include "HTTPServer.h"
+#include "LevelMeter.h"
 #include "SamplerEngine.h"
+#include <atomic>
 
 
 //==============================================================================
@@ -53,21 +55,42 @@ public:
     // but for simplicity in this demo
     void messageReceivedFromWebAPI(std::string msg);
     void addSamplePlayerFromWeb();
+    void removeSamplePlayerFromWeb (int playerId);
     void sendSamplerStateToUI();
     void requestSampleLoadFromWeb (int playerId);
     juce::var getSamplerState() const;
     juce::String getWaveformSVGForPlayer (int playerId) const;
     std::string getVuStateJson() const;
+    juce::var getLoadProgress() const;
     void setSampleRangeFromWeb (int playerId, int low, int high);
+    void setMidiChannelFromWeb (int playerId, int channel);
+    void setVoiceSettingsFromWeb (int playerId, int polyphony, const juce::String& stealPolicy);
+    void setPitchSettingsFromWeb (int playerId, int rootKey, const juce::String& interpolation);
+    void setEnvelopeFromWeb (int playerId, const SamplePlayer::Envelope& envelope);
+    void setLoopFromWeb (int playerId, const SamplePlayer::Loop& loop);
+    void setStorageFromWeb (int playerId, const juce::String& storage, const juce::String& sampleFormat);
+    void setRenderThreadsFromWeb (int numThreads);
+    void setTruePeakMeteringFromWeb (bool enabled);
+    void setOutputBusFromWeb (int playerId, int bus);
+    void addZoneFromWeb (int playerId, const Zone& zone);
+    void setZoneFromWeb (int playerId, int zoneId, const Zone& zone);
+    void removeZoneFromWeb (int playerId, int zoneId);
+    void cancelLoadFromWeb (int playerId, int zoneId);
+    void setVelocityCurveFromWeb (int playerId, const juce::String& curve);
     void triggerFromWeb (int playerId);
 
 private:
     HttpServerThread apiServer;
     SamplerEngine sampler;
+    // the main output's level, measured only while the engine makes sound
+    LevelMeter outputMeter;
+    std::atomic<float> outputPeakDb { LevelMeter::floorDb };
+    std::atomic<float> outputRmsDb { LevelMeter::floorDb };
     juce::AudioProcessorValueTreeState apvts;
     juce::File lastSampleDirectory;
 
     static juce::AudioProcessorValueTreeState::ParameterLayout createParameterLayout();
+    static BusesProperties createBusesProperties();
 
     void broadcastMessage (const juce::String& msg);
 
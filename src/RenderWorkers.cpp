@@ -0,0 +1,145 @@
+#include "RenderWorkers.h"
+
+class RenderWorkers::Worker : public juce::Thread
+{
+public:
+    Worker (RenderWorkers& ownerToUse, int index)
+        : juce::Thread ("Sampler render " + juce::String (index)),
+          owner (ownerToUse),
+          workerIndex (index)
+    {
+    }
+
+    ~Worker() override
+    {
+        signalThreadShouldExit();
+        wake.signal();
+        stopThread (2000);
+    }
+
+    void run() override
+    {
+        uint32 seen = owner.generation.load (std::memory_order_acquire);
+
+        while (! threadShouldExit())
+        {
+            // spin briefly first: jobs for the segments of one block follow
+            // each other closely
+            uint32 current = seen;
+            for (int spin = 0; spin < 4000 && current == seen; ++spin)
+                current = owner.generation.load (std::memory_order_acquire);
+
+            if (current == seen)
+            {
+                wake.wait (5.0);
+                continue;
+            }
+
+            seen = current;
+
+            // parked workers sit out until the count grows again
+            if (workerIndex >= owner.numActive.load (std::memory_order_acquire))
+                continue;
+
+            while (owner.claimAndRender (current, scratch))
+            {
+            }
+        }
+    }
+
+    RenderWorkers& owner;
+    const int workerIndex;
+    SamplePlayer::RenderScratch scratch;
+    juce::WaitableEvent wake;
+};
+
+RenderWorkers::RenderWorkers() = default;
+
+RenderWorkers::~RenderWorkers()
+{
+    numActive.store (0);
+    for (auto& w : workers)
+        w.reset();
+}
+
+void RenderWorkers::setNumWorkers (int numWorkers, int maxBlockSize, double sampleRate)
+{
+    numWorkers = juce::jlimit (0, maxWorkers, numWorkers);
+
+    for (; numCreated < numWorkers; ++numCreated)
+    {
+        auto worker = std::make_unique<Worker> (*this, numCreated);
+        worker->scratch.prepare (maxBlockSize);
+        worker->startRealtimeThread (juce::Thread::RealtimeOptions{}.withApproximateAudioProcessingTime (maxBlockSize, sampleRate));
+        workers[numCreated] = std::move (worker);
+    }
+
+    // publishes the new workers to the audio thread
+    numActive.store (numWorkers, std::memory_order_release);
+}
+
+void RenderWorkers::prepare (int maxBlockSize)
+{
+    for (int i = 0; i < numCreated; ++i)
+        workers[i]->scratch.prepare (maxBlockSize);
+}
+
+void RenderWorkers::render (SamplePlayer* const* players, int numPlayers, int numSamples,
+                            SamplePlayer::RenderScratch& callerScratch) noexcept
+{
+    const int active = numActive.load (std::memory_order_acquire);
+
+    // not worth waking anyone for a single player
+    if (active == 0 || numPlayers < 2)
+    {
+        for (int i = 0; i < numPlayers; ++i)
+            players[i]->renderChunk (numSamples, callerScratch);
+        return;
+    }
+
+    jobPlayers.store (players, std::memory_order_relaxed);
+    jobNumPlayers.store (numPlayers, std::memory_order_relaxed);
+    jobNumSamples.store (numSamples, std::memory_order_relaxed);
+    completed.store (0, std::memory_order_relaxed);
+
+    const uint32 job = generation.load (std::memory_order_relaxed) + 1;
+    cursor.store ((uint64) job << 32, std::memory_order_release);
+    generation.store (job, std::memory_order_release);
+
+    // Signalling an event does not block; workers that are still spinning
+    // pick the job up without it.
+    for (int i = 0; i < active; ++i)
+        workers[i]->wake.signal();
+
+    while (claimAndRender (job, callerScratch))
+    {
+    }
+
+    // the rest are in flight on the workers and finish shortly
+    while (completed.load (std::memory_order_acquire) < numPlayers)
+    {
+    }
+}
+
+bool RenderWorkers::claimAndRender (uint32 job, SamplePlayer::RenderScratch& scratch) noexcept
+{
+    uint64 current = cursor.load (std::memory_order_acquire);
+
+    for (;;)
+    {
+        if ((uint32) (current >> 32) != job)
+            return false;
+
+        const int index = (int) (current & 0xffffffffu);
+        if (index >= jobNumPlayers.load (std::memory_order_relaxed))
+            return false;
+
+        if (cursor.compare_exchange_weak (current, current + 1, std::memory_order_acq_rel))
+        {
+            auto* const* players = jobPlayers.load (std::memory_order_relaxed);
+            players[index]->renderChunk (jobNumSamples.load (std::memory_order_relaxed), scratch);
+            completed.fetch_add (1, std::memory_order_release);
+            return true;
+        }
+    }
+}
@@ -0,0 +1,60 @@
+#pragma once
+
+#include <JuceHeader.h>
+#include <atomic>
+#include <memory>
+#include "SamplePlayer.h"
+
+// Optional helper threads for SamplerEngine::processBlock.
+//
+// A job is the engine's active player list for one stretch of a block, each
+// player already pointed at its render target. The audio thread and the workers
+// claim players one at a time from a shared cursor, so a thread that
+// finishes early simply takes the next player. No two players of a job write
+// to the same memory, and the caller sums shared outputs in list order,
+// which keeps the output bit-identical whatever the number of threads,
+// including none.
+class RenderWorkers
+{
+public:
+    static constexpr int maxWorkers = 15;
+
+    RenderWorkers();
+    ~RenderWorkers();
+
+    // Control side, serialised with prepare by the engine. Threads are
+    // started on demand and parked rather than stopped when the count drops,
+    // so the audio thread never sees one disappear.
+    void setNumWorkers (int numWorkers, int maxBlockSize, double sampleRate);
+    int getNumWorkers() const noexcept { return numActive.load (std::memory_order_relaxed); }
+
+    // Only while audio is stopped.
+    void prepare (int maxBlockSize);
+
+    // Audio thread. Calls renderChunk on every player and returns once all
+    // of them are done; with no workers everything runs on the caller.
+    void render (SamplePlayer* const* players, int numPlayers, int numSamples,
+                 SamplePlayer::RenderScratch& callerScratch) noexcept;
+
+private:
+    class Worker;
+
+    // claims the next player of job `generation`; false once there are none left
+    bool claimAndRender (uint32 generation, SamplePlayer::RenderScratch& scratch) noexcept;
+
+    std::unique_ptr<Worker> workers[maxWorkers];
+    std::atomic<int> numActive { 0 };
+    int numCreated { 0 };
+
+    // The cursor holds the job generation in its top half and the next
+    // player index in the bottom half, so a worker that wakes late cannot
+    // claim work from a later job.
+    std::atomic<uint64> cursor { 0 };
+    std::atomic<uint32> generation { 0 };
+    std::atomic<int> completed { 0 };
+    std::atomic<SamplePlayer* const*> jobPlayers { nullptr };
+    std::atomic<int> jobNumPlayers { 0 };
+    std::atomic<int> jobNumSamples { 0 };
+
+    JUCE_DECLARE_NON_COPYABLE (RenderWorkers)
+};
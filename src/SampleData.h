@@ -0,0 +1,142 @@
+#pragma once
+
+#include <JuceHeader.h>
+#include <atomic>
+#include <limits>
+#include <memory>
+#include <vector>
+#include "CompactStorage.h"
+#include "PcmDecoder.h"
+
+class StreamSource;
+
+// Immutable audio handed to the audio thread. Holds the whole sample, or for
+// a streamed sample only the preloaded head, with the rest read from disk
+// through `stream`. A mapped sample has no buffer at all and is converted
+// from the file's PCM data as it plays, and a packed sample keeps its frames
+// in a 16-bit CompactStorage format instead of the float buffer. Decoded
+// data opened from the DecodedCache is played in place from the read-only
+// mapped entry, through `floatFrames` or `packedFrames`.
+//
+// A fully decoded sample may be handed out while its loader is still
+// writing it: frames up to `framesLoaded` are final, the rest read as
+// silence until the loader reaches them.
+struct SampleData
+{
+    juce::AudioBuffer<float> buffer;
+    double sampleRate { 44100.0 };
+    int64 lengthInSamples { 0 };   // full length; beyond the buffer when streaming
+    std::shared_ptr<StreamSource> stream;
+
+    std::shared_ptr<juce::MemoryMappedFile> mapping;   // keeps the file mapped
+    const void* mappedFrames { nullptr };               // frame 0 of the PCM data
+    PcmDecoder::Format mappedFormat;
+
+    CompactStorage::Format packedFormat { CompactStorage::Format::float32 };
+    std::vector<uint16> packed;                // planar, lengthInSamples per channel
+    const uint16* packedFrames { nullptr };    // packed.data(), or the cache entry's frames
+    int packedChannels { 0 };
+
+    std::shared_ptr<juce::MemoryMappedFile> cacheMapping;   // keeps a cache entry mapped
+    const float* floatFrames { nullptr };      // a float32 cache entry's frames, planar, instead of buffer
+    int floatChannels { 0 };
+
+    // frames of the buffer or packed frames written so far; only advanced by
+    // a progressive load, which stores it after writing them
+    std::atomic<int64> framesLoaded { std::numeric_limits<int64>::max() };
+
+    // sustain loop from the file's smpl chunk, in source frames; empty if none
+    int64 fileLoopStart { 0 };
+    int64 fileLoopEnd { 0 };
+
+    // fixed at load and only read on control threads
+    juce::String poolKey;
+    juce::String waveformSVG;
+
+    int getNumChannels() const noexcept
+    {
+        if (isMapped())
+            return juce::jmin (2, mappedFormat.numChannels);
+        if (floatFrames != nullptr)
+            return floatChannels;
+        return isPacked() ? packedChannels : buffer.getNumChannels();
+    }
+
+    int64 getNumFramesInMemory() const noexcept
+    {
+        const int64 held = floatFrames != nullptr ? lengthInSamples : (int64) buffer.getNumSamples();
+        return juce::jmin (held, framesLoaded.load (std::memory_order_acquire));
+    }
+
+    // frames readFrames returns as audio rather than silence
+    int64 getNumFramesReady() const noexcept
+    {
+        if (isMapped())
+            return lengthInSamples;
+        return isPacked() ? juce::jmin (lengthInSamples, framesLoaded.load (std::memory_order_acquire))
+                          : getNumFramesInMemory();
+    }
+
+    bool isStreaming() const noexcept { return stream != nullptr; }
+    bool isMapped() const noexcept { return mapping != nullptr; }
+    bool isPacked() const noexcept { return packedFrames != nullptr; }
+    bool isLoaded() const noexcept
+    {
+        return framesLoaded.load (std::memory_order_acquire) >= (isPacked() || floatFrames != nullptr ? lengthInSamples : (int64) buffer.getNumSamples());
+    }
+    // only fully decoded samples are converted to the host rate up front
+    bool isDecoded() const noexcept { return stream == nullptr && mapping == nullptr && isLoaded(); }
+    bool hasFileLoop() const noexcept { return fileLoopEnd > fileLoopStart; }
+
+    const void* getMappedFrame (int64 frame) const noexcept
+    {
+        return static_cast<const char*> (mappedFrames) + frame * mappedFormat.bytesPerFrame;
+    }
+
+    const uint16* getPackedChannel (int channel) const noexcept
+    {
+        return packedFrames + (size_t) channel * (size_t) lengthInSamples;
+    }
+
+    // A float sample's frames, wherever they are held.
+    const float* getFloatChannel (int channel) const noexcept
+    {
+        return floatFrames != nullptr ? floatFrames + (size_t) channel * (size_t) lengthInSamples
+                                      : buffer.getReadPointer (channel);
+    }
+
+    // Copies the frames held in RAM (decoded, packed or mapped) and zeroes
+    // the rest of the range, including anything before frame 0 and anything
+    // a progressive load has not reached yet.
+    void readFrames (int channel, int64 first, int count, float* dest) const noexcept
+    {
+        const int64 memStart = juce::jmax (first, (int64) 0);
+        const int64 memEnd = juce::jmin (first + count, getNumFramesReady());
+
+        juce::FloatVectorOperations::clear (dest, count);
+        if (memEnd <= memStart)
+            return;
+
+        float* out = dest + (memStart - first);
+        const int num = (int) (memEnd - memStart);
+
+        if (isMapped())
+            PcmDecoder::decode (mappedFormat, getMappedFrame (memStart), channel, out, num);
+        else if (isPacked())
+            CompactStorage::decode (packedFormat, getPackedChannel (channel) + memStart, out, num);
+        else
+            juce::FloatVectorOperations::copy (out, getFloatChannel (channel) + memStart, num);
+    }
+
+    // Mapped pages are the file's and not counted.
+    int64 getBytesInMemory() const noexcept
+    {
+        if (cacheMapping != nullptr)
+            return 0;
+
+        return (int64) buffer.getNumChannels() * buffer.getNumSamples() * (int64) sizeof (float)
+             + (int64) packed.size() * (int64) sizeof (uint16);
+    }
+};
+
+using SampleDataPtr = std::shared_ptr<const SampleData>;
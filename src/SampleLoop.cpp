@@ -0,0 +1,62 @@
+#include "SampleLoop.h"
+#include <vector>
+
+void SampleLoop::read (const SampleData& data, int channel, int64 first, int count, float* dest) const noexcept
+{
+    int done = 0;
+
+    while (done < count)
+    {
+        const int64 frame = wrap (first + done);
+        const int64 runEnd = frame < seamStart ? seamStart : end;
+        const int num = (int) juce::jmin ((int64) (count - done), runEnd - frame);
+
+        if (frame < seamStart)
+            data.readFrames (channel, frame, num, dest + done);
+        else
+            juce::FloatVectorOperations::copy (dest + done, seam.getReadPointer (channel, (int) (frame - seamStart)), num);
+
+        done += num;
+    }
+}
+
+std::shared_ptr<const SampleLoop> SampleLoop::create (const SampleData& data, int64 start, int64 end, int64 crossfade)
+{
+    const int64 inMemory = data.getNumFramesReady();
+    end = juce::jmin (end, data.lengthInSamples);
+
+    if (start < 0 || end - start < 2 || end > inMemory)
+        return nullptr;
+
+    auto loop = std::make_shared<SampleLoop>();
+    loop->start = start;
+    loop->end = end;
+
+    const int length = (int) juce::jlimit ((int64) 0, juce::jmin (start, end - start), crossfade);
+    loop->seamStart = end - length;
+    loop->seam.setSize (data.getNumChannels(), length);
+
+    if (length == 0)
+        return loop;
+
+    // equal power, as loop material is rarely in phase with itself
+    std::vector<float> fadeOut ((size_t) length), fadeIn ((size_t) length), lead ((size_t) length);
+    for (int i = 0; i < length; ++i)
+    {
+        const double t = ((double) i + 0.5) / (double) length * juce::MathConstants<double>::halfPi;
+        fadeOut[(size_t) i] = (float) std::cos (t);
+        fadeIn[(size_t) i] = (float) std::sin (t);
+    }
+
+    for (int ch = 0; ch < loop->seam.getNumChannels(); ++ch)
+    {
+        float* seam = loop->seam.getWritePointer (ch);
+        data.readFrames (ch, loop->seamStart, length, seam);
+        data.readFrames (ch, start - length, length, lead.data());
+
+        juce::FloatVectorOperations::multiply (seam, fadeOut.data(), length);
+        juce::FloatVectorOperations::addWithMultiply (seam, lead.data(), fadeIn.data(), length);
+    }
+
+    return loop;
+}
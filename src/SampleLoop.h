@@ -0,0 +1,37 @@
+#pragma once
+
+#include <JuceHeader.h>
+#include <memory>
+#include "SampleData.h"
+
+// A sustain loop over [start, end) of one SampleData, with its crossfade
+// baked in. Played, the loop runs from start up to seamStart in the sample,
+// then through the seam, then wraps back to start. The seam blends the
+// frames leading up to `end` into those leading up to `start`, so it flows
+// straight into the start frame and readers only ever copy plain runs.
+// Built on a control thread and never changed afterwards.
+struct SampleLoop
+{
+    int64 start { 0 };
+    int64 end { 0 };
+    int64 seamStart { 0 };           // end minus the crossfade length
+    juce::AudioBuffer<float> seam;   // end - seamStart frames per channel
+
+    int64 getLength() const noexcept { return end - start; }
+
+    // Where a frame of the looped sound lies in [0, end).
+    int64 wrap (int64 frame) const noexcept
+    {
+        return frame < end ? frame : start + (frame - start) % getLength();
+    }
+
+    // Copies `count` frames of the looped sound from `first` on.
+    void read (const SampleData& data, int channel, int64 first, int count, float* dest) const noexcept;
+
+    // Positions are in frames of `data`. Returns nullptr if the range is too
+    // short or not wholly in RAM, as past the head of a streamed sample. The
+    // crossfade is shortened to fit before start and within the loop.
+    static std::shared_ptr<const SampleLoop> create (const SampleData& data, int64 start, int64 end, int64 crossfade);
+};
+
+using SampleLoopPtr = std::shared_ptr<const SampleLoop>;
@@ -1,11 +1,35 @@
 #include "SamplePlayer.h"
+#include "OfflineResampler.h"
 #include "WaveformSVGRenderer.h"
+#include <algorithm>
 
-SamplePlayer::SamplePlayer (int newId)
+namespace
+{
+    Zone clampZone (Zone zone)
+    {
+        const int keyLow = juce::jlimit (0, 127, zone.keyLow);
+        const int keyHigh = juce::jlimit (0, 127, zone.keyHigh);
+        const int velocityLow = juce::jlimit (1, 127, zone.velocityLow);
+        const int velocityHigh = juce::jlimit (1, 127, zone.velocityHigh);
+
+        zone.keyLow = juce::jmin (keyLow, keyHigh);
+        zone.keyHigh = juce::jmax (keyLow, keyHigh);
+        zone.velocityLow = juce::jmin (velocityLow, velocityHigh);
+        zone.velocityHigh = juce::jmax (velocityLow, velocityHigh);
+        zone.roundRobin = juce::jlimit (0, 127, zone.roundRobin);
+        zone.rootKey = juce::jlimit (-1, 127, zone.rootKey);
+        return zone;
+    }
+}
+
+SamplePlayer::SamplePlayer (int newId, DiskStreamer& diskStreamer)
+    : streamer (diskStreamer)
 {
     state.id = newId;
     state.waveformSVG = WaveformSVGRenderer::generateBlankWaveformSVG();
-    vuBuffer.assign ((size_t) vuBufferSize, 0.0f);
+    state.zones.emplace_back();   // zone 0, full range
+    voices.resize ((size_t) maxPolyphony * 2);
+    activeVoices.reserve (voices.size());
 }
 
 void SamplePlayer::setMidiRange (int low, int high) noexcept
@@ -16,123 +40,1017 @@ void SamplePlayer::setMidiRange (int low, int high) noexcept
     state.midiHigh = juce::jmax (low, high);
 }
 
+void SamplePlayer::setMidiChannel (int channel) noexcept
+{
+    state.midiChannel = juce::jlimit (0, 16, channel);
+}
+
 void SamplePlayer::setGain (float g) noexcept
 {
     state.gain = juce::jlimit (0.0f, 2.0f, g);
 }
 
-void SamplePlayer::setFilePathAndStatus (const juce::String& path, const juce::String& statusLabel, const juce::String& displayName)
+void SamplePlayer::setOutputBus (int bus) noexcept
+{
+    state.outputBus = juce::jlimit (0, numAuxOutputs, bus);
+}
+
+void SamplePlayer::setVoiceSettings (int newPolyphony, StealPolicy policy) noexcept
+{
+    state.polyphony = juce::jlimit (1, maxPolyphony, newPolyphony);
+    state.stealPolicy = policy;
+}
+
+void SamplePlayer::setEnvelope (const Envelope& newEnvelope) noexcept
+{
+    state.envelope.attackMs = juce::jlimit (0.0f, maxEnvelopeMs, newEnvelope.attackMs);
+    state.envelope.decayMs = juce::jlimit (0.0f, maxEnvelopeMs, newEnvelope.decayMs);
+    state.envelope.sustain = juce::jlimit (0.0f, 1.0f, newEnvelope.sustain);
+    state.envelope.releaseMs = juce::jlimit (0.0f, maxEnvelopeMs, newEnvelope.releaseMs);
+    state.envelope.curve = newEnvelope.curve;
+    state.envelope.oneShot = newEnvelope.oneShot;
+}
+
+void SamplePlayer::setLoop (const Loop& newLoop) noexcept
+{
+    state.loop.enabled = newLoop.enabled;
+    state.loop.crossfade = juce::jlimit (0, maxLoopCrossfade, newLoop.crossfade);
+
+    // -1 for either end goes back to the file's own loop
+    if (newLoop.start < 0 || newLoop.end < 0)
+    {
+        state.loop.start = -1;
+        state.loop.end = -1;
+        return;
+    }
+
+    state.loop.start = juce::jmin (newLoop.start, newLoop.end);
+    state.loop.end = juce::jmax (newLoop.start, newLoop.end);
+}
+
+void SamplePlayer::setPitchSettings (int newRootKey, Interpolator::Mode mode) noexcept
+{
+    state.rootKey = juce::jlimit (0, 127, newRootKey);
+    state.interpolation = mode;
+}
+
+SamplePlayer::ZoneState* SamplePlayer::findZone (int zoneId) noexcept
+{
+    for (auto& z : state.zones)
+        if (z.id == zoneId)
+            return &z;
+    return nullptr;
+}
+
+bool SamplePlayer::hasZone (int zoneId) const noexcept
+{
+    return std::any_of (state.zones.begin(), state.zones.end(), [zoneId] (const ZoneState& z) { return z.id == zoneId; });
+}
+
+int SamplePlayer::addZone (const Zone& zone)
+{
+    if ((int) state.zones.size() >= maxZones)
+        return -1;
+
+    ZoneState z;
+    z.id = nextZoneId++;
+    z.zone = clampZone (zone);
+    state.zones.push_back (z);
+    return z.id;
+}
+
+bool SamplePlayer::setZone (int zoneId, const Zone& zone)
+{
+    if (auto* z = findZone (zoneId))
+    {
+        z->zone = clampZone (zone);
+        return true;
+    }
+    return false;
+}
+
+bool SamplePlayer::removeZone (int zoneId)
 {
-    state.filePath = path;
-    state.fileName = displayName.isNotEmpty() ? displayName : juce::File (path).getFileName();
-    state.status = statusLabel;
+    // zone 0 is the main sample and always exists
+    auto it = std::find_if (state.zones.begin(), state.zones.end(), [zoneId] (const ZoneState& z) { return z.id == zoneId; });
+    if (zoneId == 0 || it == state.zones.end())
+        return false;
+
+    state.zones.erase (it);
+    zoneData.erase (zoneId);
+    return true;
+}
+
+void SamplePlayer::setFilePathAndStatus (int zoneId, const juce::String& path, const juce::String& statusLabel, const juce::String& displayName)
+{
+    if (auto* z = findZone (zoneId))
+    {
+        z->filePath = path;
+        z->fileName = displayName.isNotEmpty() ? displayName : juce::File (path).getFileName();
+        z->status = statusLabel;
+    }
+}
+
+void SamplePlayer::setLoadedState (int zoneId, const juce::String& name, const juce::String& waveformSVG)
+{
+    if (auto* z = findZone (zoneId))
+    {
+        z->status = "loaded";
+        z->fileName = name;
+        // Preserve path if already set, otherwise infer from name.
+        if (z->filePath.isEmpty())
+            z->filePath = name;
+    }
+
+    if (zoneId == 0)
+        state.waveformSVG = waveformSVG;
+}
+
+void SamplePlayer::markError (int zoneId, const juce::String& path, const juce::String& message)
+{
+    if (auto* z = findZone (zoneId))
+    {
+        z->status = "error";
+        z->filePath = path;
+        z->fileName = message.isNotEmpty() ? message : juce::File (path).getFileName();
+    }
+
+    if (zoneId == 0)
+        state.waveformSVG = WaveformSVGRenderer::generateBlankWaveformSVG();
+}
+
+void SamplePlayer::setZoneSource (int zoneId, SampleDataPtr data)
+{
+    auto& d = zoneData[zoneId];
+    d = ZoneData();
+    d.source = std::move (data);
+}
+
+SampleDataPtr SamplePlayer::getZoneSource (int zoneId) const
+{
+    auto it = zoneData.find (zoneId);
+    return it != zoneData.end() ? it->second.source : nullptr;
+}
+
+void SamplePlayer::cacheZoneData (int zoneId, double hostRate, SampleDataPtr data)
+{
+    auto it = zoneData.find (zoneId);
+    if (it == zoneData.end())
+        return;
+
+    const int rateKey = juce::roundToInt (hostRate);
+    it->second.dataByRate[rateKey] = std::move (data);
+    if (it->second.convertingTo == rateKey)
+        it->second.convertingTo = 0;
+}
+
+ZoneMapPtr SamplePlayer::buildZoneMap (double hostRate, std::vector<std::pair<int, SampleDataPtr>>& needsConversion)
+{
+    const int rateKey = juce::roundToInt (hostRate);
+    std::vector<ZoneMap::Entry> entries;
+
+    for (const auto& z : state.zones)
+    {
+        auto it = zoneData.find (z.id);
+        if (it == zoneData.end() || it->second.source == nullptr)
+            continue;
+
+        auto& d = it->second;
+        ZoneMap::Entry e;
+        e.zoneId = z.id;
+        e.zone = z.zone;
+        e.source = d.source;
+        e.data = d.source;
+
+        if (d.source->isDecoded() && OfflineResampler::needsConversion (d.source->sampleRate, hostRate))
+        {
+            auto cached = d.dataByRate.find (rateKey);
+            if (cached != d.dataByRate.end())
+            {
+                e.data = cached->second;
+            }
+            else if (d.convertingTo != rateKey)
+            {
+                d.convertingTo = rateKey;
+                needsConversion.emplace_back (z.id, d.source);
+            }
+        }
+
+        if (state.loop.enabled)
+            e.loop = getZoneLoop (z.id, d, *e.data);
+
+        entries.push_back (std::move (e));
+    }
+
+    return std::make_shared<const ZoneMap> (std::move (entries), state.velocityCurve);
+}
+
+SampleLoopPtr SamplePlayer::getZoneLoop (int zoneId, ZoneData& d, const SampleData& data)
+{
+    const auto& source = *d.source;
+    int64 start = source.fileLoopStart;
+    int64 end = source.fileLoopEnd;
+
+    if (zoneId == 0 && state.loop.start >= 0)
+    {
+        start = state.loop.start;
+        end = state.loop.end;
+    }
+
+    if (end <= start)
+        return nullptr;
+
+    // points are in file frames; the data may be converted to the host rate
+    const double ratio = data.sampleRate / source.sampleRate;
+    start = (int64) std::llround ((double) start * ratio);
+    end = (int64) std::llround ((double) end * ratio);
+    const int64 crossfade = (int64) std::llround ((double) state.loop.crossfade * ratio);
+
+    if (d.loopData != &data || d.loopStart != start || d.loopEnd != end || d.loopCrossfade != crossfade)
+    {
+        d.loop = SampleLoop::create (data, start, end, crossfade);
+        d.loopData = &data;
+        d.loopStart = start;
+        d.loopEnd = end;
+        d.loopCrossfade = crossfade;
+    }
+
+    return d.loop;
 }
 
 SamplePlayer::State SamplePlayer::getState() const noexcept
 {
-    return state;
+    auto st = state;
+    st.filePath = state.zones.front().filePath;
+    st.fileName = state.zones.front().fileName;
+    st.status = state.zones.front().status;
+    st.isPlaying = playingSnapshot.load (std::memory_order_relaxed);
+    st.underruns = underruns.load (std::memory_order_relaxed);
+    return st;
 }
 
-bool SamplePlayer::acceptsNote (int midiNote) const noexcept
+void SamplePlayer::syncAudioState() noexcept
 {
-    return midiNote >= state.midiLow && midiNote <= state.midiHigh && sampleBuffer.getNumSamples() > 0;
+    applyGain (state.gain);
+    applyVoiceSettings (state.polyphony, state.stealPolicy);
+    applyPitchSettings (state.rootKey, state.interpolation);
+    applyOutputBus (state.outputBus);
+    applyEnvelope (state.envelope);
 }
 
-void SamplePlayer::trigger()
+juce::String SamplePlayer::stealPolicyToString (StealPolicy policy)
 {
-    if (sampleBuffer.getNumSamples() > 0)
+    switch (policy)
     {
-        playHead = 0;
-        state.isPlaying = true;
+        case StealPolicy::quietest: return "quietest";
+        case StealPolicy::sameNote: return "sameNote";
+        case StealPolicy::oldest:   break;
     }
+    return "oldest";
+}
+
+SamplePlayer::StealPolicy SamplePlayer::stealPolicyFromString (const juce::String& name)
+{
+    if (name == "quietest")
+        return StealPolicy::quietest;
+    if (name == "sameNote")
+        return StealPolicy::sameNote;
+    return StealPolicy::oldest;
 }
 
-void SamplePlayer::triggerNote (int midiNote)
+juce::String SamplePlayer::storageToString (Storage storage)
 {
-    juce::ignoreUnused (midiNote);
-    trigger();
+    switch (storage)
+    {
+        case Storage::stream: return "stream";
+        case Storage::mapped: return "mapped";
+        case Storage::memory: break;
+    }
+    return "memory";
 }
 
-float SamplePlayer::getNextSampleForChannel (int channel)
+SamplePlayer::Storage SamplePlayer::storageFromString (const juce::String& name)
 {
-    if (! state.isPlaying || sampleBuffer.getNumSamples() == 0)
-        return 0.0f;
+    if (name == "stream")
+        return Storage::stream;
+    if (name == "mapped")
+        return Storage::mapped;
+    return Storage::memory;
+}
 
-    const int totalSamples = sampleBuffer.getNumSamples();
-    if (playHead >= totalSamples)
+juce::String SamplePlayer::envelopeCurveToString (EnvelopeCurve curve)
+{
+    return curve == EnvelopeCurve::exponential ? "exponential" : "linear";
+}
+
+SamplePlayer::EnvelopeCurve SamplePlayer::envelopeCurveFromString (const juce::String& name)
+{
+    return name == "exponential" ? EnvelopeCurve::exponential : EnvelopeCurve::linear;
+}
+
+void SamplePlayer::RenderScratch::prepare (int maxBlockSize)
+{
+    maxBlockSize = juce::jmax (1, maxBlockSize);
+    gain.assign ((size_t) maxBlockSize, 0.0f);
+    interp.assign ((size_t) maxBlockSize, 0.0f);
+    // enough for a few times the block plus kernel padding; renderVoice
+    // splits the work further at high pitch ratios
+    source.assign ((size_t) (maxBlockSize * 4 + Interpolator::sincTaps * 4), 0.0f);
+}
+
+void SamplePlayer::prepare (double sampleRate, int maxBlockSize)
+{
+    mix.setSize (2, juce::jmax (1, maxBlockSize));
+    mixValid = false;
+
+    // 5ms fade for stolen voices
+    fadeLengthSamples = juce::jmax (1, (int) (sampleRate * 0.005));
+    hostSampleRate = sampleRate;
+    updateEnvelopeTimes();
+    meter.prepare (sampleRate);
+
+    for (auto* v : activeVoices)
+        if (v->active)
+            updateIncrement (*v);
+}
+
+void SamplePlayer::updateIncrement (Voice& v) noexcept
+{
+    // at the recorded pitch and the host rate, frames are copied straight
+    // through; a voice switching to that mid-note moves to the nearest frame
+    v.unityRate = v.transpose == 0 && juce::roundToInt (v.data->sampleRate) == juce::roundToInt (hostSampleRate);
+    if (v.unityRate)
     {
-        state.isPlaying = false;
-        return 0.0f;
+        v.increment = 1.0;
+        v.position = std::round (v.position);
+        return;
     }
 
-    const int numSampleChans = sampleBuffer.getNumChannels();
-    const float* src = sampleBuffer.getReadPointer (juce::jmin (channel, numSampleChans - 1), playHead);
-    float sample = src[0] * state.gain;
+    // a buffer not yet converted to the host rate is resampled on the fly
+    const double rateRatio = v.data->sampleRate / hostSampleRate;
+    v.increment = juce::jlimit (1.0 / maxPitchRatio, maxPitchRatio, v.pitchRatio * rateRatio);
+}
 
-    if (channel == 0)
-        pushVuSample (sample);
+void SamplePlayer::applyGain (float g) noexcept
+{
+    gain = g;
+}
 
-    ++playHead;
-    if (playHead >= totalSamples)
-        state.isPlaying = false;
+void SamplePlayer::applyVoiceSettings (int newPolyphony, StealPolicy policy) noexcept
+{
+    polyphony = newPolyphony;
+    stealPolicy = policy;
+}
+
+void SamplePlayer::applyPitchSettings (int newRootKey, Interpolator::Mode mode) noexcept
+{
+    rootKey = newRootKey;
+    interpolation = mode;
+}
+
+void SamplePlayer::applyEnvelope (const Envelope& newEnvelope) noexcept
+{
+    // voices pick the new times up at their next segment
+    envelope = newEnvelope;
+    updateEnvelopeTimes();
+
+    // nothing would end a one-shot loop
+    if (envelope.oneShot)
+        for (auto* v : activeVoices)
+            if (v->active && v->loop != nullptr)
+                stopLooping (*v);
+}
+
+void SamplePlayer::updateEnvelopeTimes() noexcept
+{
+    const auto toSamples = [this] (float ms) { return (int) std::round (hostSampleRate * (double) ms * 0.001); };
+
+    attackSamples = toSamples (envelope.attackMs);
+    decaySamples = toSamples (envelope.decayMs);
+    releaseSamples = juce::jmax (fadeLengthSamples, toSamples (envelope.releaseMs));
+}
+
+ZoneMapPtr SamplePlayer::swapZoneMap (ZoneMapPtr newMap) noexcept
+{
+    std::swap (zoneMap, newMap);
+    bool anyActive = false;
+
+    for (auto* voice : activeVoices)
+    {
+        auto& v = *voice;
+        if (! v.active)
+            continue;
+
+        const int index = zoneMap != nullptr ? zoneMap->findEntry (v.zoneId, v.source) : -1;
+        if (index < 0)
+        {
+            endVoice (v);
+            continue;
+        }
+
+        // same file, possibly converted to another rate
+        const auto& entry = zoneMap->getEntry (index);
+        const auto* data = entry.data.get();
+        if (data != v.data)
+        {
+            v.position *= data->sampleRate / v.data->sampleRate;
+            v.data = data;
+            updateIncrement (v);
+        }
+
+        // the old map's loop goes with it
+        if (v.loop != nullptr)
+        {
+            v.loop = entry.loop.get();
+            if (v.loop == nullptr)
+                stopLooping (v);
+        }
+
+        anyActive = true;
+    }
+
+    playing = anyActive;
+    if (! playing)
+        resetVu();
+
+    return newMap;
+}
+
+void SamplePlayer::trigger() noexcept
+{
+    startZones (rootKey, 127, -1);
+}
+
+void SamplePlayer::triggerNote (int midiNote, int velocity) noexcept
+{
+    startZones (midiNote, velocity, midiNote);
+}
 
-    return sample;
+void SamplePlayer::releaseNote (int midiNote) noexcept
+{
+    if (envelope.oneShot || ! playing)
+        return;
+
+    for (auto* v : activeVoices)
+    {
+        if (! v->active || v->note != midiNote)
+            continue;
+
+        if (sustainPedal)
+            v->sustained = true;
+        else
+            startRelease (*v);
+    }
 }
 
-bool SamplePlayer::setLoadedBuffer (juce::AudioBuffer<float>&& newBuffer, const juce::String& name)
+void SamplePlayer::setSustainPedal (bool down) noexcept
 {
-    sampleBuffer = std::move (newBuffer);
-    state.status = "loaded";
-    state.fileName = name;
-    // Preserve path if already set, otherwise infer from name.
-    if (state.filePath.isEmpty())
-        state.filePath = name;
-    playHead = 0;
-    state.isPlaying = false;
-    state.waveformSVG = WaveformSVGRenderer::generateWaveformSVG (sampleBuffer, 320);
-    vuBuffer.assign ((size_t) vuBufferSize, 0.0f);
-    vuWritePos = 0;
-    vuSum = 0.0f;
-    lastVuDb = -60.0f;
+    sustainPedal = down;
+    if (down || envelope.oneShot)
+        return;
+
+    for (auto* v : activeVoices)
+        if (v->active && v->sustained)
+            startRelease (*v);
+}
+
+void SamplePlayer::startZones (int lookupNote, int velocity, int voiceNote) noexcept
+{
+    if (zoneMap == nullptr)
+        return;
+
+    const int numSteps = zoneMap->getNumSteps (lookupNote, velocity);
+    if (numSteps == 0)
+        return;
+
+    // once for the note, so its layers do not fade each other
+    if (stealPolicy == StealPolicy::sameNote)
+        for (auto* v : activeVoices)
+            if (v->active && v->fadeRemaining == 0 && v->note == voiceNote)
+                beginFadeOut (*v);
+
+    auto& counter = roundRobin[(size_t) juce::jlimit (0, 127, lookupNote)];
+    const int step = (int) (counter++ % (uint32) numSteps);
+
+    int count = 0;
+    const auto* entries = zoneMap->getStepEntries (lookupNote, velocity, step, count);
+    const float level = zoneMap->getVelocityGain (velocity);
+
+    for (int i = 0; i < count; ++i)
+        startVoice (voiceNote, zoneMap->getEntry (entries[i]), level);
+}
+
+void SamplePlayer::startVoice (int voiceNote, const ZoneMap::Entry& entry, float level) noexcept
+{
+    int sounding = 0;
+
+    for (auto* v : activeVoices)
+        if (v->active && v->fadeRemaining == 0)
+            ++sounding;
+
+    if (sounding >= polyphony)
+        if (auto* victim = chooseVoiceToSteal())
+            beginFadeOut (*victim);
+
+    auto* v = findFreeVoice();
+    if (v->active)
+        endVoice (*v);
+
+    if (! v->listed)
+    {
+        v->listed = true;
+        activeVoices.push_back (v);
+    }
+
+    const auto& data = *entry.data;
+    const int zoneRoot = entry.zone.rootKey >= 0 ? entry.zone.rootKey : rootKey;
+
+    v->active = true;
+    v->note = voiceNote;
+    v->zoneId = entry.zoneId;
+    v->data = &data;
+    v->source = entry.source.get();
+    v->level = level;
+    v->position = 0.0;
+    // API triggers (note -1) and the root key play at the recorded pitch
+    v->transpose = voiceNote < 0 ? 0 : voiceNote - zoneRoot;
+    v->pitchRatio = std::pow (2.0, (double) v->transpose / 12.0);
+    updateIncrement (*v);
+    v->startOrder = nextStartOrder++;
+    v->peak = 1.0f;
+    v->fadeRemaining = 0;
+    v->fadeLevel = 1.0f;
+    // loops need a note-off to end, so one-shots and API triggers play straight through
+    v->loop = envelope.oneShot || voiceNote < 0 ? nullptr : entry.loop.get();
+    // the head is in memory; the disk thread starts reading right after it,
+    // unless the voice loops within the head
+    v->streamSlot = data.isStreaming() && v->loop == nullptr ? streamer.acquire (data.stream, data.getNumFramesInMemory()) : -1;
+    startEnvelope (*v);
+    playing = true;
+}
+
+void SamplePlayer::startEnvelope (Voice& v) noexcept
+{
+    v.sustained = false;
+
+    if (attackSamples > 0)
+    {
+        v.envLevel = 0.0f;
+        startSegment (v, EnvelopeStage::attack, 1.0f, attackSamples, false);
+        return;
+    }
+
+    v.envStage = EnvelopeStage::attack;
+    v.envTarget = 1.0f;
+    finishSegment (v);
+}
+
+void SamplePlayer::startSegment (Voice& v, EnvelopeStage stage, float targetLevel, int length, bool exponential) noexcept
+{
+    v.envStage = stage;
+    v.envTarget = targetLevel;
+    v.envRemaining = length;
+    v.envExponential = exponential;
+    v.envStep = (targetLevel - v.envLevel) / (float) length;
+    // the distance to the target falls by 60 dB over the segment
+    v.envCoef = (float) std::pow (0.001, 1.0 / (double) length);
+    v.envCoefBlock = (float) std::pow (0.001, (double) envelopeBlockSize / (double) length);
+}
+
+void SamplePlayer::finishSegment (Voice& v) noexcept
+{
+    v.envLevel = v.envTarget;
+
+    switch (v.envStage)
+    {
+        case EnvelopeStage::attack:
+            if (decaySamples > 0 && envelope.sustain < 1.0f)
+            {
+                startSegment (v, EnvelopeStage::decay, envelope.sustain, decaySamples,
+                              envelope.curve == EnvelopeCurve::exponential);
+                return;
+            }
+
+            v.envLevel = envelope.sustain;
+            v.envStage = envelope.sustain > 0.0f ? EnvelopeStage::sustain : EnvelopeStage::done;
+            return;
+
+        case EnvelopeStage::decay:
+            // nothing left to hear once a decay has reached zero
+            v.envStage = v.envLevel > 0.0f ? EnvelopeStage::sustain : EnvelopeStage::done;
+            return;
+
+        case EnvelopeStage::release:
+            v.envStage = EnvelopeStage::done;
+            return;
+
+        case EnvelopeStage::sustain:
+        case EnvelopeStage::done:
+            return;
+    }
+}
+
+void SamplePlayer::startRelease (Voice& v) noexcept
+{
+    v.sustained = false;
+
+    if (v.envStage != EnvelopeStage::release && v.envStage != EnvelopeStage::done)
+        startSegment (v, EnvelopeStage::release, 0.0f, releaseSamples,
+                      envelope.curve == EnvelopeCurve::exponential);
+}
+
+bool SamplePlayer::renderEnvelope (Voice& v, float* gainOut, int num) noexcept
+{
+    if (v.envStage == EnvelopeStage::sustain)
+        return false;
+
+    // Each segment is drawn as straight ramps: one per segment when linear,
+    // one per envelope block when exponential, so the curve is evaluated a
+    // handful of times per block rather than per sample.
+    int done = 0;
+
+    while (done < num)
+    {
+        if (v.envStage == EnvelopeStage::sustain || v.envStage == EnvelopeStage::done)
+        {
+            juce::FloatVectorOperations::fill (gainOut + done, v.envLevel, num - done);
+            break;
+        }
+
+        const int n = juce::jmin (num - done, v.envRemaining, v.envExponential ? envelopeBlockSize : num);
+        const float start = v.envLevel;
+        float end = start + v.envStep * (float) n;
+
+        if (v.envExponential)
+        {
+            const float coef = n == envelopeBlockSize ? v.envCoefBlock : std::pow (v.envCoef, (float) n);
+            end = v.envTarget + (start - v.envTarget) * coef;
+        }
+
+        const float step = (end - start) / (float) n;
+        for (int i = 0; i < n; ++i)
+            gainOut[done + i] = start + step * (float) i;
+
+        v.envLevel = end;
+        v.envRemaining -= n;
+        done += n;
+
+        if (v.envRemaining <= 0)
+            finishSegment (v);
+    }
+
     return true;
 }
 
-void SamplePlayer::markError (const juce::String& path, const juce::String& message)
+SamplePlayer::Voice* SamplePlayer::findFreeVoice() noexcept
 {
-    sampleBuffer.setSize (0, 0);
-    state.status = "error";
-    state.filePath = path;
-    state.fileName = message.isNotEmpty() ? message : juce::File (path).getFileName();
-    state.waveformSVG = WaveformSVGRenderer::generateBlankWaveformSVG();
-    vuBuffer.assign ((size_t) vuBufferSize, 0.0f);
-    vuWritePos = 0;
-    vuSum = 0.0f;
-    lastVuDb = -60.0f;
+    Voice* shortestFade = nullptr;
+
+    for (auto& v : voices)
+    {
+        if (! v.active)
+            return &v;
+
+        if (v.fadeRemaining > 0 && (shortestFade == nullptr || v.fadeRemaining < shortestFade->fadeRemaining))
+            shortestFade = &v;
+    }
+
+    // every slot is busy fading; cut the one closest to silence
+    return shortestFade != nullptr ? shortestFade : &voices.front();
+}
+
+SamplePlayer::Voice* SamplePlayer::chooseVoiceToSteal() noexcept
+{
+    Voice* victim = nullptr;
+
+    for (auto* voice : activeVoices)
+    {
+        auto& v = *voice;
+        if (! v.active || v.fadeRemaining > 0)
+            continue;
+
+        if (victim == nullptr)
+        {
+            victim = &v;
+            continue;
+        }
+
+        // notes already released go first
+        const bool releasing = v.envStage == EnvelopeStage::release;
+        if (releasing != (victim->envStage == EnvelopeStage::release))
+        {
+            if (releasing)
+                victim = &v;
+            continue;
+        }
+
+        const bool better = stealPolicy == StealPolicy::quietest
+                                ? v.peak < victim->peak
+                                : (int) (v.startOrder - victim->startOrder) < 0; // wrap-safe "older"
+        if (better)
+            victim = &v;
+    }
+
+    return victim;
+}
+
+void SamplePlayer::beginFadeOut (Voice& v) noexcept
+{
+    v.fadeRemaining = fadeLengthSamples;
+    v.fadeLevel = 1.0f;
+}
+
+void SamplePlayer::stopLooping (Voice& v) noexcept
+{
+    v.loop = nullptr;
+
+    // past the loop a streamed sample continues from disk
+    if (v.data->isStreaming() && v.streamSlot < 0)
+        v.streamSlot = streamer.acquire (v.data->stream, v.data->getNumFramesInMemory());
+}
+
+void SamplePlayer::endVoice (Voice& v) noexcept
+{
+    streamer.release (v.streamSlot);
+    v.streamSlot = -1;
+    v.active = false;
 }
 
-void SamplePlayer::beginBlock() noexcept
+void SamplePlayer::stopAllVoices() noexcept
 {
-    // no-op for now; samples are pushed per-sample
+    for (auto* v : activeVoices)
+    {
+        if (v->active)
+            endVoice (*v);
+        v->listed = false;
+    }
+
+    activeVoices.clear();
+    playing = false;
 }
 
-void SamplePlayer::endBlock() noexcept
+void SamplePlayer::renderBlock (float* const* out, int numOutputChannels, int startSample, int numSamples, RenderScratch& scratch) noexcept
 {
-    const float average = vuBufferSize > 0 ? (vuSum / (float) vuBufferSize) : 0.0f;
-    float db = juce::Decibels::gainToDecibels (average + 1.0e-6f, -80.0f);
-    if (db < lastVuDb) {// hold peaks a bit
-        db = (lastVuDb + db) / 2.0f; 
+    if (! playing)
+        return;
+
+    bool anyActive = false;
+
+    for (auto* v : activeVoices)
+    {
+        if (! v->active)
+            continue;
+
+        renderVoice (*v, out, numOutputChannels, startSample, numSamples, scratch);
+        anyActive = anyActive || v->active;
     }
-    lastVuDb = juce::jlimit (-60.0f, 6.0f, db);
+
+    // voices that ended anywhere since the last block leave the list here
+    activeVoices.erase (std::remove_if (activeVoices.begin(), activeVoices.end(),
+                                        [] (Voice* v) { v->listed = v->active; return ! v->active; }),
+                        activeVoices.end());
+    playing = anyActive;
 }
 
-void SamplePlayer::pushVuSample (float sample) noexcept
+void SamplePlayer::setRenderTarget (float* const* out, int numOutputChannels, int startSample, bool renderDirect) noexcept
 {
-    if (vuBuffer.empty())
+    target = out;
+    targetChannels = juce::jmin (numOutputChannels, mix.getNumChannels());
+    targetStart = startSample;
+    targetDirect = renderDirect;
+}
+
+void SamplePlayer::renderChunk (int numSamples, RenderScratch& scratch) noexcept
+{
+    mixValid = false;
+    if (! isSounding() || target == nullptr)
+        return;
+
+    // a direct target held silence before, so either way the meter sees
+    // this player alone
+    if (targetDirect)
+    {
+        renderBlock (target, targetChannels, targetStart, numSamples, scratch);
+        meter.addSamples (target, targetChannels, targetStart, numSamples);
         return;
+    }
+
+    numSamples = juce::jmin (numSamples, mix.getNumSamples());
+    mix.clear (0, numSamples);
+    renderBlock (mix.getArrayOfWritePointers(), targetChannels, 0, numSamples, scratch);
+    meter.addSamples (mix.getArrayOfReadPointers(), targetChannels, 0, numSamples);
+    mixValid = true;
+}
+
+void SamplePlayer::addMixToOutput (int numSamples) noexcept
+{
+    if (! mixValid)
+        return;
+
+    numSamples = juce::jmin (numSamples, mix.getNumSamples());
+    for (int ch = 0; ch < targetChannels; ++ch)
+        juce::FloatVectorOperations::add (target[ch] + targetStart, mix.getReadPointer (ch), numSamples);
+}
+
+void SamplePlayer::renderVoice (Voice& v, float* const* out, int numOutputChannels, int startSample, int numSamples, RenderScratch& scratch) noexcept
+{
+    const auto& data = *v.data;
+    const float level = gain * v.level;
+    const int64 totalSamples = data.lengthInSamples;
+    const int64 framesInMemory = data.getNumFramesInMemory();
+    const int numSampleChans = data.getNumChannels();
+    const int padding = Interpolator::getPreFrames (interpolation) + Interpolator::getPostFrames (interpolation) + 2;
+    const int maxStagedOut = juce::jmax (1, (int) ((double) ((int) scratch.source.size() - padding) / v.increment));
+    int done = 0;
+
+    while (done < numSamples && v.active)
+    {
+        if (v.envStage == EnvelopeStage::done)
+        {
+            endVoice (v);
+            break;
+        }
+
+        const bool fading = v.fadeRemaining > 0;
+        const bool unity = v.unityRate;
+
+        // a looping voice runs until its envelope or a steal ends it
+        int num = v.loop != nullptr ? numSamples - done
+                                    : (int) juce::jmin ((double) (numSamples - done),
+                                                        std::ceil (((double) totalSamples - v.position) / v.increment));
+        if (fading)
+            num = juce::jmin (num, v.fadeRemaining);
+        // stop on the sample the release ends
+        if (v.envStage == EnvelopeStage::release)
+            num = juce::jmin (num, v.envRemaining);
+        if (! unity)
+            num = juce::jmin (num, maxStagedOut);
+
+        if (num <= 0)
+        {
+            endVoice (v);
+            break;
+        }
+
+        // streamed frames past the head, and a loop's seam, are always staged;
+        // a looping voice reads the body of its loop in place up to the seam
+        const int64 directEnd = v.loop != nullptr ? juce::jmin (framesInMemory, v.loop->seamStart) : framesInMemory;
+        if (unity && v.loop != nullptr && v.position < (double) directEnd)
+            num = juce::jmin (num, (int) (directEnd - (int64) v.position));
+
+        const bool direct = unity && v.position + (double) num <= (double) directEnd;
+        if (unity && ! direct)
+            num = juce::jmin (num, (int) scratch.source.size() - padding);
+
+        // The voice gain is its level times the envelope, and times the
+        // steal fade while fading. Unless both hold still it becomes one
+        // ramp per voice in scratch.gain, shared by all channels.
+        float* gainRamp = scratch.gain.data();
+        const bool enveloped = renderEnvelope (v, gainRamp, num);
+        const bool ramped = enveloped || fading;
+        float voiceGain = level * v.envLevel;
+
+        if (enveloped)
+            juce::FloatVectorOperations::multiply (gainRamp, level, num);
+
+        if (fading)
+        {
+            const float step = 1.0f / (float) fadeLengthSamples;
+            const float f0 = v.fadeLevel;
+
+            if (enveloped)
+                for (int i = 0; i < num; ++i)
+                    gainRamp[i] *= f0 - step * (float) i;
+            else
+                for (int i = 0; i < num; ++i)
+                    gainRamp[i] = voiceGain * (f0 - step * (float) i);
+
+            v.fadeLevel -= step * (float) num;
+            v.fadeRemaining -= num;
+        }
+
+        if (ramped)
+            voiceGain = juce::jmax (gainRamp[0], gainRamp[num - 1]);
+
+        int lastSourceChannel = -1;
+        const float* src = nullptr;
 
-    const float mag = std::abs (sample);
-    vuSum -= vuBuffer[(size_t) vuWritePos];
-    vuBuffer[(size_t) vuWritePos] = mag;
-    vuSum += mag;
-    vuWritePos = (vuWritePos + 1) % vuBufferSize;
+        for (int ch = 0; ch < numOutputChannels; ++ch)
+        {
+            const int sourceChannel = juce::jmin (ch, numSampleChans - 1);
+
+            // mono sources feed every output from one pass
+            if (sourceChannel != lastSourceChannel)
+            {
+                src = direct ? data.getFloatChannel (sourceChannel) + (int64) v.position
+                             : readVoiceChannel (v, sourceChannel, num, scratch);
+                lastSourceChannel = sourceChannel;
+
+                if (ch == 0)
+                {
+                    const auto range = juce::FloatVectorOperations::findMinAndMax (src, num);
+                    v.peak = juce::jmax (-range.getStart(), range.getEnd()) * voiceGain;
+                }
+            }
+
+            float* dest = out[ch] + startSample + done;
+
+            if (ramped)
+                juce::FloatVectorOperations::addWithMultiply (dest, src, gainRamp, num);
+            else
+                juce::FloatVectorOperations::addWithMultiply (dest, src, voiceGain, num);
+        }
+
+        v.position += v.increment * (double) num;
+        done += num;
+
+        if (v.loop != nullptr && v.position >= (double) v.loop->end)
+            v.position = (double) v.loop->start + std::fmod (v.position - (double) v.loop->start, (double) v.loop->getLength());
+
+        if (v.streamSlot >= 0)
+            streamer.setConsumed (v.streamSlot, (int64) v.position - Interpolator::getPreFrames (interpolation));
+
+        if (v.position >= (double) totalSamples || (fading && v.fadeRemaining <= 0)
+            || v.envStage == EnvelopeStage::done)
+            endVoice (v);
+    }
+}
+
+const float* SamplePlayer::readVoiceChannel (const Voice& v, int sourceChannel, int numOut, RenderScratch& scratch) noexcept
+{
+    const int pre = Interpolator::getPreFrames (interpolation);
+    const int post = Interpolator::getPostFrames (interpolation);
+    const int64 base = (int64) v.position;
+    const double phase = v.position - (double) base;
+
+    // stage the frames the kernel touches, zero-padded past either end
+    const int count = (int) (phase + v.increment * (double) (numOut - 1)) + 1 + pre + post + 1;
+    float* staged = scratch.source.data();
+    stageFrames (v, sourceChannel, base - pre, count, staged);
+
+    // streamed audio at the recorded pitch needs no kernel
+    if (v.unityRate)
+        return staged + pre;
+
+    Interpolator::process (interpolation, staged + pre, phase, v.increment, scratch.interp.data(), numOut);
+    return scratch.interp.data();
+}
+
+void SamplePlayer::stageFrames (const Voice& v, int sourceChannel, int64 first, int count, float* dest) noexcept
+{
+    const auto& data = *v.data;
+
+    // a loop lies entirely in RAM and reads as straight runs through its seam
+    if (v.loop != nullptr)
+    {
+        v.loop->read (data, sourceChannel, first, count, dest);
+        return;
+    }
+
+    // mapped frames convert straight from the file's pages
+    data.readFrames (sourceChannel, first, count, dest);
+
+    if (! data.isStreaming())
+    {
+        // a voice that catches up with a progressive load plays silence there
+        if (sourceChannel == 0 && juce::jmin (first + count, data.lengthInSamples) > data.getNumFramesReady())
+            underruns.fetch_add (1, std::memory_order_relaxed);
+        return;
+    }
+
+    const int64 last = first + count;
+    const int64 framesInMemory = data.getNumFramesInMemory();
+    const int64 streamStart = juce::jmax (first, framesInMemory);
+    const int64 streamEnd = juce::jmin (last, data.lengthInSamples);
+    if (streamEnd <= streamStart)
+        return;
+
+    const int wanted = (int) (streamEnd - streamStart);
+    const int got = v.streamSlot >= 0 ? streamer.read (v.streamSlot, sourceChannel, streamStart, wanted, dest + (streamStart - first))
+                                      : 0;
+
+    // the missing tail stays silent and the voice carries on in time;
+    // counted once per chunk, on the first channel
+    if (got < wanted && sourceChannel == 0)
+        underruns.fetch_add (1, std::memory_order_relaxed);
+}
+
+void SamplePlayer::beginBlock (bool truePeak) noexcept
+{
+    meter.beginBlock (truePeak);
+}
+
+void SamplePlayer::endBlock (int numSamples) noexcept
+{
+    meter.endBlock (numSamples);
+    vuSnapshot.store (meter.getPeakDb(), std::memory_order_relaxed);
+    rmsSnapshot.store (meter.getRmsDb(), std::memory_order_relaxed);
+    playingSnapshot.store (playing, std::memory_order_relaxed);
+}
+
+void SamplePlayer::resetVu() noexcept
+{
+    meter.reset();
+    vuSnapshot.store (LevelMeter::floorDb, std::memory_order_relaxed);
+    rmsSnapshot.store (LevelMeter::floorDb, std::memory_order_relaxed);
 }
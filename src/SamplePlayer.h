@@ -1,55 +1,342 @@
 #pragma once
 
 #include <JuceHeader.h>
+#include <array>
+#include <atomic>
+#include <map>
+#include <memory>
 #include <vector>
+#include "DiskStreamer.h"
+#include "Interpolator.h"
+#include "LevelMeter.h"
+#include "SampleData.h"
+#include "ZoneMap.h"
 
-// A lightweight sample player placeholder that will later own audio data.
+// A single sample slot, holding one or more zones: samples placed by key,
+// velocity and round-robin order. Zone 0 is the player's main sample. The
+// State struct is the control-side model used by the API and session code;
+// the remaining members belong to the audio thread and are only changed
+// through the engine's command queue.
 class SamplePlayer
 {
 public:
+    static constexpr int maxPolyphony = 32;
+    static constexpr double maxPitchRatio = 16.0;
+    static constexpr int numAuxOutputs = 16;   // output bus 0 is the main output
+    static constexpr int maxZones = 512;
+    static constexpr float maxEnvelopeMs = 30000.0f;
+    static constexpr int envelopeBlockSize = 32;   // longest straight piece of a curved segment
+    static constexpr int maxLoopCrossfade = 131072;
+
+    // Which sounding voice makes room when a note arrives at full polyphony.
+    // sameNote also fades out any voice already playing the incoming note.
+    enum class StealPolicy { oldest, quietest, sameNote };
+
+    // How a loaded file is held: decoded into RAM, streamed from disk behind
+    // a preloaded head, or mapped and converted while it plays (PCM WAV/AIFF
+    // only; other files fall back to memory).
+    enum class Storage { memory, stream, mapped };
+
+    // Amplitude envelope for every voice. The attack is a linear ramp; decay
+    // and release follow `curve`, an exponential segment falling 60 dB over
+    // its time. A one-shot player ignores note-offs and the sustain pedal and
+    // plays each sample to its end. The release is never shorter than the
+    // fade used for stolen voices.
+    enum class EnvelopeCurve { linear, exponential };
+
+    struct Envelope
+    {
+        float attackMs { 0.0f };
+        float decayMs { 0.0f };
+        float sustain { 1.0f };
+        float releaseMs { 0.0f };
+        EnvelopeCurve curve { EnvelopeCurve::linear };
+        bool oneShot { true };
+    };
+
+    // Sustain loop, used by players that are not one-shot. Zone 0 loops over
+    // [start, end) in frames of its file, or over the loop in the file's smpl
+    // chunk while both are -1; other zones use their own file's loop. Voices
+    // keep looping through their release.
+    struct Loop
+    {
+        bool enabled { true };
+        int64 start { -1 };
+        int64 end { -1 };
+        int crossfade { 0 };   // frames
+    };
+
+    // Per-thread working memory for rendering, sized in prepareToPlay.
+    struct RenderScratch
+    {
+        void prepare (int maxBlockSize);
+
+        std::vector<float> gain;    // per-sample voice gain ramp
+        std::vector<float> source;  // staged source frames for one channel
+        std::vector<float> interp;  // resampled output for one channel
+    };
+
+    struct ZoneState
+    {
+        int id { 0 };
+        Zone zone;
+        juce::String filePath;
+        juce::String fileName;
+        juce::String status { "empty" };
+    };
+
     struct State
     {
         int id {};
         int midiLow { 36 };   // default C2
         int midiHigh { 60 };  // default C4
+        int midiChannel { 0 };  // 0 for omni, otherwise 1-16
         float gain { 1.0f };
+        int polyphony { 8 };
+        StealPolicy stealPolicy { StealPolicy::oldest };
+        int rootKey { 60 };
+        Interpolator::Mode interpolation { Interpolator::Mode::hermite };
+        Storage storage { Storage::memory };
+        CompactStorage::Format sampleFormat { CompactStorage::Format::float32 };
+        int underruns { 0 };
+        int outputBus { 0 };
+        VelocityCurve velocityCurve { VelocityCurve::fixed };
+        Envelope envelope;
+        Loop loop;
         bool isPlaying { false };
+        // zone 0, the main sample
         juce::String status { "empty" };
         juce::String fileName;
         juce::String filePath;
         juce::String waveformSVG;
+        std::vector<ZoneState> zones;   // including zone 0
     };
 
-    explicit SamplePlayer (int newId);
+    SamplePlayer (int newId, DiskStreamer& diskStreamer);
 
     int getId() const noexcept { return state.id; }
 
+    // Control side (engine holds playerMutex)
     void setMidiRange (int low, int high) noexcept;
+    void setMidiChannel (int channel) noexcept;
+    int getMidiLow() const noexcept { return state.midiLow; }
+    int getMidiHigh() const noexcept { return state.midiHigh; }
+    int getMidiChannel() const noexcept { return state.midiChannel; }
     void setGain (float g) noexcept;
-    void setFilePathAndStatus (const juce::String& path, const juce::String& statusLabel, const juce::String& displayName = {});
+    void setVoiceSettings (int polyphony, StealPolicy policy) noexcept;
+    void setPitchSettings (int rootKey, Interpolator::Mode mode) noexcept;
+    void setOutputBus (int bus) noexcept;
+    void setStorage (Storage storage) noexcept { state.storage = storage; }
+    // Format for decoded samples; applies from the next load.
+    void setSampleFormat (CompactStorage::Format format) noexcept { state.sampleFormat = format; }
+    void setVelocityCurve (VelocityCurve curve) noexcept { state.velocityCurve = curve; }
+    void setEnvelope (const Envelope& envelope) noexcept;
+    // Applies with the next zone map.
+    void setLoop (const Loop& loop) noexcept;
+    void setFilePathAndStatus (int zoneId, const juce::String& path, const juce::String& statusLabel, const juce::String& displayName = {});
+    void setLoadedState (int zoneId, const juce::String& name, const juce::String& waveformSVG);
+    void markError (int zoneId, const juce::String& path, const juce::String& message);
     State getState() const noexcept;
+    void resetUnderruns() noexcept { underruns.store (0, std::memory_order_relaxed); }
 
-    bool acceptsNote (int midiNote) const noexcept;
-    void trigger();
-    void triggerNote (int midiNote);
-    float getNextSampleForChannel (int channel);
+    // Zones other than zone 0 are added and removed here; ids are never reused.
+    // addZone returns -1 once the player holds maxZones.
+    int addZone (const Zone& zone);
+    bool setZone (int zoneId, const Zone& zone);
+    bool removeZone (int zoneId);
+    bool hasZone (int zoneId) const noexcept;
 
-    bool setLoadedBuffer (juce::AudioBuffer<float>&& newBuffer, const juce::String& name);
-    void markError (const juce::String& path, const juce::String& message);
+    // Each zone's decoded file at its own rate, plus conversions to host rates
+    // that have been seen, so a host rate change can swap instead of
+    // reloading. Streamed and mapped samples are never converted; their
+    // voices resample on the fly.
+    void setZoneSource (int zoneId, SampleDataPtr data);
+    SampleDataPtr getZoneSource (int zoneId) const;
+    void cacheZoneData (int zoneId, double hostRate, SampleDataPtr data);
+    // Builds the audio-side map for hostRate. Zones still lacking a conversion
+    // play their source for now and are listed in needsConversion, each only
+    // once per rate.
+    ZoneMapPtr buildZoneMap (double hostRate, std::vector<std::pair<int, SampleDataPtr>>& needsConversion);
     juce::String getWaveformSVG() const noexcept { return state.waveformSVG; }
-    void beginBlock() noexcept;
-    void endBlock() noexcept;
-    float getLastVuDb() const noexcept { return lastVuDb; }
+
+    // Copies the control model into the audio-side fields. Only valid before
+    // the player has been published to the audio thread.
+    void syncAudioState() noexcept;
+
+    static juce::String stealPolicyToString (StealPolicy policy);
+    static StealPolicy stealPolicyFromString (const juce::String& name);
+    static juce::String storageToString (Storage storage);
+    static Storage storageFromString (const juce::String& name);
+    static juce::String envelopeCurveToString (EnvelopeCurve curve);
+    static EnvelopeCurve envelopeCurveFromString (const juce::String& name);
+
+    // Audio side (called from SamplerEngine::prepareToPlay/processBlock only)
+    void prepare (double sampleRate, int maxBlockSize);
+    void applyGain (float g) noexcept;
+    void applyVoiceSettings (int polyphony, StealPolicy policy) noexcept;
+    void applyPitchSettings (int rootKey, Interpolator::Mode mode) noexcept;
+    void applyOutputBus (int bus) noexcept { outputBus = bus; }
+    void applyEnvelope (const Envelope& newEnvelope) noexcept;
+    // Installs a new zone map and returns the previous one so the caller can
+    // release it off the audio thread. Voices whose zone and file are still
+    // in the map carry on, moved to its data if the rate changed; the rest
+    // stop.
+    ZoneMapPtr swapZoneMap (ZoneMapPtr newMap) noexcept;
+
+    // Which notes reach a player is decided by the engine's dispatch table;
+    // velocity and round robin pick the zones within it.
+    bool hasSample() const noexcept { return zoneMap != nullptr && zoneMap->getNumEntries() > 0; }
+    // Plays the zones for the root key at full velocity and recorded pitch.
+    void trigger() noexcept;
+    void triggerNote (int midiNote, int velocity) noexcept;
+    // Releases the note's voices, or holds them until the pedal lifts.
+    void releaseNote (int midiNote) noexcept;
+    void setSustainPedal (bool down) noexcept;
+    // Ends every voice at once, without a fade, e.g. when the player is removed.
+    void stopAllVoices() noexcept;
+    // Adds this player's output for [startSample, startSample + numSamples)
+    // into the given channels. numSamples must fit the prepared scratch.
+    void renderBlock (float* const* out, int numOutputChannels, int startSample, int numSamples, RenderScratch& scratch) noexcept;
+
+    // Chunked rendering used by the engine, which may spread players over
+    // several threads. setRenderTarget names the output bus channels for the
+    // next chunk; with renderDirect the player adds into them as it renders,
+    // otherwise it renders into its own mix buffer and addMixToOutput adds
+    // that afterwards, so players sharing a bus are summed in a fixed order.
+    int getOutputBus() const noexcept { return outputBus; }
+    bool isSounding() const noexcept { return playing; }
+    void setRenderTarget (float* const* out, int numOutputChannels, int startSample, bool renderDirect) noexcept;
+    void renderChunk (int numSamples, RenderScratch& scratch) noexcept;
+    void addMixToOutput (int numSamples) noexcept;
+
+    // Metering of everything the player renders in a host block; see LevelMeter.
+    void beginBlock (bool truePeak) noexcept;
+    void endBlock (int numSamples) noexcept;
+    // Latest meter readings, in dB, for control threads; stored once per block.
+    float getVuDb() const noexcept { return vuSnapshot.load (std::memory_order_relaxed); }
+    float getRmsDb() const noexcept { return rmsSnapshot.load (std::memory_order_relaxed); }
+
+    // Sounding, or with a meter still falling back to its floor. The engine
+    // only visits players in this state and keeps them on a list of its own.
+    bool isActive() const noexcept { return playing || ! meter.isSilent(); }
+    bool isOnActiveList() const noexcept { return onActiveList; }
+    void setOnActiveList (bool listed) noexcept { onActiveList = listed; }
 
 private:
-    void pushVuSample (float sample) noexcept;
+    enum class EnvelopeStage { attack, decay, sustain, release, done };
+
+    struct Voice
+    {
+        bool active { false };
+        bool listed { false };        // in activeVoices, which may lag `active` until the next render
+        int note { -1 };
+        int zoneId { 0 };
+        const SampleData* data { nullptr };     // owned by the current zone map
+        const SampleData* source { nullptr };   // identity only, see ZoneMap::Entry
+        const SampleLoop* loop { nullptr };     // owned by the current zone map; set while looping
+        float level { 1.0f };         // from the velocity curve
+        double position { 0.0 };      // fractional read position in source frames
+        double increment { 1.0 };
+        double pitchRatio { 1.0 };
+        int transpose { 0 };          // semitones from the zone's root key
+        bool unityRate { false };     // increment is exactly 1 and position on a whole frame
+        uint32 startOrder { 0 };
+        float peak { 0.0f };          // last rendered level, for quietest stealing
+        int fadeRemaining { 0 };      // > 0 while fading out after being stolen
+        float fadeLevel { 1.0f };
+        int streamSlot { -1 };        // DiskStreamer slot while playing a streamed sample
+        bool sustained { false };     // note-off arrived while the pedal was down
+
+        // Envelope segment in progress. Linear segments move by envStep per
+        // sample; exponential ones close the distance to envTarget by envCoef
+        // per sample and envCoefBlock per full envelope block.
+        EnvelopeStage envStage { EnvelopeStage::sustain };
+        float envLevel { 1.0f };
+        float envTarget { 1.0f };
+        float envStep { 0.0f };
+        float envCoef { 1.0f };
+        float envCoefBlock { 1.0f };
+        bool envExponential { false };
+        int envRemaining { 0 };
+    };
+
+    void startZones (int lookupNote, int velocity, int voiceNote) noexcept;
+    void startVoice (int voiceNote, const ZoneMap::Entry& entry, float level) noexcept;
+    Voice* findFreeVoice() noexcept;
+    Voice* chooseVoiceToSteal() noexcept;
+    void beginFadeOut (Voice& v) noexcept;
+    void endVoice (Voice& v) noexcept;
+    void stopLooping (Voice& v) noexcept;
+    void startEnvelope (Voice& v) noexcept;
+    void startSegment (Voice& v, EnvelopeStage stage, float targetLevel, int length, bool exponential) noexcept;
+    void finishSegment (Voice& v) noexcept;
+    void startRelease (Voice& v) noexcept;
+    bool renderEnvelope (Voice& v, float* gainOut, int num) noexcept;
+    void updateEnvelopeTimes() noexcept;
+    void renderVoice (Voice& v, float* const* out, int numOutputChannels, int startSample, int numSamples, RenderScratch& scratch) noexcept;
+    const float* readVoiceChannel (const Voice& v, int sourceChannel, int numOut, RenderScratch& scratch) noexcept;
+    void stageFrames (const Voice& v, int sourceChannel, int64 first, int count, float* dest) noexcept;
+    void updateIncrement (Voice& v) noexcept;
+    void resetVu() noexcept;
+
+    struct ZoneData
+    {
+        SampleDataPtr source;
+        std::map<int, SampleDataPtr> dataByRate;
+        int convertingTo { 0 };   // host rate a conversion was last requested for
+
+        // the last loop built, reused while its data and points are unchanged
+        SampleLoopPtr loop;
+        const SampleData* loopData { nullptr };
+        int64 loopStart { 0 }, loopEnd { 0 }, loopCrossfade { 0 };
+    };
+
+    SampleLoopPtr getZoneLoop (int zoneId, ZoneData& d, const SampleData& data);
+
+    ZoneState* findZone (int zoneId) noexcept;
 
     State state;
-    juce::AudioBuffer<float> sampleBuffer;
-    int playHead { 0 };
-    std::vector<float> vuBuffer;
-    int vuWritePos { 0 };
-    float vuSum { 0.0f };
-    int vuBufferSize { 1024 };
-    float lastVuDb { -60.0f };
+    std::map<int, ZoneData> zoneData;
+    int nextZoneId { 1 };
+
+    DiskStreamer& streamer;
+    ZoneMapPtr zoneMap;
+    double hostSampleRate { 44100.0 };
+    float gain { 1.0f };
+    int polyphony { 8 };
+    StealPolicy stealPolicy { StealPolicy::oldest };
+    int rootKey { 60 };
+    Interpolator::Mode interpolation { Interpolator::Mode::hermite };
+    int fadeLengthSamples { 256 };
+    Envelope envelope;
+    int attackSamples { 0 };
+    int decaySamples { 0 };
+    int releaseSamples { 256 };
+    bool sustainPedal { false };
+
+    // Twice the polyphony limit so stolen voices can fade while their
+    // replacements start. Allocated once in the constructor.
+    std::vector<Voice> voices;
+    // The voices in use, in the order they were claimed, so the per-block
+    // work follows the number of voices sounding. Reserved for every voice
+    // in the constructor; only startVoice adds and only renderBlock removes.
+    std::vector<Voice*> activeVoices;
+    uint32 nextStartOrder { 0 };
+    std::array<uint32, 128> roundRobin {};   // next step per note
+    bool playing { false };
+    bool onActiveList { false };
+    std::atomic<bool> playingSnapshot { false };
+
+    int outputBus { 0 };
+    float* const* target { nullptr };
+    int targetChannels { 0 };
+    int targetStart { 0 };
+    bool targetDirect { false };
+    juce::AudioBuffer<float> mix;   // stereo, one block
+    bool mixValid { false };
+
+    LevelMeter meter;
+    std::atomic<float> vuSnapshot { LevelMeter::floorDb };
+    std::atomic<float> rmsSnapshot { LevelMeter::floorDb };
+    std::atomic<int> underruns { 0 };   // render chunks that found streamed or loading data missing
 };
@@ -0,0 +1,93 @@
+#include "SamplePool.h"
+
+juce::String SamplePool::makeKey (const juce::File& file, const juce::String& variant)
+{
+    const auto canonical = file.getLinkedTarget();
+    return canonical.getFullPathName()
+         + "|" + juce::String (canonical.getLastModificationTime().toMilliseconds())
+         + "|" + juce::String (canonical.getSize())
+         + "|" + variant;
+}
+
+juce::String SamplePool::makeRateKey (const juce::String& sourceKey, double sampleRate)
+{
+    return sourceKey + "@" + juce::String (juce::roundToInt (sampleRate));
+}
+
+SampleDataPtr SamplePool::getOrCreate (const juce::String& key, const std::function<SampleDataPtr()>& create)
+{
+    std::promise<SampleDataPtr> promise;
+    std::shared_future<SampleDataPtr> inFlight;
+
+    {
+        const std::lock_guard<std::mutex> guard (lock);
+        auto& entry = entries[key];
+
+        if (auto existing = entry.data.lock())
+            return existing;
+
+        if (entry.pending.valid())
+            inFlight = entry.pending;
+        else
+            entry.pending = promise.get_future().share();
+    }
+
+    if (inFlight.valid())
+    {
+        // a failed load is retried here so the caller gets its own error
+        if (auto loaded = inFlight.get())
+            return loaded;
+
+        return create();
+    }
+
+    SampleDataPtr created;
+    try
+    {
+        created = create();
+    }
+    catch (...)
+    {
+        // never leave waiters hanging on an abandoned promise
+        created = nullptr;
+    }
+
+    {
+        const std::lock_guard<std::mutex> guard (lock);
+        auto& entry = entries[key];
+        entry.data = created;
+        entry.pending = {};
+        pruneExpired();
+    }
+
+    promise.set_value (created);
+    return created;
+}
+
+SamplePool::Stats SamplePool::getStats() const
+{
+    const std::lock_guard<std::mutex> guard (lock);
+    Stats stats;
+
+    for (const auto& item : entries)
+    {
+        if (auto data = item.second.data.lock())
+        {
+            ++stats.entries;
+            stats.bytesInMemory += data->getBytesInMemory();
+        }
+    }
+
+    return stats;
+}
+
+void SamplePool::pruneExpired()
+{
+    for (auto it = entries.begin(); it != entries.end();)
+    {
+        if (it->second.data.expired() && ! it->second.pending.valid())
+            it = entries.erase (it);
+        else
+            ++it;
+    }
+}
@@ -0,0 +1,52 @@
+#pragma once
+
+#include <JuceHeader.h>
+#include <functional>
+#include <future>
+#include <map>
+#include <mutex>
+#include "SampleData.h"
+
+// Process-wide cache of loaded samples, shared by every player and every
+// plugin instance in the host (hold it through juce::SharedResourcePointer).
+//
+// Entries are keyed by file identity plus how the sample is held, and the
+// pool only keeps weak references: a sample lives as long as some player or
+// pending command holds it. Players release their handles on control
+// threads and the audio thread hands its references back through the
+// engine's retire queue, so the last reference never drops on the audio
+// thread.
+class SamplePool
+{
+public:
+    // Identifies a file by canonical path, modification time and size, so an
+    // edited file is loaded again rather than served stale.
+    static juce::String makeKey (const juce::File& file, const juce::String& variant);
+    // Key for a copy of a pooled sample converted to another rate.
+    static juce::String makeRateKey (const juce::String& sourceKey, double sampleRate);
+
+    // Returns the pooled sample for key, or runs create and pools its result.
+    // Concurrent requests for the same key wait for the first one instead of
+    // decoding the file again. create may return nullptr on failure.
+    SampleDataPtr getOrCreate (const juce::String& key, const std::function<SampleDataPtr()>& create);
+
+    struct Stats
+    {
+        int entries { 0 };
+        int64 bytesInMemory { 0 };
+    };
+
+    Stats getStats() const;
+
+private:
+    struct Entry
+    {
+        std::weak_ptr<const SampleData> data;
+        std::shared_future<SampleDataPtr> pending;
+    };
+
+    void pruneExpired();
+
+    std::map<juce::String, Entry> entries;
+    mutable std::mutex lock;
+};
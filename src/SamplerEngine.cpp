@@ -1,173 +1,1215 @@
 #include "SamplerEngine.h"
+#include "OfflineResampler.h"
 #include "WaveformSVGRenderer.h"
+#include <algorithm>
+#include <limits>
 #include <sstream>
 
 SamplerEngine::SamplerEngine()
+    : audioPlayers (std::make_unique<PlayerList>())
 {
     formatManager.registerBasicFormats();
-    vuJson = "{\"dB_out\":[]}";
+    Interpolator::prepareTables();
+    prepareToPlay (44100.0, 512);
+    reclaimer.startThread();
+}
+
+SamplerEngine::~SamplerEngine()
+{
+    reclaimer.stopThread (1000);
+
+    // Pending and deferred commands and retired objects are released by
+    // their containers' destructors; the players themselves are owned by
+    // `players`.
+    audioPlayers.reset();
 }
 
 int SamplerEngine::addSamplePlayer()
 {
     const std::lock_guard<std::mutex> lock (playerMutex);
     auto id = nextId++;
-    players.push_back (std::make_unique<SamplePlayer> (id));
+    auto player = std::make_unique<SamplePlayer> (id, streamer);
+    player->prepare (currentSampleRate.load(), currentBlockSize.load());
+    players.push_back (std::move (player));
+    publishPlayers();
     return id;
 }
 
-void SamplerEngine::processBlock (juce::AudioBuffer<float>& buffer, const juce::MidiBuffer& midi)
-{
-    // Build a per-sample list of note-ons for sample-accurate triggering
-    const int numSamples = buffer.getNumSamples();
-    std::vector<std::vector<int>> noteOns ((size_t) numSamples);
+bool SamplerEngine::removeSamplePlayer (int playerId)
+{
+    const std::lock_guard<std::mutex> lock (playerMutex);
+    auto it = std::find_if (players.begin(), players.end(),
+                            [playerId] (const auto& p) { return p->getId() == playerId; });
+    if (it == players.end())
+        return false;
+
+    // the published list keeps it alive until the audio thread retires it
+    cancelLoads (playerId, -1);
+
+    std::vector<std::unique_ptr<SamplePlayer>> released;
+    released.push_back (std::move (*it));
+    players.erase (it);
+    return publishPlayers (std::move (released));
+}
+
+void SamplerEngine::prepareToPlay (double sampleRate, int samplesPerBlock)
+{
+    const double previousRate = currentSampleRate.exchange (sampleRate);
+    currentBlockSize.store (samplesPerBlock);
+
+    // room for dense MIDI plus a burst of API triggers
+    blockEvents.prepare (samplesPerBlock * 2 + commands.getCapacity());
+    renderScratch.prepare (samplesPerBlock);
+
+    // The audio thread is stopped while the host calls this, so the
+    // audio-side rate can be set directly. Buffers for the new rate are
+    // swapped in through the queue, from the cache where possible.
+    const std::lock_guard<std::mutex> lock (playerMutex);
+    renderWorkers.prepare (samplesPerBlock);
+
+    for (auto& player : players)
+    {
+        player->prepare (sampleRate, samplesPerBlock);
+
+        if (OfflineResampler::needsConversion (previousRate, sampleRate))
+            updatePlaybackData (*player);
+    }
+}
+
+bool SamplerEngine::processBlock (juce::AudioBuffer<float>& buffer, const juce::MidiBuffer& midi,
+                                  const OutputBus* buses, int numBuses)
+{
+    const int numSamples = buffer.getNumSamples();
+    blockEvents.clear();
+
+    // API triggers land at the start of the block
+    drainCommands();
+
+    for (const auto meta : midi)
+    {
+        const auto msg = meta.getMessage();
+
+        SamplerEvent ev;
+        ev.sampleOffset = juce::jlimit (0, juce::jmax (0, numSamples - 1), meta.samplePosition);
+        ev.channel = msg.getChannel();
+
+        if (msg.isNoteOn())
+        {
+            ev.type = SamplerEvent::Type::noteOn;
+            ev.number = msg.getNoteNumber();
+            ev.value = msg.getVelocity();
+        }
+        else if (msg.isNoteOff())
+        {
+            ev.type = SamplerEvent::Type::noteOff;
+            ev.number = msg.getNoteNumber();
+        }
+        else if (msg.isController())
+        {
+            ev.type = SamplerEvent::Type::controller;
+            ev.number = msg.getControllerNumber();
+            ev.value = msg.getControllerValue();
+        }
+        else
+        {
+            continue;
+        }
+
+        blockEvents.add (ev);
+    }
+
+    auto& activePlayers = audioPlayers->active;
+    blockTruePeak = truePeakMetering.load (std::memory_order_relaxed);
+
+    for (auto* player : activePlayers)
+        player->beginBlock (blockTruePeak);
+
+    buffer.clear();
+    blockAudible = false;
+
+    // idle players cost nothing; with none active and nothing to start one
+    // there is no work at all
+    if (activePlayers.empty() && blockEvents.size() == 0)
+        return false;
+
+    auto* const* channels = buffer.getArrayOfWritePointers();
+    const int numBufferChannels = buffer.getNumChannels();
+
+    for (int bus = 0; bus < maxOutputBuses; ++bus)
+    {
+        OutputBus layout;
+        if (buses == nullptr)
+            layout.numChannels = bus == 0 ? numBufferChannels : 0;
+        else if (bus < numBuses)
+            layout = buses[bus];
+
+        // players only ever write the first two channels of a bus
+        const int numChannels = juce::jlimit (0, juce::jmax (0, numBufferChannels - layout.firstChannel),
+                                              juce::jmin (2, layout.numChannels));
+        busNumChannels[bus] = numChannels;
+        for (int ch = 0; ch < numChannels; ++ch)
+            busChannels[bus][ch] = channels[layout.firstChannel + ch];
+    }
+
+    // render the stretches between events in one go
+    int pos = 0;
+    for (const auto& ev : blockEvents)
+    {
+        if (ev.sampleOffset > pos)
+        {
+            renderRange (pos, ev.sampleOffset - pos);
+            pos = ev.sampleOffset;
+        }
+
+        handleEvent (ev);
+    }
+
+    if (pos < numSamples)
+        renderRange (pos, numSamples - pos);
+
+    // meters are published per player; readers build the JSON themselves
+    for (auto* player : activePlayers)
+        player->endBlock (numSamples);
+
+    // players whose sound and meter have both died away leave the list
+    activePlayers.erase (std::remove_if (activePlayers.begin(), activePlayers.end(),
+                                         [] (SamplePlayer* p)
+                                         {
+                                             p->setOnActiveList (p->isActive());
+                                             return ! p->isOnActiveList();
+                                         }),
+                         activePlayers.end());
+
+    return blockAudible;
+}
+
+void SamplerEngine::activatePlayer (SamplePlayer& player) noexcept
+{
+    if (player.isOnActiveList() || ! player.isActive())
+        return;
+
+    // joining mid-block, so its meter starts from here
+    player.beginBlock (blockTruePeak);
+    player.setOnActiveList (true);
+    audioPlayers->active.push_back (&player);
+}
+
+void SamplerEngine::renderRange (int startSample, int numSamples) noexcept
+{
+    const auto& list = audioPlayers->active;
+    const int chunkSize = (int) renderScratch.interp.size();
+
+    // hosts may exceed the block size they announced; keep within scratch
+    for (int pos = startSample; pos < startSample + numSamples; pos += chunkSize)
+    {
+        const int num = juce::jmin (chunkSize, startSample + numSamples - pos);
+
+        // The first sounding player on each bus renders straight into it,
+        // since adding to silence is exact; any others on that bus go through
+        // their mix buffers and are added below in list order. The result is
+        // the same on any number of threads.
+        bool busTaken[maxOutputBuses] {};
+
+        for (auto* player : list)
+        {
+            int bus = player->getOutputBus();
+            if (busNumChannels[bus] == 0)
+                bus = 0;
+
+            const bool direct = player->isSounding() && ! busTaken[bus];
+            busTaken[bus] = busTaken[bus] || direct;
+            blockAudible = blockAudible || player->isSounding();
+            player->setRenderTarget (busChannels[bus], busNumChannels[bus], pos, direct);
+        }
+
+        renderWorkers.render (list.data(), (int) list.size(), num, renderScratch);
+
+        for (auto* player : list)
+            player->addMixToOutput (num);
+    }
+}
+
+void SamplerEngine::handleEvent (const SamplerEvent& ev) noexcept
+{
+    switch (ev.type)
+    {
+        case SamplerEvent::Type::noteOn:
+        case SamplerEvent::Type::noteOff:
+            if (ev.number >= 0 && ev.number < 128)
+            {
+                dispatchNoteRow (ev.number, ev);
+
+                if (ev.channel >= 1 && ev.channel <= 16)
+                    dispatchNoteRow (ev.channel * 128 + ev.number, ev);
+            }
+            break;
+
+        case SamplerEvent::Type::controller:
+            dispatchControllerRow (0, ev);
+
+            if (ev.channel >= 1 && ev.channel <= 16)
+                dispatchControllerRow (ev.channel, ev);
+            break;
+
+        case SamplerEvent::Type::trigger:
+            if (auto* player = getAudioPlayer (ev.playerId))
+            {
+                player->trigger();
+                activatePlayer (*player);
+            }
+            break;
+    }
+}
+
+void SamplerEngine::dispatchNoteRow (int row, const SamplerEvent& ev) noexcept
+{
+    const auto& list = *audioPlayers;
+    if (list.noteStart.empty())
+        return;
+
+    const auto end = list.noteStart[(size_t) row + 1];
+    for (auto i = list.noteStart[(size_t) row]; i < end; ++i)
+    {
+        auto* player = list.noteTargets[i];
+
+        if (ev.type == SamplerEvent::Type::noteOff)
+            player->releaseNote (ev.number);
+        else if (player->hasSample())
+        {
+            player->triggerNote (ev.number, ev.value);
+            activatePlayer (*player);
+        }
+    }
+}
+
+void SamplerEngine::dispatchControllerRow (int row, const SamplerEvent& ev) noexcept
+{
+    // only the sustain pedal for now
+    if (ev.number != 64)
+        return;
+
+    const auto& list = *audioPlayers;
+    if (list.channelStart.empty())
+        return;
+
+    const auto end = list.channelStart[(size_t) row + 1];
+    for (auto i = list.channelStart[(size_t) row]; i < end; ++i)
+        list.channelTargets[i]->setSustainPedal (ev.value >= 64);
+}
+
+void SamplerEngine::drainCommands() noexcept
+{
+    Command cmd;
+    while (commands.pop (cmd))
+    {
+        applyCommand (cmd);
+        cmd = Command();
+    }
+}
+
+void SamplerEngine::applyCommand (Command& cmd) noexcept
+{
+    Retired garbage;
+
+    switch (cmd.type)
+    {
+        case Command::Type::setPlayers:
+            std::swap (audioPlayers, cmd.players);
+
+            // dropped players go quiet and hand back their stream slots
+            for (auto& player : audioPlayers->released)
+                player->stopAllVoices();
+
+            // the outgoing list carries the players that only it referenced
+            cmd.players->released.swap (audioPlayers->released);
+
+            // active players carry over, in the new list's order
+            for (auto* player : audioPlayers->players)
+                if (player->isOnActiveList())
+                    audioPlayers->active.push_back (player);
+            garbage.players = std::move (cmd.players);
+            break;
+
+        case Command::Type::setGain:
+            if (auto* player = getAudioPlayer (cmd.playerId))
+                player->applyGain (cmd.gain);
+            break;
+
+        case Command::Type::setVoiceSettings:
+            if (auto* player = getAudioPlayer (cmd.playerId))
+                player->applyVoiceSettings (cmd.polyphony, cmd.stealPolicy);
+            break;
+
+        case Command::Type::setPitchSettings:
+            if (auto* player = getAudioPlayer (cmd.playerId))
+                player->applyPitchSettings (cmd.rootKey, cmd.interpolation);
+            break;
+
+        case Command::Type::setOutputBus:
+            if (auto* player = getAudioPlayer (cmd.playerId))
+                player->applyOutputBus (cmd.outputBus);
+            break;
+
+        case Command::Type::setEnvelope:
+            if (auto* player = getAudioPlayer (cmd.playerId))
+                player->applyEnvelope (cmd.envelope);
+            break;
+
+        case Command::Type::trigger:
+        {
+            SamplerEvent ev;
+            ev.type = SamplerEvent::Type::trigger;
+            ev.playerId = cmd.playerId;
+            blockEvents.add (ev);
+            break;
+        }
+
+        case Command::Type::setZoneMap:
+            if (auto* player = getAudioPlayer (cmd.playerId))
+                garbage.zones = player->swapZoneMap (std::move (cmd.zones));
+            else
+                garbage.zones = std::move (cmd.zones);
+            break;
+
+        case Command::Type::none:
+            break;
+    }
+
+    if (garbage.zones != nullptr || garbage.players != nullptr)
+    {
+        // Each command retires at most one item and the control side drains
+        // this queue before every push, so at twice the command capacity it
+        // cannot fill up.
+        const bool queued = retired.push (std::move (garbage));
+        jassert (queued);
+        juce::ignoreUnused (queued);
+    }
+}
+
+SamplePlayer* SamplerEngine::getAudioPlayer (int playerId) const noexcept
+{
+    for (auto* p : audioPlayers->players)
+    {
+        if (p->getId() == playerId)
+            return p;
+    }
+    return nullptr;
+}
+
+bool SamplerEngine::pushCommand (Command&& cmd)
+{
+    // The queue only fills up if the audio thread stalls. Waiting for it here
+    // would hold playerMutex, so the command joins the deferred ones instead,
+    // behind any already waiting so the audio thread sees them in order.
+    collectRetired();
+    sendDeferredCommands();
+
+    if (deferredCommands.empty() && commands.push (std::move (cmd)))
+        return true;
+
+    if ((int) deferredCommands.size() >= maxDeferredCommands)
+    {
+        juce::Logger::writeToLog ("SamplerEngine: command queue full, rejecting command");
+        return false;
+    }
+
+    deferredCommands.push_back (std::move (cmd));
+    numDeferredCommands.store ((int) deferredCommands.size());
+    return true;
+}
+
+void SamplerEngine::sendDeferredCommands()
+{
+    while (! deferredCommands.empty() && commands.push (std::move (deferredCommands.front())))
+        deferredCommands.pop_front();
+
+    numDeferredCommands.store ((int) deferredCommands.size());
+}
+
+void SamplerEngine::flushDeferredCommands()
+{
+    const std::lock_guard<std::mutex> lock (playerMutex);
+    sendDeferredCommands();
+}
+
+bool SamplerEngine::publishPlayers (std::vector<std::unique_ptr<SamplePlayer>> released)
+{
+    auto list = std::make_unique<PlayerList>();
+    list->players.reserve (players.size());
+    for (auto& p : players)
+        list->players.push_back (p.get());
+    list->active.reserve (list->players.size());
+    buildNoteTable (*list);
+    list->released = std::move (released);
+
+    Command cmd;
+    cmd.type = Command::Type::setPlayers;
+    cmd.players = std::move (list);
+
+    // If this fails (too many commands already deferred) the new players are
+    // not audible until the next successful publish, and the released ones
+    // may still be referenced by the audio thread, so they are parked until
+    // the engine is destroyed.
+    if (pushCommand (std::move (cmd)))
+        return true;
+
+    for (auto& p : cmd.players->released)
+        orphanedPlayers.push_back (std::move (p));
+    return false;
+}
+
+void SamplerEngine::buildNoteTable (PlayerList& list) const
+{
+    // counting pass, then fill; players keep list order within a row
+    auto& start = list.noteStart;
+    start.assign ((size_t) PlayerList::numNoteRows + 1, 0);
+
+    for (auto* player : list.players)
+        for (int note = player->getMidiLow(); note <= player->getMidiHigh(); ++note)
+            ++start[(size_t) (player->getMidiChannel() * 128 + note) + 1];
+
+    for (size_t row = 1; row < start.size(); ++row)
+        start[row] += start[row - 1];
+
+    list.noteTargets.resize (start.back());
+    auto next = start;
+
+    for (auto* player : list.players)
+        for (int note = player->getMidiLow(); note <= player->getMidiHigh(); ++note)
+            list.noteTargets[next[(size_t) (player->getMidiChannel() * 128 + note)]++] = player;
+
+    // one entry per player, in its channel's row
+    auto& channelStart = list.channelStart;
+    channelStart.assign ((size_t) PlayerList::numChannelRows + 1, 0);
+
+    for (auto* player : list.players)
+        ++channelStart[(size_t) player->getMidiChannel() + 1];
+
+    for (size_t row = 1; row < channelStart.size(); ++row)
+        channelStart[row] += channelStart[row - 1];
+
+    list.channelTargets.resize (channelStart.back());
+    auto nextInRow = channelStart;
+
+    for (auto* player : list.players)
+        list.channelTargets[nextInRow[(size_t) player->getMidiChannel()]++] = player;
+}
+
+void SamplerEngine::collectRetired()
+{
+    Retired item;
+    while (retired.pop (item))
+        item = Retired();
+}
+
+juce::var SamplerEngine::toVar() const
+{
+    const std::lock_guard<std::mutex> lock (playerMutex);
+    juce::Array<juce::var> arr;
+
+    for (const auto& player : players)
+    {
+        auto st = player->getState();
+        juce::DynamicObject::Ptr obj = new juce::DynamicObject();
+        obj->setProperty ("id", st.id);
+        obj->setProperty ("midiLow", st.midiLow);
+        obj->setProperty ("midiHigh", st.midiHigh);
+        obj->setProperty ("midiChannel", st.midiChannel);
+        obj->setProperty ("gain", st.gain);
+        obj->setProperty ("polyphony", st.polyphony);
+        obj->setProperty ("stealPolicy", SamplePlayer::stealPolicyToString (st.stealPolicy));
+        obj->setProperty ("rootKey", st.rootKey);
+        obj->setProperty ("interpolation", Interpolator::modeToString (st.interpolation));
+        obj->setProperty ("storage", SamplePlayer::storageToString (st.storage));
+        obj->setProperty ("sampleFormat", CompactStorage::formatToString (st.sampleFormat));
+        obj->setProperty ("underruns", st.underruns);
+        obj->setProperty ("outputBus", st.outputBus);
+        obj->setProperty ("velocityCurve", ZoneMap::curveToString (st.velocityCurve));
+        obj->setProperty ("attackMs", st.envelope.attackMs);
+        obj->setProperty ("decayMs", st.envelope.decayMs);
+        obj->setProperty ("sustain", st.envelope.sustain);
+        obj->setProperty ("releaseMs", st.envelope.releaseMs);
+        obj->setProperty ("envelopeCurve", SamplePlayer::envelopeCurveToString (st.envelope.curve));
+        obj->setProperty ("oneShot", st.envelope.oneShot);
+        obj->setProperty ("loopEnabled", st.loop.enabled);
+        obj->setProperty ("loopStart", st.loop.start);
+        obj->setProperty ("loopEnd", st.loop.end);
+        obj->setProperty ("loopCrossfade", st.loop.crossfade);
+        obj->setProperty ("isPlaying", st.isPlaying);
+        obj->setProperty ("status", st.status);
+        obj->setProperty ("fileName", st.fileName);
+        obj->setProperty ("filePath", st.filePath);
+        obj->setProperty ("waveformSVG", st.waveformSVG);
+
+        juce::Array<juce::var> zones;
+        for (const auto& z : st.zones)
+        {
+            juce::DynamicObject::Ptr zoneObj = new juce::DynamicObject();
+            zoneObj->setProperty ("id", z.id);
+            zoneObj->setProperty ("keyLow", z.zone.keyLow);
+            zoneObj->setProperty ("keyHigh", z.zone.keyHigh);
+            zoneObj->setProperty ("velocityLow", z.zone.velocityLow);
+            zoneObj->setProperty ("velocityHigh", z.zone.velocityHigh);
+            zoneObj->setProperty ("roundRobin", z.zone.roundRobin);
+            zoneObj->setProperty ("rootKey", z.zone.rootKey);
+            zoneObj->setProperty ("status", z.status);
+            zoneObj->setProperty ("fileName", z.fileName);
+            zoneObj->setProperty ("filePath", z.filePath);
+            zones.add (juce::var (zoneObj));
+        }
+        obj->setProperty ("zones", juce::var (zones));
+
+        arr.add (juce::var (obj));
+    }
+
+    juce::DynamicObject::Ptr root = new juce::DynamicObject();
+    root->setProperty ("players", juce::var (arr));
+    root->setProperty ("count", (int) players.size());
+    root->setProperty ("outputBuses", maxOutputBuses);
+
+    const auto poolStats = samplePool->getStats();
+    root->setProperty ("pooledSamples", poolStats.entries);
+    root->setProperty ("pooledBytes", poolStats.bytesInMemory);
+    root->setProperty ("renderThreads", renderWorkers.getNumWorkers());
+    root->setProperty ("droppedEvents", blockEvents.getNumDropped());
+    root->setProperty ("loads", loadProgressToVar());
+    root->setProperty ("truePeakMetering", getTruePeakMetering());
+    return juce::var (root);
+}
+
+void SamplerEngine::loadSampleAsync (int playerId, const juce::File& file, std::function<void (bool, juce::String)> onComplete)
+{
+    loadZoneAsync (playerId, 0, file, std::move (onComplete));
+}
+
+bool SamplerEngine::addZoneAsync (int playerId, const juce::File& file, const Zone& zone, std::function<void (bool, juce::String)> onComplete)
+{
+    int zoneId = -1;
+    {
+        const std::lock_guard<std::mutex> lock (playerMutex);
+        if (auto* player = getPlayer (playerId))
+            zoneId = player->addZone (zone);
+
+        if (zoneId < 0)
+            return false;
+
+        getPlayer (playerId)->setFilePathAndStatus (zoneId, file.getFullPathName(), "loading");
+    }
+
+    loadZoneAsync (playerId, zoneId, file, std::move (onComplete));
+    return true;
+}
+
+void SamplerEngine::loadZoneAsync (int playerId, int zoneId, const juce::File& file, std::function<void (bool, juce::String)> onComplete,
+                                   int priority)
+{
+    const std::lock_guard<std::mutex> lock (playerMutex);
+
+    // a newer load replaces any still pending for the zone
+    cancelLoads (playerId, zoneId);
+    auto& load = zoneLoads[{ playerId, zoneId }];
+    load.generation = nextLoadGeneration++;
+    load.path = file.getFullPathName();
+
+    load.job = loaders.add (priority, [this, playerId, zoneId, file, generation = load.generation,
+                                           cb = std::move (onComplete)] (LoaderPool::Job& job) mutable
+    {
+        juce::String error;
+        const bool ok = loadZoneInternal (playerId, zoneId, file, error, &job, generation);
+
+        {
+            const std::lock_guard<std::mutex> resultLock (playerMutex);
+
+            // whoever superseded or cancelled this load reports instead
+            if (! isCurrentLoad (playerId, zoneId, generation))
+                return;
+
+            zoneLoads.erase ({ playerId, zoneId });
+
+            // a zone that never loaded shows the error; a loaded one keeps playing its old file
+            if (! ok)
+                if (auto* player = getPlayer (playerId); player != nullptr && player->getZoneSource (zoneId) == nullptr)
+                    player->markError (zoneId, file.getFullPathName(), error);
+        }
+
+        if (cb != nullptr)
+        {
+            juce::MessageManager::callAsync ([cb = std::move (cb), ok, error]() mutable
+            {
+                cb (ok, error);
+            });
+        }
+    });
+}
+
+int SamplerEngine::getRestorePriority (const SamplePlayer::State& player, const Zone& zone)
+{
+    // Without a history of what gets played, notes around middle C are the
+    // best guess for the first ones, so zones reaching it load first. The
+    // first round-robin step goes ahead of the steps behind it.
+    const int low = juce::jmax (zone.keyLow, player.midiLow);
+    const int high = juce::jmin (zone.keyHigh, player.midiHigh);
+    const int middleC = 60;
+    const int distance = low > high ? 127 : (middleC < low ? low - middleC : juce::jmax (0, middleC - high));
+
+    return restorePriority + (127 - distance) * 2 + (zone.roundRobin == 0 ? 1 : 0);
+}
+
+void SamplerEngine::cancelLoads (int playerId, int zoneId)
+{
+    for (auto it = zoneLoads.begin(); it != zoneLoads.end();)
+    {
+        if ((playerId < 0 || it->first.first == playerId) && (zoneId < 0 || it->first.second == zoneId))
+        {
+            it->second.job->cancel();
+            it = zoneLoads.erase (it);
+        }
+        else
+        {
+            ++it;
+        }
+    }
+}
+
+bool SamplerEngine::isCurrentLoad (int playerId, int zoneId, uint64 generation) const
+{
+    const auto it = zoneLoads.find ({ playerId, zoneId });
+    return it != zoneLoads.end() && it->second.generation == generation;
+}
+
+bool SamplerEngine::cancelLoad (int playerId, int zoneId)
+{
+    const std::lock_guard<std::mutex> lock (playerMutex);
+    const auto it = zoneLoads.find ({ playerId, zoneId });
+    if (it == zoneLoads.end())
+        return false;
+
+    const auto path = it->second.path;
+    cancelLoads (playerId, zoneId);
+
+    // a zone playing the head of this load loses it too
+    if (auto* player = getPlayer (playerId))
+    {
+        const auto source = player->getZoneSource (zoneId);
+        if (source != nullptr && ! source->isLoaded())
+        {
+            player->setZoneSource (zoneId, nullptr);
+            updatePlaybackData (*player);
+        }
+
+        if (player->getZoneSource (zoneId) == nullptr)
+            player->markError (zoneId, path, "Cancelled");
+    }
+    return true;
+}
+
+juce::var SamplerEngine::getLoadProgress() const
+{
+    const std::lock_guard<std::mutex> lock (playerMutex);
+    return loadProgressToVar();
+}
+
+juce::var SamplerEngine::loadProgressToVar() const
+{
+    juce::Array<juce::var> loads;
+
+    for (const auto& [key, load] : zoneLoads)
+    {
+        juce::DynamicObject::Ptr obj = new juce::DynamicObject();
+        obj->setProperty ("player", key.first);
+        obj->setProperty ("zone", key.second);
+        obj->setProperty ("file", load.path);
+        obj->setProperty ("state", load.job->hasStarted() ? "running" : "queued");
+        obj->setProperty ("bytesDecoded", load.job->getBytesDone());
+        obj->setProperty ("totalBytes", load.job->getTotalBytes());
+        obj->setProperty ("elapsedMs", juce::roundToInt (load.job->getElapsedMs()));
+        loads.add (juce::var (obj));
+    }
+
+    return juce::var (loads);
+}
+
+bool SamplerEngine::loadZoneInternal (int playerId, int zoneId, const juce::File& file, juce::String& error,
+                                      LoaderPool::Job* job, uint64 generation)
+{
+    if (! file.existsAsFile())
+    {
+        error = "File not found";
+        return false;
+    }
+
+    auto storage = SamplePlayer::Storage::memory;
+    auto format = CompactStorage::Format::float32;
+    bool progressive = false;
+    {
+        const std::lock_guard<std::mutex> lock (playerMutex);
+        if (auto* player = getPlayer (playerId))
+        {
+            const auto st = player->getState();
+            storage = st.storage;
+            format = st.sampleFormat;
+
+            // a zone that plays another file keeps it until this one is complete
+            const auto current = player->getZoneSource (zoneId);
+            progressive = generation != 0 && (current == nullptr || ! current->isLoaded());
+        }
+    }
+
+    // the head of a progressive load, while the zone plays it
+    SampleDataPtr head;
+
+    const auto publishHead = [&] (SampleDataPtr data)
+    {
+        if (data->isStreaming())
+            streamer.prepare();
+
+        const std::lock_guard<std::mutex> lock (playerMutex);
+        auto* player = getPlayer (playerId);
+        if (player == nullptr || ! player->hasZone (zoneId) || ! isCurrentLoad (playerId, zoneId, generation))
+            return;
+
+        // until the rest is in, voices read silence past the decoded frames
+        // and the zone plays at the file's own rate
+        head = std::move (data);
+        player->setZoneSource (zoneId, head);
+        if (zoneId == 0)
+            player->resetUnderruns();
+        updatePlaybackData (*player);
+    };
+
+    const auto dropHead = [&]
+    {
+        if (head == nullptr)
+            return;
+
+        const std::lock_guard<std::mutex> lock (playerMutex);
+        if (auto* player = getPlayer (playerId); player != nullptr && player->getZoneSource (zoneId) == head)
+        {
+            player->setZoneSource (zoneId, nullptr);
+            updatePlaybackData (*player);
+        }
+    };
+
+    // other players and plugin instances may already hold this file
+    const auto key = SamplePool::makeKey (file, SamplePlayer::storageToString (storage) + "/"
+                                                    + CompactStorage::formatToString (format));
+    auto source = samplePool->getOrCreate (key, [&]
+    {
+        return decodeSampleFile (file, storage, format, key, error, job,
+                                 progressive ? std::function<void (SampleDataPtr)> (publishHead) : nullptr);
+    });
+
+    if (job != nullptr && job->isCancelled())
+    {
+        dropHead();
+        error = "Cancelled";
+        return false;
+    }
+
+    if (source == nullptr)
+    {
+        dropHead();
+        return false;
+    }
+
+    // the pool may hand over a streamed sample another instance decoded
+    if (source->isStreaming())
+        streamer.prepare();
+
+    // convert to the host rate here, on the loader thread
+    const double hostRate = currentSampleRate.load();
+    SampleDataPtr playback = source;
+    if (source->isDecoded() && OfflineResampler::needsConversion (source->sampleRate, hostRate))
+        playback = samplePool->getOrCreate (SamplePool::makeRateKey (key, hostRate),
+                                            [&] { return getConvertedData (*source, hostRate); });
+
+    const std::lock_guard<std::mutex> lock (playerMutex);
+    if (generation != 0 && ! isCurrentLoad (playerId, zoneId, generation))
+    {
+        error = "Cancelled";
+        return false;
+    }
+
+    if (auto* player = getPlayer (playerId))
+    {
+        if (! player->hasZone (zoneId))
+        {
+            error = "Zone not found";
+            return false;
+        }
+
+        player->setFilePathAndStatus (zoneId, file.getFullPathName(), "loading", file.getFileName());
+        player->setLoadedState (zoneId, file.getFileName(), source->waveformSVG);
+        player->setZoneSource (zoneId, source);
+        if (playback != source)
+            player->cacheZoneData (zoneId, hostRate, playback);
+        // underruns while the head played are kept
+        if (zoneId == 0 && head == nullptr)
+            player->resetUnderruns();
+
+        // if the host rate moved while decoding this starts another conversion
+        if (updatePlaybackData (*player))
+            return true;
+
+        error = "Audio engine busy";
+        return false;
+    }
+
+    error = "Player not found";
+    return false;
+}
+
+SampleDataPtr SamplerEngine::decodeSampleFile (const juce::File& file, SamplePlayer::Storage storage,
+                                               CompactStorage::Format format, const juce::String& poolKey,
+                                               juce::String& error, LoaderPool::Job* job,
+                                               const std::function<void (SampleDataPtr)>& onHeadReady)
+{
+    // Decoding a compressed file is slow enough to keep the result on disk;
+    // PCM files read about as fast as an entry would.
+    auto* fileFormat = formatManager.findFormatForFileExtension (file.getFileExtension());
+    const bool pcmFile = dynamic_cast<juce::WavAudioFormat*> (fileFormat) != nullptr
+                      || dynamic_cast<juce::AiffAudioFormat*> (fileFormat) != nullptr;
+    const bool cacheable = storage == SamplePlayer::Storage::memory && ! pcmFile;
+
+    if (cacheable)
+        if (auto cached = decodedCache->load (poolKey, 0.0))
+            return cached;
+
+    std::unique_ptr<juce::AudioFormatReader> reader (formatManager.createReaderFor (file));
+
+    if (reader == nullptr)
+    {
+        error = "Unsupported file format";
+        return nullptr;
+    }
+
+    const int64 totalSamples = reader->lengthInSamples;
+    const int numChannels = (int) juce::jmin ((int64) reader->numChannels, (int64) 2);
+
+    if (totalSamples <= 0 || numChannels <= 0)
+    {
+        error = "Empty or invalid audio file";
+        return nullptr;
+    }
+
+    // an AudioBuffer cannot hold more than INT_MAX frames
+    const bool tooLongToDecode = totalSamples > (int64) std::numeric_limits<int>::max();
+    const bool streaming = storage == SamplePlayer::Storage::stream || tooLongToDecode;
+
+    // compressed or unusual files cannot be mapped and are loaded as usual
+    std::shared_ptr<SampleData> data;
+    if (storage == SamplePlayer::Storage::mapped)
+        data = mapSampleFile (file, *reader);
+
+    const bool mapped = data != nullptr;
+    if (! mapped)
+        data = std::make_shared<SampleData>();
+
+    // all set before any frames are, as a progressive load hands the data out early
+    data->sampleRate = reader->sampleRate;
+    data->lengthInSamples = totalSamples;
+    data->poolKey = poolKey;
+
+    // JUCE exposes a WAV smpl chunk as metadata; its loop end is inclusive
+    const auto& metadata = reader->metadataValues;
+    if (metadata.getValue ("NumSampleLoops", "0").getIntValue() > 0)
+    {
+        data->fileLoopStart = metadata.getValue ("Loop0Start", "0").getLargeIntValue();
+        data->fileLoopEnd = juce::jmin (totalSamples, metadata.getValue ("Loop0End", "-1").getLargeIntValue() + 1);
+    }
 
-    for (const auto meta : midi)
+    if (mapped)
     {
-        const auto msg = meta.getMessage();
-        if (msg.isNoteOn())
+        // a sparse scan keeps the load time independent of the file length
+        data->waveformSVG = WaveformSVGRenderer::generateWaveformSVG (*reader, 320, 520.0f, 120.0f, 2048);
+    }
+    else if (streaming && totalSamples > DiskStreamer::headFrames)
+    {
+        data->buffer.setSize (numChannels, DiskStreamer::headFrames);
+        if (! readAudio (*reader, *data, DiskStreamer::headFrames, job))
         {
-            auto pos = juce::jlimit (0, numSamples - 1, meta.samplePosition);
-            noteOns[(size_t) pos].push_back (msg.getNoteNumber());
+            error = "Cancelled";
+            return nullptr;
         }
+        data->waveformSVG = WaveformSVGRenderer::generateWaveformSVG (*reader, 320);
+        data->stream = std::make_shared<StreamSource> (std::move (reader), numChannels);
     }
+    else
+    {
+        // Decoded straight into the storage it plays from, so the opening
+        // can sound while the rest is still being decoded.
+        if (format == CompactStorage::Format::float32)
+        {
+            data->buffer.setSize (numChannels, (int) totalSamples);
+        }
+        else
+        {
+            data->packed.resize ((size_t) numChannels * (size_t) totalSamples);
+            data->packedFrames = data->packed.data();
+            data->packedChannels = numChannels;
+            data->packedFormat = format;
+        }
 
-    const std::lock_guard<std::mutex> lock (playerMutex);
-
-    for (auto& player : players)
-        player->beginBlock();
-
-    buffer.clear();
-    const int numChannels = buffer.getNumChannels();
+        const auto headReady = [&]
+        {
+            if (onHeadReady != nullptr)
+                onHeadReady (data);
+        };
 
-    for (int sample = 0; sample < numSamples; ++sample)
-    {
-        // trigger any note-ons scheduled for this sample
-        if (! noteOns[(size_t) sample].empty())
+        // long compressed files are split between idle loader threads
+        bool decoded = false;
+        if (ParallelDecoder::canSplit (fileFormat, totalSamples))
         {
-            for (int note : noteOns[(size_t) sample])
+            const auto openReader = [this, file]
             {
-                for (auto& player : players)
-                {
-                    if (player->acceptsNote (note))
-                        player->triggerNote (note);
-                }
-            }
+                return std::unique_ptr<juce::AudioFormatReader> (formatManager.createReaderFor (file));
+            };
+
+            decoded = ParallelDecoder::decode (*reader, openReader, *data, (int) totalSamples,
+                                               getProgressiveHeadFrames (*reader, (int) totalSamples),
+                                               loaders, decodeHelperPriority, job, headReady);
+        }
+        else
+        {
+            decoded = readAudio (*reader, *data, (int) totalSamples, job, headReady);
         }
 
-        // mix current sample from all players
-        for (int ch = 0; ch < numChannels; ++ch)
+        if (! decoded)
         {
-            float acc = 0.0f;
-            for (auto& player : players)
-                acc += player->getNextSampleForChannel (ch);
+            error = "Cancelled";
+            return nullptr;
+        }
 
-            buffer.addSample (ch, sample, acc);
+        if (data->isPacked())
+        {
+            juce::AudioBuffer<float> unpacked;
+            unpackSampleData (*data, unpacked);
+            data->waveformSVG = WaveformSVGRenderer::generateWaveformSVG (unpacked, 320);
+        }
+        else
+        {
+            data->waveformSVG = WaveformSVGRenderer::generateWaveformSVG (data->buffer, 320);
         }
     }
-    for (auto& player : players)
-        player->endBlock();
 
-    std::ostringstream vuBuilder;
-    vuBuilder.setf (std::ios::fixed);
-    vuBuilder.precision (2);
-    vuBuilder << "{\"dB_out\":[";
-    for (size_t i = 0; i < players.size(); ++i)
-    {
-        if (i > 0)
-            vuBuilder << ',';
-        vuBuilder << players[i]->getLastVuDb();
-    }
-    vuBuilder << "]}";
+    if (cacheable)
+        storeInCache (poolKey, 0.0, data);
+
+    return data;
+}
+
+bool SamplerEngine::readAudio (juce::AudioFormatReader& reader, SampleData& data, int numFrames,
+                               LoaderPool::Job* job, const std::function<void()>& onHeadReady)
+{
+    // In pieces, so progress moves steadily and a cancelled load stops early.
+    // The first piece is just the head, handed out before the rest is read.
+    constexpr int framesPerRead = ParallelDecoder::framesPerRead;
+    const int headFrames = getProgressiveHeadFrames (reader, numFrames);
+    const int numChannels = data.isPacked() ? data.packedChannels : data.buffer.getNumChannels();
+    const int64 bytesPerFrame = (int64) numChannels * (int64) sizeof (float);
+
+    // packed frames are decoded a piece at a time and encoded from here
+    juce::AudioBuffer<float> piece;
+    if (data.isPacked())
+        piece.setSize (numChannels, juce::jmax (framesPerRead, headFrames));
+
+    data.framesLoaded.store (0, std::memory_order_release);
+
+    if (job != nullptr)
+        job->setTotalBytes ((int64) numFrames * bytesPerFrame);
+
+    for (int pos = 0; pos < numFrames;)
     {
-        const juce::SpinLock::ScopedLockType guard (vuLock);
-        vuJson = vuBuilder.str();
+        if (job != nullptr && job->isCancelled())
+            return false;
+
+        const int num = juce::jmin (pos == 0 ? headFrames : framesPerRead, numFrames - pos);
+        ParallelDecoder::readPiece (reader, data, pos, num, piece);
+        pos += num;
+        data.framesLoaded.store (pos, std::memory_order_release);
+
+        if (job != nullptr)
+            job->addBytesDone ((int64) num * bytesPerFrame);
+
+        // a file that fits in the head is simply finished
+        if (pos == headFrames && pos < numFrames && onHeadReady != nullptr)
+            onHeadReady();
     }
+
+    return true;
 }
 
-juce::var SamplerEngine::toVar() const
+std::shared_ptr<SampleData> SamplerEngine::mapSampleFile (const juce::File& file, juce::AudioFormatReader& decoder)
 {
-    const std::lock_guard<std::mutex> lock (playerMutex);
-    juce::Array<juce::var> arr;
+    auto* format = formatManager.findFormatForFileExtension (file.getFileExtension());
+    const bool littleEndian = dynamic_cast<juce::WavAudioFormat*> (format) != nullptr;
+    if (! littleEndian && dynamic_cast<juce::AiffAudioFormat*> (format) == nullptr)
+        return nullptr;
 
-    for (const auto& player : players)
+    // WAV data is little-endian and AIFF big-endian; the rare little-endian
+    // AIFC variant fails the check against the decoder below and is loaded as usual
+    PcmDecoder::Format pcm;
+    if (! PcmDecoder::describe (decoder, littleEndian, pcm))
+        return nullptr;
+
+    // the data chunk must hold every frame the decoder reports at its frame size
+    auto mapping = std::make_shared<juce::MemoryMappedFile> (file, juce::MemoryMappedFile::readOnly);
+    int64 dataOffset = 0, dataBytes = 0;
+
+    if (mapping->getData() == nullptr
+        || ! PcmDecoder::findSampleData (mapping->getData(), (int64) mapping->getSize(), littleEndian, dataOffset, dataBytes)
+        || dataBytes / pcm.bytesPerFrame < decoder.lengthInSamples)
+        return nullptr;
+
+    auto data = std::make_shared<SampleData>();
+    data->sampleRate = decoder.sampleRate;
+    data->lengthInSamples = decoder.lengthInSamples;
+    data->mappedFrames = static_cast<const char*> (mapping->getData()) + dataOffset;
+    data->mappedFormat = pcm;
+    data->mapping = mapping;
+
+    // check the opening frames against the regular decoder before trusting the layout
+    const int numToCheck = (int) juce::jmin ((int64) 4096, data->lengthInSamples);
+    juce::AudioBuffer<float> expected (data->getNumChannels(), numToCheck);
+    std::vector<float> converted ((size_t) numToCheck);
+    decoder.read (&expected, 0, numToCheck, 0, true, true);
+
+    for (int ch = 0; ch < data->getNumChannels(); ++ch)
     {
-        auto st = player->getState();
-        juce::DynamicObject::Ptr obj = new juce::DynamicObject();
-        obj->setProperty ("id", st.id);
-        obj->setProperty ("midiLow", st.midiLow);
-        obj->setProperty ("midiHigh", st.midiHigh);
-        obj->setProperty ("gain", st.gain);
-        obj->setProperty ("isPlaying", st.isPlaying);
-        obj->setProperty ("status", st.status);
-        obj->setProperty ("fileName", st.fileName);
-        obj->setProperty ("filePath", st.filePath);
-        obj->setProperty ("waveformSVG", st.waveformSVG);
-        arr.add (juce::var (obj));
+        PcmDecoder::decode (pcm, data->mappedFrames, ch, converted.data(), numToCheck);
+
+        for (int i = 0; i < numToCheck; ++i)
+            if (std::abs (converted[(size_t) i] - expected.getSample (ch, i)) > 1.0e-6f)
+                return nullptr;
     }
 
-    juce::DynamicObject::Ptr root = new juce::DynamicObject();
-    root->setProperty ("players", juce::var (arr));
-    root->setProperty ("count", (int) players.size());
-    return juce::var (root);
+    // Fault in the opening pages so the first notes do not wait on the disk.
+    // Later pages come from the page cache, shared with other instances.
+    const auto* bytes = static_cast<const volatile uint8*> (data->mappedFrames);
+    const int64 headBytes = juce::jmin (data->lengthInSamples, (int64) DiskStreamer::headFrames) * pcm.bytesPerFrame;
+    uint8 touched = 0;
+    for (int64 offset = 0; offset < headBytes; offset += 4096)
+        touched ^= bytes[offset];
+    juce::ignoreUnused (touched);
+
+    return data;
 }
 
-void SamplerEngine::loadSampleAsync (int playerId, const juce::File& file, std::function<void (bool, juce::String)> onComplete)
+SampleDataPtr SamplerEngine::getConvertedData (const SampleData& source, double targetRate)
 {
-    // simple background task; avoids blocking audio thread or message thread
-    std::thread ([this, playerId, file, cb = std::move (onComplete)]() mutable
-    {
-        juce::String error;
-        const bool ok = loadSampleInternal (playerId, file, error);
+    // resampling a long file costs about as much as decoding it
+    if (auto cached = decodedCache->load (source.poolKey, targetRate))
+        return cached;
 
-        if (cb != nullptr)
-        {
-            juce::MessageManager::callAsync ([cb = std::move (cb), ok, error]() mutable
-            {
-                cb (ok, error);
-            });
-        }
-    }).detach();
+    auto converted = convertSampleData (source, targetRate);
+    storeInCache (source.poolKey, targetRate, converted);
+    return converted;
 }
 
-bool SamplerEngine::loadSampleInternal (int playerId, const juce::File& file, juce::String& error)
+void SamplerEngine::storeInCache (const juce::String& poolKey, double sampleRate, SampleDataPtr data)
 {
-    if (! file.existsAsFile())
+    // holds the data until written; dropped unwritten if the engine goes first
+    loaders.add (cacheStorePriority, [this, poolKey, sampleRate, data = std::move (data)] (LoaderPool::Job&)
     {
-        error = "File not found";
-        return false;
-    }
+        decodedCache->store (poolKey, sampleRate, *data);
+    });
+}
 
-    std::unique_ptr<juce::AudioFormatReader> reader (formatManager.createReaderFor (file));
+SampleDataPtr SamplerEngine::convertSampleData (const SampleData& source, double targetRate)
+{
+    auto converted = std::make_shared<SampleData>();
 
-    if (reader == nullptr)
-    {
-        error = "Unsupported file format";
-        return false;
-    }
+    // packed samples are widened for the resampler and packed again after;
+    // a cache entry's frames are copied into a buffer for it
+    const bool inBuffer = ! source.isPacked() && source.floatFrames == nullptr;
+    juce::AudioBuffer<float> unpacked;
+    if (! inBuffer)
+        unpackSampleData (source, unpacked);
 
-    const int64 totalSamples = reader->lengthInSamples;
-    const int numChannels = (int) juce::jmin ((int64) reader->numChannels, (int64) 2);
+    if (auto resampled = OfflineResampler::resample (inBuffer ? source.buffer : unpacked, source.sampleRate, targetRate))
+        converted->buffer = std::move (*resampled);
+    converted->sampleRate = targetRate;
+    converted->lengthInSamples = converted->buffer.getNumSamples();
 
-    if (totalSamples <= 0 || numChannels <= 0)
-    {
-        error = "Empty or invalid audio file";
-        return false;
-    }
+    if (source.isPacked())
+        packSampleData (*converted, source.packedFormat);
 
-    juce::AudioBuffer<float> tempBuffer (numChannels, (int) totalSamples);
-    reader->read (&tempBuffer, 0, (int) totalSamples, 0, true, true);
+    return converted;
+}
 
-    const std::lock_guard<std::mutex> lock (playerMutex);
-    if (auto* player = getPlayer (playerId))
+void SamplerEngine::packSampleData (SampleData& data, CompactStorage::Format format)
+{
+    const int numChannels = data.buffer.getNumChannels();
+    const int numSamples = data.buffer.getNumSamples();
+
+    if (format == CompactStorage::Format::float32 || numSamples == 0)
+        return;
+
+    data.packed.resize ((size_t) numChannels * (size_t) numSamples);
+    data.packedFrames = data.packed.data();
+    data.packedChannels = numChannels;
+    data.packedFormat = format;
+
+    for (int ch = 0; ch < numChannels; ++ch)
+        CompactStorage::encode (format, data.buffer.getReadPointer (ch),
+                                data.packed.data() + (size_t) ch * (size_t) numSamples, numSamples);
+
+    data.buffer.setSize (0, 0);
+}
+
+int SamplerEngine::getProgressiveHeadFrames (const juce::AudioFormatReader& reader, int numFrames)
+{
+    return juce::jlimit (1, numFrames, (int) std::ceil (reader.sampleRate * progressiveHeadSeconds));
+}
+
+void SamplerEngine::unpackSampleData (const SampleData& data, juce::AudioBuffer<float>& dest)
+{
+    dest.setSize (data.getNumChannels(), (int) data.lengthInSamples);
+    for (int ch = 0; ch < dest.getNumChannels(); ++ch)
+        data.readFrames (ch, 0, dest.getNumSamples(), dest.getWritePointer (ch));
+}
+
+bool SamplerEngine::updatePlaybackData (SamplePlayer& player)
+{
+    const double hostRate = currentSampleRate.load();
+    std::vector<std::pair<int, SampleDataPtr>> needsConversion;
+    auto zones = player.buildZoneMap (hostRate, needsConversion);
+
+    // Until a conversion lands its zone plays the file at its own rate, which
+    // the voices resample on the fly; the finished buffer is swapped in under
+    // the sounding voices.
+    for (auto& [zoneId, source] : needsConversion)
     {
-        player->setFilePathAndStatus (file.getFullPathName(), "loading", file.getFileName());
-        player->setLoadedBuffer (std::move (tempBuffer), file.getFileName());
-        return true;
+        loaders.add (conversionPriority, [this, playerId = player.getId(), zoneId = zoneId, source = source, hostRate] (LoaderPool::Job&)
+        {
+            auto converted = samplePool->getOrCreate (SamplePool::makeRateKey (source->poolKey, hostRate),
+                                                      [&] { return getConvertedData (*source, hostRate); });
+
+            const std::lock_guard<std::mutex> lock (playerMutex);
+            auto* p = getPlayer (playerId);
+
+            // drop the result if the zone was reloaded or removed meanwhile
+            if (p == nullptr || p->getZoneSource (zoneId) != source)
+                return;
+
+            p->cacheZoneData (zoneId, hostRate, converted);
+
+            // rates are keyed as whole hertz, as in the pool and the player
+            if (juce::roundToInt (hostRate) == juce::roundToInt (currentSampleRate.load()))
+                updatePlaybackData (*p);
+        });
     }
 
-    error = "Player not found";
-    return false;
+    return pushZoneMap (player.getId(), std::move (zones));
+}
+
+bool SamplerEngine::pushZoneMap (int playerId, ZoneMapPtr zones)
+{
+    Command cmd;
+    cmd.type = Command::Type::setZoneMap;
+    cmd.playerId = playerId;
+    cmd.zones = std::move (zones);
+    return pushCommand (std::move (cmd));
 }
 
 SamplePlayer* SamplerEngine::getPlayer (int playerId) const
@@ -186,7 +1228,18 @@ bool SamplerEngine::setMidiRange (int playerId, int low, int high)
     if (auto* player = getPlayer (playerId))
     {
         player->setMidiRange (low, high);
-        return true;
+        return publishPlayers();
+    }
+    return false;
+}
+
+bool SamplerEngine::setMidiChannel (int playerId, int channel)
+{
+    const std::lock_guard<std::mutex> lock (playerMutex);
+    if (auto* player = getPlayer (playerId))
+    {
+        player->setMidiChannel (channel);
+        return publishPlayers();
     }
     return false;
 }
@@ -197,18 +1250,179 @@ bool SamplerEngine::setGain (int playerId, float gain)
     if (auto* player = getPlayer (playerId))
     {
         player->setGain (gain);
-        return true;
+
+        Command cmd;
+        cmd.type = Command::Type::setGain;
+        cmd.playerId = playerId;
+        cmd.gain = player->getState().gain;
+        return pushCommand (std::move (cmd));
     }
     return false;
 }
 
-bool SamplerEngine::trigger (int playerId)
+bool SamplerEngine::setVoiceSettings (int playerId, int polyphony, const juce::String& stealPolicy)
 {
     const std::lock_guard<std::mutex> lock (playerMutex);
     if (auto* player = getPlayer (playerId))
     {
-        player->trigger();
-        return true;
+        player->setVoiceSettings (polyphony, SamplePlayer::stealPolicyFromString (stealPolicy));
+
+        const auto st = player->getState();
+        Command cmd;
+        cmd.type = Command::Type::setVoiceSettings;
+        cmd.playerId = playerId;
+        cmd.polyphony = st.polyphony;
+        cmd.stealPolicy = st.stealPolicy;
+        return pushCommand (std::move (cmd));
+    }
+    return false;
+}
+
+bool SamplerEngine::setPitchSettings (int playerId, int rootKey, const juce::String& interpolation)
+{
+    const std::lock_guard<std::mutex> lock (playerMutex);
+    if (auto* player = getPlayer (playerId))
+    {
+        player->setPitchSettings (rootKey, Interpolator::modeFromString (interpolation));
+
+        const auto st = player->getState();
+        Command cmd;
+        cmd.type = Command::Type::setPitchSettings;
+        cmd.playerId = playerId;
+        cmd.rootKey = st.rootKey;
+        cmd.interpolation = st.interpolation;
+        return pushCommand (std::move (cmd));
+    }
+    return false;
+}
+
+bool SamplerEngine::setEnvelope (int playerId, const SamplePlayer::Envelope& envelope)
+{
+    const std::lock_guard<std::mutex> lock (playerMutex);
+    if (auto* player = getPlayer (playerId))
+    {
+        player->setEnvelope (envelope);
+
+        Command cmd;
+        cmd.type = Command::Type::setEnvelope;
+        cmd.playerId = playerId;
+        cmd.envelope = player->getState().envelope;
+        return pushCommand (std::move (cmd));
+    }
+    return false;
+}
+
+bool SamplerEngine::setLoop (int playerId, const SamplePlayer::Loop& loop)
+{
+    const std::lock_guard<std::mutex> lock (playerMutex);
+    auto* player = getPlayer (playerId);
+    if (player == nullptr)
+        return false;
+
+    // seams are baked with the new zone map
+    player->setLoop (loop);
+    return updatePlaybackData (*player);
+}
+
+bool SamplerEngine::setStorage (int playerId, const juce::String& storageName, const juce::String& formatName,
+                                std::function<void (bool, juce::String)> onComplete)
+{
+    std::vector<SamplePlayer::ZoneState> reload;
+    {
+        const std::lock_guard<std::mutex> lock (playerMutex);
+        auto* player = getPlayer (playerId);
+        if (player == nullptr)
+            return false;
+
+        // an empty name keeps the current setting
+        const auto st = player->getState();
+        const auto storage = storageName.isNotEmpty() ? SamplePlayer::storageFromString (storageName) : st.storage;
+        const auto format = formatName.isNotEmpty() ? CompactStorage::formatFromString (formatName) : st.sampleFormat;
+        player->setStorage (storage);
+        player->setSampleFormat (format);
+
+        if (st.storage != storage || st.sampleFormat != format)
+            for (const auto& z : st.zones)
+                if (z.status == "loaded")
+                    reload.push_back (z);
+    }
+
+    // the sample data differs between modes, so loaded files are read again;
+    // onComplete runs once per zone
+    for (const auto& z : reload)
+        loadZoneAsync (playerId, z.id, juce::File (z.filePath), onComplete);
+
+    if (reload.empty() && onComplete != nullptr)
+        juce::MessageManager::callAsync ([cb = std::move (onComplete)] { cb (true, {}); });
+
+    return true;
+}
+
+bool SamplerEngine::setZone (int playerId, int zoneId, const Zone& zone)
+{
+    const std::lock_guard<std::mutex> lock (playerMutex);
+    auto* player = getPlayer (playerId);
+    if (player == nullptr || ! player->setZone (zoneId, zone))
+        return false;
+
+    return updatePlaybackData (*player);
+}
+
+bool SamplerEngine::removeZone (int playerId, int zoneId)
+{
+    const std::lock_guard<std::mutex> lock (playerMutex);
+    auto* player = getPlayer (playerId);
+    if (player == nullptr || ! player->removeZone (zoneId))
+        return false;
+
+    cancelLoads (playerId, zoneId);
+    return updatePlaybackData (*player);
+}
+
+bool SamplerEngine::setVelocityCurve (int playerId, const juce::String& curve)
+{
+    const std::lock_guard<std::mutex> lock (playerMutex);
+    auto* player = getPlayer (playerId);
+    if (player == nullptr)
+        return false;
+
+    // the gain table is part of the zone map
+    player->setVelocityCurve (ZoneMap::curveFromString (curve));
+    return updatePlaybackData (*player);
+}
+
+bool SamplerEngine::setOutputBus (int playerId, int bus)
+{
+    const std::lock_guard<std::mutex> lock (playerMutex);
+    if (auto* player = getPlayer (playerId))
+    {
+        player->setOutputBus (bus);
+
+        Command cmd;
+        cmd.type = Command::Type::setOutputBus;
+        cmd.playerId = playerId;
+        cmd.outputBus = player->getState().outputBus;
+        return pushCommand (std::move (cmd));
+    }
+    return false;
+}
+
+void SamplerEngine::setRenderThreads (int numThreads)
+{
+    // serialised with prepareToPlay, which resizes the workers' scratch
+    const std::lock_guard<std::mutex> lock (playerMutex);
+    renderWorkers.setNumWorkers (numThreads, currentBlockSize.load(), currentSampleRate.load());
+}
+
+bool SamplerEngine::trigger (int playerId)
+{
+    const std::lock_guard<std::mutex> lock (playerMutex);
+    if (getPlayer (playerId) != nullptr)
+    {
+        Command cmd;
+        cmd.type = Command::Type::trigger;
+        cmd.playerId = playerId;
+        return pushCommand (std::move (cmd));
     }
     return false;
 }
@@ -222,10 +1436,26 @@ juce::String SamplerEngine::getWaveformSVG (int playerId) const
     return WaveformSVGRenderer::generateBlankWaveformSVG();
 }
 
-std::shared_ptr<std::string> SamplerEngine::getVuJson() const
+std::string SamplerEngine::getVuJson() const
 {
-    const juce::SpinLock::ScopedLockType guard (vuLock);
-    return std::make_shared<std::string>(vuJson);
+    // Encoded here on the caller's thread from each player's meter snapshot;
+    // the audio thread only ever stores floats. Players come in toVar order.
+    std::ostringstream vuBuilder;
+    vuBuilder.setf (std::ios::fixed);
+    vuBuilder.precision (2);
+    {
+        const std::lock_guard<std::mutex> lock (playerMutex);
+
+        vuBuilder << "{\"dB_out\":[";
+        for (size_t i = 0; i < players.size(); ++i)
+            vuBuilder << (i > 0 ? "," : "") << players[i]->getVuDb();
+
+        vuBuilder << "],\"rms_out\":[";
+        for (size_t i = 0; i < players.size(); ++i)
+            vuBuilder << (i > 0 ? "," : "") << players[i]->getRmsDb();
+    }
+    vuBuilder << "],\"droppedEvents\":" << blockEvents.getNumDropped() << "}";
+    return vuBuilder.str();
 }
 
 juce::ValueTree SamplerEngine::exportToValueTree() const
@@ -233,6 +1463,8 @@ juce::ValueTree SamplerEngine::exportToValueTree() const
     const std::lock_guard<std::mutex> lock (playerMutex);
     juce::ValueTree root ("SamplerState");
     root.setProperty ("count", (int) players.size(), nullptr);
+    root.setProperty ("renderThreads", renderWorkers.getNumWorkers(), nullptr);
+    root.setProperty ("truePeakMetering", getTruePeakMetering(), nullptr);
 
     for (const auto& p : players)
     {
@@ -241,21 +1473,66 @@ juce::ValueTree SamplerEngine::exportToValueTree() const
         child.setProperty ("id", st.id, nullptr);
         child.setProperty ("midiLow", st.midiLow, nullptr);
         child.setProperty ("midiHigh", st.midiHigh, nullptr);
+        child.setProperty ("midiChannel", st.midiChannel, nullptr);
         child.setProperty ("gain", st.gain, nullptr);
+        child.setProperty ("polyphony", st.polyphony, nullptr);
+        child.setProperty ("stealPolicy", SamplePlayer::stealPolicyToString (st.stealPolicy), nullptr);
+        child.setProperty ("rootKey", st.rootKey, nullptr);
+        child.setProperty ("interpolation", Interpolator::modeToString (st.interpolation), nullptr);
+        child.setProperty ("storage", SamplePlayer::storageToString (st.storage), nullptr);
+        child.setProperty ("sampleFormat", CompactStorage::formatToString (st.sampleFormat), nullptr);
+        child.setProperty ("outputBus", st.outputBus, nullptr);
+        child.setProperty ("velocityCurve", ZoneMap::curveToString (st.velocityCurve), nullptr);
+        child.setProperty ("attackMs", st.envelope.attackMs, nullptr);
+        child.setProperty ("decayMs", st.envelope.decayMs, nullptr);
+        child.setProperty ("sustain", st.envelope.sustain, nullptr);
+        child.setProperty ("releaseMs", st.envelope.releaseMs, nullptr);
+        child.setProperty ("envelopeCurve", SamplePlayer::envelopeCurveToString (st.envelope.curve), nullptr);
+        child.setProperty ("oneShot", st.envelope.oneShot, nullptr);
+        child.setProperty ("loopEnabled", st.loop.enabled, nullptr);
+        child.setProperty ("loopStart", st.loop.start, nullptr);
+        child.setProperty ("loopEnd", st.loop.end, nullptr);
+        child.setProperty ("loopCrossfade", st.loop.crossfade, nullptr);
         child.setProperty ("filePath", st.filePath, nullptr);
         child.setProperty ("status", st.status, nullptr);
+
+        // zone 0 comes first and takes its file from the player's filePath
+        for (const auto& z : st.zones)
+        {
+            juce::ValueTree zoneTree ("Zone");
+            zoneTree.setProperty ("keyLow", z.zone.keyLow, nullptr);
+            zoneTree.setProperty ("keyHigh", z.zone.keyHigh, nullptr);
+            zoneTree.setProperty ("velocityLow", z.zone.velocityLow, nullptr);
+            zoneTree.setProperty ("velocityHigh", z.zone.velocityHigh, nullptr);
+            zoneTree.setProperty ("roundRobin", z.zone.roundRobin, nullptr);
+            zoneTree.setProperty ("rootKey", z.zone.rootKey, nullptr);
+            if (z.id != 0)
+                zoneTree.setProperty ("filePath", z.filePath, nullptr);
+            child.addChild (zoneTree, -1, nullptr);
+        }
+
         root.addChild (child, -1, nullptr);
     }
 
     return root;
 }
 
-void SamplerEngine::importFromValueTree (const juce::ValueTree& tree)
+void SamplerEngine::importFromValueTree (const juce::ValueTree& tree, std::function<void (bool, juce::String)> onZoneLoaded)
 {
+    struct PendingLoad
+    {
+        int zoneId;
+        juce::String path;
+        int priority;
+    };
+
     struct PendingPlayer
     {
         SamplePlayer::State state;
         juce::String path;
+        // zone 0 first; ids are assigned as the player is rebuilt
+        std::vector<std::pair<Zone, juce::String>> zones;
+        std::vector<PendingLoad> loads;
     };
 
     std::vector<PendingPlayer> pending;
@@ -270,38 +1547,103 @@ void SamplerEngine::importFromValueTree (const juce::ValueTree& tree)
         p.state.id = (int) child.getProperty ("id", nextId);
         p.state.midiLow = (int) child.getProperty ("midiLow", 36);
         p.state.midiHigh = (int) child.getProperty ("midiHigh", 60);
+        p.state.midiChannel = (int) child.getProperty ("midiChannel", 0);
         p.state.gain = (float) child.getProperty ("gain", 1.0f);
+        p.state.polyphony = (int) child.getProperty ("polyphony", 8);
+        p.state.stealPolicy = SamplePlayer::stealPolicyFromString (child.getProperty ("stealPolicy", "oldest").toString());
+        p.state.rootKey = (int) child.getProperty ("rootKey", 60);
+        p.state.interpolation = Interpolator::modeFromString (child.getProperty ("interpolation", "hermite").toString());
+        p.state.storage = SamplePlayer::storageFromString (child.getProperty ("storage", "memory").toString());
+        p.state.sampleFormat = CompactStorage::formatFromString (child.getProperty ("sampleFormat", "float32").toString());
+        p.state.outputBus = (int) child.getProperty ("outputBus", 0);
+        p.state.velocityCurve = ZoneMap::curveFromString (child.getProperty ("velocityCurve", "fixed").toString());
+        // sessions from before envelopes load as one-shots
+        p.state.envelope.attackMs = (float) child.getProperty ("attackMs", 0.0f);
+        p.state.envelope.decayMs = (float) child.getProperty ("decayMs", 0.0f);
+        p.state.envelope.sustain = (float) child.getProperty ("sustain", 1.0f);
+        p.state.envelope.releaseMs = (float) child.getProperty ("releaseMs", 0.0f);
+        p.state.envelope.curve = SamplePlayer::envelopeCurveFromString (child.getProperty ("envelopeCurve", "linear").toString());
+        p.state.envelope.oneShot = (bool) child.getProperty ("oneShot", true);
+        p.state.loop.enabled = (bool) child.getProperty ("loopEnabled", true);
+        p.state.loop.start = (int64) child.getProperty ("loopStart", -1);
+        p.state.loop.end = (int64) child.getProperty ("loopEnd", -1);
+        p.state.loop.crossfade = (int) child.getProperty ("loopCrossfade", 0);
         p.path = child.getProperty ("filePath").toString();
+
+        for (int z = 0; z < child.getNumChildren(); ++z)
+        {
+            auto zoneTree = child.getChild (z);
+            if (! zoneTree.hasType ("Zone"))
+                continue;
+
+            Zone zone;
+            zone.keyLow = (int) zoneTree.getProperty ("keyLow", 0);
+            zone.keyHigh = (int) zoneTree.getProperty ("keyHigh", 127);
+            zone.velocityLow = (int) zoneTree.getProperty ("velocityLow", 1);
+            zone.velocityHigh = (int) zoneTree.getProperty ("velocityHigh", 127);
+            zone.roundRobin = (int) zoneTree.getProperty ("roundRobin", 0);
+            zone.rootKey = (int) zoneTree.getProperty ("rootKey", -1);
+            p.zones.emplace_back (zone, p.zones.empty() ? p.path : zoneTree.getProperty ("filePath").toString());
+        }
+
+        // sessions from before zones only have the main sample
+        if (p.zones.empty())
+            p.zones.emplace_back (Zone(), p.path);
+
         pending.push_back (p);
     }
 
+    setRenderThreads ((int) tree.getProperty ("renderThreads", 0));
+    setTruePeakMetering ((bool) tree.getProperty ("truePeakMetering", false));
+
     {
         const std::lock_guard<std::mutex> lock (playerMutex);
+        auto released = std::move (players);
         players.clear();
         nextId = 1;
+        cancelLoads (-1, -1);
 
-        for (const auto& p : pending)
+        for (auto& p : pending)
         {
-            auto player = std::make_unique<SamplePlayer> (p.state.id);
+            auto player = std::make_unique<SamplePlayer> (p.state.id, streamer);
             player->setMidiRange (p.state.midiLow, p.state.midiHigh);
+            player->setMidiChannel (p.state.midiChannel);
             player->setGain (p.state.gain);
-            player->setFilePathAndStatus (p.path, p.path.isNotEmpty() ? "pending" : "empty");
+            player->setVoiceSettings (p.state.polyphony, p.state.stealPolicy);
+            player->setPitchSettings (p.state.rootKey, p.state.interpolation);
+            player->setStorage (p.state.storage);
+            player->setSampleFormat (p.state.sampleFormat);
+            player->setOutputBus (p.state.outputBus);
+            player->setVelocityCurve (p.state.velocityCurve);
+            player->setEnvelope (p.state.envelope);
+            player->setLoop (p.state.loop);
+            player->prepare (currentSampleRate.load(), currentBlockSize.load());
+
+            for (const auto& [zone, path] : p.zones)
+            {
+                const int zoneId = p.loads.empty() ? 0 : player->addZone (zone);
+                if (zoneId < 0)
+                    break;
+
+                if (zoneId == 0)
+                    player->setZone (0, zone);
+
+                player->setFilePathAndStatus (zoneId, path, path.isNotEmpty() ? "pending" : "empty");
+                p.loads.push_back ({ zoneId, path, getRestorePriority (p.state, zone) });
+            }
+
+            player->syncAudioState();
 
             nextId = std::max (nextId, p.state.id + 1);
             players.push_back (std::move (player));
         }
+
+        publishPlayers (std::move (released));
     }
 
-    // Load files outside the lock to avoid blocking.
+    // The host's thread only queues the files; failures show on their zones.
     for (const auto& p : pending)
-    {
-        if (p.path.isNotEmpty())
-        {
-            juce::String error;
-            auto ok = loadSampleInternal (p.state.id, juce::File (p.path), error);
-            if (! ok)
-                if (auto* player = getPlayer (p.state.id))
-                    player->markError (p.path, error.isNotEmpty() ? error : "missing");
-        }
-    }
+        for (const auto& load : p.loads)
+            if (load.path.isNotEmpty())
+                loadZoneAsync (p.state.id, load.zoneId, juce::File (load.path), onZoneLoaded, load.priority);
 }
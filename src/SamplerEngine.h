@@ -1,40 +1,310 @@
 #pragma once
 
 #include <JuceHeader.h>
+#include <atomic>
+#include <deque>
+#include <map>
 #include <mutex>
 #include <vector>
+#include "DecodedCache.h"
+#include "DiskStreamer.h"
+#include "EventList.h"
+#include "LoaderPool.h"
+#include "LockFreeQueue.h"
+#include "ParallelDecoder.h"
+#include "RenderWorkers.h"
+#include "SamplePool.h"
 #include "SamplePlayer.h"
 
 // Coordinates multiple SamplePlayer instances and exposes a thread-safe API.
+//
+// Control threads (HTTP, message, loaders) own the player models under
+// playerMutex and talk to the audio thread only through a preallocated
+// command queue. processBlock drains that queue at the start of each block
+// and never takes a lock; anything it replaces is handed back on the retire
+// queue, which a reclaimer thread empties, so it is freed off the audio thread.
+// An object is only retired once the audio thread has swapped it out, and
+// render workers never outlive processBlock, so nothing can still be reading
+// it by then.
 class SamplerEngine
 {
 public:
+    static constexpr int maxOutputBuses = SamplePlayer::numAuxOutputs + 1;
+
+    // Where an output bus sits in the buffer passed to processBlock; a bus the
+    // host has disabled has no channels.
+    struct OutputBus
+    {
+        int firstChannel { 0 };
+        int numChannels { 0 };
+    };
+
     SamplerEngine();
+    ~SamplerEngine();
 
     int addSamplePlayer();
+    // The player stops sounding at the start of the next block and is freed
+    // once the audio thread has let go of it.
+    bool removeSamplePlayer (int playerId);
 
-    void processBlock (juce::AudioBuffer<float>& buffer, const juce::MidiBuffer& midi);
+    void prepareToPlay (double sampleRate, int samplesPerBlock);
+    // Without a bus layout the whole buffer is the main output. Players
+    // assigned to a missing or disabled bus play through the main output.
+    // The whole buffer is cleared first, so callers need not clear it.
+    // Returns false when the block came out silent, so the caller can skip
+    // further work on it, such as metering. Only active players are visited,
+    // so the cost follows the number of sounding players rather than the total.
+    bool processBlock (juce::AudioBuffer<float>& buffer, const juce::MidiBuffer& midi,
+                       const OutputBus* buses = nullptr, int numBuses = 0);
 
     juce::var toVar() const;
 
+    // Loads run on a small pool of loader threads. A new load into a zone
+    // supersedes any still pending for it, and onComplete is not called for
+    // a load that was superseded or cancelled.
+    //
+    // Loads the player's main sample, zone 0.
     void loadSampleAsync (int playerId, const juce::File& file, std::function<void (bool, juce::String)> onComplete);
+    // Adds a zone playing `file`; onComplete runs on the message thread once
+    // it has loaded. Returns false if the player is missing or full.
+    bool addZoneAsync (int playerId, const juce::File& file, const Zone& zone, std::function<void (bool, juce::String)> onComplete);
+    // Stops the zone's pending load; a zone that never loaded shows it as an error.
+    bool cancelLoad (int playerId, int zoneId);
+    // Pending loads with their progress: player, zone, file, state ("queued"
+    // or "running"), bytesDecoded, totalBytes and elapsedMs. Also in toVar.
+    juce::var getLoadProgress() const;
+    bool setZone (int playerId, int zoneId, const Zone& zone);
+    bool removeZone (int playerId, int zoneId);
+    bool setVelocityCurve (int playerId, const juce::String& curve);
     bool setMidiRange (int playerId, int low, int high);
+    // 0 listens on every channel, 1-16 on that channel only.
+    bool setMidiChannel (int playerId, int channel);
     bool setGain (int playerId, float gain);
+    bool setVoiceSettings (int playerId, int polyphony, const juce::String& stealPolicy);
+    bool setPitchSettings (int playerId, int rootKey, const juce::String& interpolation);
+    bool setEnvelope (int playerId, const SamplePlayer::Envelope& envelope);
+    bool setLoop (int playerId, const SamplePlayer::Loop& loop);
+    // 0 is the main output, 1..16 the aux outputs.
+    bool setOutputBus (int playerId, int bus);
+    // Storage mode and in-RAM sample format; an empty name leaves that setting
+    // alone. A change reloads the player's file and onComplete runs on the
+    // message thread.
+    bool setStorage (int playerId, const juce::String& storage, const juce::String& sampleFormat,
+                     std::function<void (bool, juce::String)> onComplete);
+    // Extra threads that render players alongside the audio thread; 0 renders
+    // everything on the audio thread. The output is the same either way.
+    void setRenderThreads (int numThreads);
+    int getRenderThreads() const noexcept { return renderWorkers.getNumWorkers(); }
+    // Adds inter-sample peaks to every player's meter; read at each block.
+    void setTruePeakMetering (bool enabled) noexcept { truePeakMetering.store (enabled); }
+    bool getTruePeakMetering() const noexcept { return truePeakMetering.load(); }
     bool trigger (int playerId);
     juce::String getWaveformSVG (int playerId) const;
-    std::shared_ptr<std::string> getVuJson() const;
+    // {"dB_out":[...],"rms_out":[...],"droppedEvents":n}, peak and RMS readings
+    // in dB per player, and how many MIDI events have been dropped so far
+    // because a block had more than its event list holds. The count is also
+    // in toVar.
+    std::string getVuJson() const;
 
     juce::ValueTree exportToValueTree() const;
-    void importFromValueTree (const juce::ValueTree& tree);
+    // Rebuilds the players and returns at once, with their files "pending".
+    // The files load in parallel on the loader pool, those nearest middle C
+    // first, and each zone plays as soon as its own data is in. onZoneLoaded
+    // runs on the message thread after each one.
+    void importFromValueTree (const juce::ValueTree& tree,
+                              std::function<void (bool, juce::String)> onZoneLoaded = nullptr);
 
 private:
-    bool loadSampleInternal (int playerId, const juce::File& file, juce::String& error);
+    // The set of players the audio thread iterates. Published as a whole and,
+    // apart from `active`, never modified once it has been handed to the
+    // audio thread.
+    struct PlayerList
+    {
+        std::vector<SamplePlayer*> players;
+
+        // The audio thread's working list of active players (see
+        // SamplePlayer::isActive), in the order they became active. Reserved
+        // for every player here so adding to it never allocates.
+        std::vector<SamplePlayer*> active;
+
+        // Note dispatch: row channel * 128 + note lists the players for
+        // that note on MIDI channel 1-16, and row `note` (channel 0) the omni
+        // players. Row r is noteTargets[noteStart[r] .. noteStart[r + 1]).
+        static constexpr int numNoteRows = 17 * 128;
+        std::vector<uint32> noteStart;
+        std::vector<SamplePlayer*> noteTargets;
+
+        // Controller dispatch, laid out the same way with one row per channel.
+        static constexpr int numChannelRows = 17;
+        std::vector<uint32> channelStart;
+        std::vector<SamplePlayer*> channelTargets;
+
+        // players dropped from the previous list, freed together with it
+        std::vector<std::unique_ptr<SamplePlayer>> released;
+    };
+
+    struct Command
+    {
+        enum class Type { none, setGain, setVoiceSettings, setPitchSettings, setOutputBus, setEnvelope, trigger, setZoneMap, setPlayers };
+
+        Type type { Type::none };
+        int playerId { 0 };
+        float gain { 0.0f };
+        int polyphony { 0 };
+        SamplePlayer::StealPolicy stealPolicy { SamplePlayer::StealPolicy::oldest };
+        int rootKey { 60 };
+        Interpolator::Mode interpolation { Interpolator::Mode::hermite };
+        int outputBus { 0 };
+        SamplePlayer::Envelope envelope;
+        ZoneMapPtr zones;
+        std::unique_ptr<PlayerList> players;
+    };
+
+    // Objects the audio thread has let go of.
+    struct Retired
+    {
+        ZoneMapPtr zones;
+        std::unique_ptr<PlayerList> players;
+    };
+
+    // Loader pool priorities; higher runs first. Session restores sit in
+    // between, ordered by getRestorePriority.
+    static constexpr int loadPriority = 1000;      // files picked through the API
+    static constexpr int restorePriority = 100;    // plus up to 255
+    static constexpr int decodeHelperPriority = restorePriority - 1;   // idle threads helping decode a long file
+    static constexpr int conversionPriority = 0;   // host-rate copies of loaded files
+    static constexpr int cacheStorePriority = -1;  // DecodedCache entries for what was just decoded
+
+    // How much of a file a progressive load decodes before the zone can play.
+    static constexpr double progressiveHeadSeconds = 0.3;
+
+    // The latest load started for a zone. A load whose generation is no
+    // longer the one recorded here has been superseded or cancelled and
+    // drops its result.
+    struct ZoneLoad
+    {
+        uint64 generation { 0 };
+        juce::String path;
+        LoaderPool::JobPtr job;
+    };
+
+    void loadZoneAsync (int playerId, int zoneId, const juce::File& file, std::function<void (bool, juce::String)> onComplete,
+                        int priority = loadPriority);
+    static int getRestorePriority (const SamplePlayer::State& player, const Zone& zone);
+    // With a job the load reports progress and stops early when cancelled,
+    // and with a generation it only applies while that load is current. A
+    // current load into a zone with nothing playable yet hands the zone the
+    // opening of a decoded file before the rest is in.
+    bool loadZoneInternal (int playerId, int zoneId, const juce::File& file, juce::String& error,
+                           LoaderPool::Job* job = nullptr, uint64 generation = 0);
+    // Under playerMutex. -1 matches any player or zone.
+    void cancelLoads (int playerId, int zoneId);
+    bool isCurrentLoad (int playerId, int zoneId, uint64 generation) const;
+    juce::var loadProgressToVar() const;
+    SampleDataPtr decodeSampleFile (const juce::File& file, SamplePlayer::Storage storage,
+                                    CompactStorage::Format format, const juce::String& poolKey,
+                                    juce::String& error, LoaderPool::Job* job = nullptr,
+                                    const std::function<void (SampleDataPtr)>& onHeadReady = nullptr);
+    // Decodes the opening numFrames into data's buffer, or its packed frames
+    // when it has them, advancing framesLoaded as each piece lands.
+    static bool readAudio (juce::AudioFormatReader& reader, SampleData& data, int numFrames,
+                           LoaderPool::Job* job, const std::function<void()>& onHeadReady = nullptr);
+    static int getProgressiveHeadFrames (const juce::AudioFormatReader& reader, int numFrames);
     SamplePlayer* getPlayer (int playerId) const;
+    bool updatePlaybackData (SamplePlayer& player);
+    bool pushZoneMap (int playerId, ZoneMapPtr zones);
+    std::shared_ptr<SampleData> mapSampleFile (const juce::File& file, juce::AudioFormatReader& decoder);
+    // Through the DecodedCache.
+    SampleDataPtr getConvertedData (const SampleData& source, double targetRate);
+    // Writes data's DecodedCache entry on a loader thread once nothing more
+    // urgent is queued, so pool waiters get data without waiting on the disk.
+    void storeInCache (const juce::String& poolKey, double sampleRate, SampleDataPtr data);
+    static SampleDataPtr convertSampleData (const SampleData& source, double targetRate);
+    static void packSampleData (SampleData& data, CompactStorage::Format format);
+    static void unpackSampleData (const SampleData& data, juce::AudioBuffer<float>& dest);
 
+    // Under playerMutex. Never waits for the audio thread: a command that
+    // does not fit in the queue is kept, in order, and sent on later. Only
+    // fails once maxDeferredCommands are already waiting.
+    bool pushCommand (Command&& cmd);
+    // Under playerMutex. Moves deferred commands into the queue while it has room.
+    void sendDeferredCommands();
+    // Takes playerMutex; called by the reclaimer while commands are deferred.
+    void flushDeferredCommands();
+    bool publishPlayers (std::vector<std::unique_ptr<SamplePlayer>> released = {});
+    void buildNoteTable (PlayerList& list) const;
+    void collectRetired();
+
+    void drainCommands() noexcept;
+    void handleEvent (const SamplerEvent& ev) noexcept;
+    void dispatchNoteRow (int row, const SamplerEvent& ev) noexcept;
+    void dispatchControllerRow (int row, const SamplerEvent& ev) noexcept;
+    void renderRange (int startSample, int numSamples) noexcept;
+    void activatePlayer (SamplePlayer& player) noexcept;
+    void applyCommand (Command& cmd) noexcept;
+    SamplePlayer* getAudioPlayer (int playerId) const noexcept;
+
+    // shared by every player; outlive them
+    juce::SharedResourcePointer<SamplePool> samplePool;
+    juce::SharedResourcePointer<DecodedCache> decodedCache;
+    DiskStreamer streamer;
+
+    // control side, guarded by playerMutex
     std::vector<std::unique_ptr<SamplePlayer>> players;
     mutable std::mutex playerMutex;
     int nextId { 1 };
     juce::AudioFormatManager formatManager;
-    std::string vuJson;
-    mutable juce::SpinLock vuLock;
+    std::atomic<double> currentSampleRate { 44100.0 };
+    std::atomic<int> currentBlockSize { 512 };
+    std::atomic<bool> truePeakMetering { false };
+    std::vector<std::unique_ptr<SamplePlayer>> orphanedPlayers;
+    static constexpr int maxDeferredCommands = 4096;
+    std::deque<Command> deferredCommands;
+    std::atomic<int> numDeferredCommands { 0 };
+    std::map<std::pair<int, int>, ZoneLoad> zoneLoads;   // by player and zone id
+    uint64 nextLoadGeneration { 1 };
+
+    // audio side
+    std::unique_ptr<PlayerList> audioPlayers;
+    EventList blockEvents;
+    SamplePlayer::RenderScratch renderScratch;
+    RenderWorkers renderWorkers;
+    // output bus channels for the current block; unused buses stay empty
+    float* busChannels[maxOutputBuses][2] {};
+    int busNumChannels[maxOutputBuses] {};
+    bool blockAudible { false };
+    bool blockTruePeak { false };
+
+    LockFreeQueue<Command> commands { 1024 };
+    LockFreeQueue<Retired> retired { 2048 };
+
+    // jobs use everything above, so the pool goes before any of it
+    LoaderPool loaders { juce::SystemStats::getNumCpus() / 2 };
+
+    // Frees retired objects as they arrive rather than whenever a control
+    // thread next sends a command, and sends on any deferred commands once
+    // the audio thread has made room. Stopped first in the destructor.
+    class Reclaimer : public juce::Thread
+    {
+    public:
+        explicit Reclaimer (SamplerEngine& owner) : juce::Thread ("Sampler reclaimer"), engine (owner) {}
+
+        void run() override
+        {
+            while (! threadShouldExit())
+            {
+                engine.collectRetired();
+
+                if (engine.numDeferredCommands.load() > 0)
+                    engine.flushDeferredCommands();
+
+                wait (50);
+            }
+        }
+
+    private:
+        SamplerEngine& engine;
+    };
+
+    Reclaimer reclaimer { *this };
 };
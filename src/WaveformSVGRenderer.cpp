@@ -14,6 +14,46 @@ namespace
         const float clamped = juce::jlimit (-1.0f, 1.0f, sample);
         return midY - (clamped * halfHeight);
     }
+
+    juce::String buildWaveformSVG (const std::vector<std::pair<float, float>>& minMaxPairs, float width, float height)
+    {
+        const float viewWidth = std::max (width, 1.0f);
+        const float viewHeight = std::max (height, 1.0f);
+        const float usableHeight = std::max (viewHeight - (defaultPadding * 2.0f), 1.0f);
+        const float halfHeight = usableHeight / 2.0f;
+        const float midY = viewHeight / 2.0f;
+        const float xStep = (minMaxPairs.size() > 1)
+                                ? viewWidth / (float) (minMaxPairs.size() - 1)
+                                : viewWidth;
+
+        std::ostringstream pathStream;
+        pathStream.setf (std::ios::fixed);
+        pathStream.precision (3);
+
+        // Upper envelope
+        pathStream << "M 0 " << toY (minMaxPairs.front().second, midY, halfHeight);
+        for (size_t i = 1; i < minMaxPairs.size(); ++i)
+            pathStream << " L " << (xStep * (float) i) << ' ' << toY (minMaxPairs[i].second, midY, halfHeight);
+
+        // Lower envelope (reverse for a closed path)
+        for (size_t rev = minMaxPairs.size(); rev-- > 0;)
+            pathStream << " L " << (xStep * (float) rev) << ' ' << toY (minMaxPairs[rev].first, midY, halfHeight);
+
+        pathStream << " Z";
+
+        std::ostringstream svg;
+        svg.setf (std::ios::fixed);
+        svg.precision (2);
+        svg << "<svg xmlns=\"http://www.w3.org/2000/svg\" width=\"" << viewWidth
+            << "\" height=\"" << viewHeight << "\" viewBox=\"0 0 " << viewWidth << ' ' << viewHeight << "\" preserveAspectRatio=\"none\">";
+        svg << "<path d=\"" << pathStream.str()
+            << "\" fill=\"#c3c8d1\" stroke=\"#39404d\" stroke-width=\"1.6\" stroke-linejoin=\"round\" />";
+        svg << "<line x1=\"0\" y1=\"" << midY << "\" x2=\"" << viewWidth
+            << "\" y2=\"" << midY << "\" stroke=\"#9aa1ad\" stroke-width=\"1.1\" opacity=\"0.6\" />";
+        svg << "</svg>";
+
+        return svg.str();
+    }
 }
 
 juce::String WaveformSVGRenderer::generateWaveformSVG (const juce::AudioBuffer<float>& buffer,
@@ -56,42 +96,45 @@ juce::String WaveformSVGRenderer::generateWaveformSVG (const juce::AudioBuffer<f
         minMaxPairs.emplace_back (localMin, localMax);
     }
 
-    const float viewWidth = std::max (width, 1.0f);
-    const float viewHeight = std::max (height, 1.0f);
-    const float usableHeight = std::max (viewHeight - (defaultPadding * 2.0f), 1.0f);
-    const float halfHeight = usableHeight / 2.0f;
-    const float midY = viewHeight / 2.0f;
-    const float xStep = (minMaxPairs.size() > 1)
-                            ? viewWidth / (float) (minMaxPairs.size() - 1)
-                            : viewWidth;
+    return buildWaveformSVG (minMaxPairs, width, height);
+}
 
-    std::ostringstream pathStream;
-    pathStream.setf (std::ios::fixed);
-    pathStream.precision (3);
+juce::String WaveformSVGRenderer::generateWaveformSVG (juce::AudioFormatReader& reader,
+                                                       int numPlotPoints,
+                                                       float width,
+                                                       float height,
+                                                       int64 maxFramesPerPoint)
+{
+    const int64 totalSamples = reader.lengthInSamples;
+    const int numChannels = (int) std::min (2u, reader.numChannels);
 
-    // Upper envelope
-    pathStream << "M 0 " << toY (minMaxPairs.front().second, midY, halfHeight);
-    for (size_t i = 1; i < minMaxPairs.size(); ++i)
-        pathStream << " L " << (xStep * (float) i) << ' ' << toY (minMaxPairs[i].second, midY, halfHeight);
+    if (totalSamples <= 0 || numChannels == 0 || numPlotPoints <= 1)
+        return generateBlankWaveformSVG (width, height);
 
-    // Lower envelope (reverse for a closed path)
-    for (size_t rev = minMaxPairs.size(); rev-- > 0;)
-        pathStream << " L " << (xStep * (float) rev) << ' ' << toY (minMaxPairs[rev].first, midY, halfHeight);
+    const int64 samplesPerPoint = std::max ((int64) 1, totalSamples / numPlotPoints);
+    const int64 samplesToScan = maxFramesPerPoint > 0 ? std::min (samplesPerPoint, maxFramesPerPoint) : samplesPerPoint;
 
-    pathStream << " Z";
+    std::vector<std::pair<float, float>> minMaxPairs;
+    minMaxPairs.reserve ((size_t) numPlotPoints + 1);
 
-    std::ostringstream svg;
-    svg.setf (std::ios::fixed);
-    svg.precision (2);
-    svg << "<svg xmlns=\"http://www.w3.org/2000/svg\" width=\"" << viewWidth
-        << "\" height=\"" << viewHeight << "\" viewBox=\"0 0 " << viewWidth << ' ' << viewHeight << "\" preserveAspectRatio=\"none\">";
-    svg << "<path d=\"" << pathStream.str()
-        << "\" fill=\"#c3c8d1\" stroke=\"#39404d\" stroke-width=\"1.6\" stroke-linejoin=\"round\" />";
-    svg << "<line x1=\"0\" y1=\"" << midY << "\" x2=\"" << viewWidth
-        << "\" y2=\"" << midY << "\" stroke=\"#9aa1ad\" stroke-width=\"1.1\" opacity=\"0.6\" />";
-    svg << "</svg>";
+    // readMaxLevels scans the file in chunks, so nothing long is held in memory
+    for (int64 start = 0; start < totalSamples; start += samplesPerPoint)
+    {
+        juce::Range<float> levels[2];
+        reader.readMaxLevels (start, std::min (samplesToScan, totalSamples - start), levels, numChannels);
 
-    return svg.str();
+        float localMin = levels[0].getStart();
+        float localMax = levels[0].getEnd();
+        for (int chan = 1; chan < numChannels; ++chan)
+        {
+            localMin = std::min (localMin, levels[chan].getStart());
+            localMax = std::max (localMax, levels[chan].getEnd());
+        }
+
+        minMaxPairs.emplace_back (localMin, localMax);
+    }
+
+    return buildWaveformSVG (minMaxPairs, width, height);
 }
 
 juce::String WaveformSVGRenderer::generateBlankWaveformSVG (float width, float height)
@@ -11,6 +11,15 @@ public:
                                              float width = 520.0f,
                                              float height = 120.0f);
 
+    // Same preview read straight from a file, for samples too long to decode
+    // into memory. A non-zero maxFramesPerPoint only scans the start of each
+    // plotted span, trading accuracy for a load time independent of length.
+    static juce::String generateWaveformSVG (juce::AudioFormatReader& reader,
+                                             int numPlotPoints,
+                                             float width = 520.0f,
+                                             float height = 120.0f,
+                                             int64 maxFramesPerPoint = 0);
+
     static juce::String generateBlankWaveformSVG (float width = 520.0f,
                                                   float height = 120.0f);
 
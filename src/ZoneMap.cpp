@@ -0,0 +1,124 @@
+#include "ZoneMap.h"
+#include <algorithm>
+#include <map>
+
+ZoneMap::ZoneMap (std::vector<Entry> entriesToUse, VelocityCurve curve)
+    : entries (std::move (entriesToUse))
+{
+    jassert (entries.size() < 65536);
+
+    for (int v = 0; v < 128; ++v)
+    {
+        const float x = (float) v / 127.0f;
+
+        switch (curve)
+        {
+            case VelocityCurve::linear: velocityGain[(size_t) v] = x; break;
+            case VelocityCurve::soft:   velocityGain[(size_t) v] = std::sqrt (x); break;
+            case VelocityCurve::hard:   velocityGain[(size_t) v] = x * x; break;
+            case VelocityCurve::fixed:  velocityGain[(size_t) v] = 1.0f; break;
+        }
+    }
+
+    cellGroup.assign (128 * 128, 0);
+    groupSteps = { 0, 0 };
+    stepEntries = { 0 };
+
+    // (round robin, entry) pairs per cell, sorted, double as the group key
+    std::map<std::vector<std::pair<int, int>>, uint16> groups;
+    std::vector<int> onKey;
+    std::vector<std::pair<int, int>> cell;
+
+    for (int note = 0; note < 128; ++note)
+    {
+        onKey.clear();
+        for (int i = 0; i < (int) entries.size(); ++i)
+            if (note >= entries[(size_t) i].zone.keyLow && note <= entries[(size_t) i].zone.keyHigh)
+                onKey.push_back (i);
+
+        if (onKey.empty())
+            continue;
+
+        for (int velocity = 0; velocity < 128; ++velocity)
+        {
+            cell.clear();
+            for (int i : onKey)
+            {
+                const auto& zone = entries[(size_t) i].zone;
+                if (velocity >= zone.velocityLow && velocity <= zone.velocityHigh)
+                    cell.emplace_back (zone.roundRobin, i);
+            }
+
+            if (cell.empty())
+                continue;
+
+            std::sort (cell.begin(), cell.end());
+            auto [it, isNew] = groups.emplace (cell, (uint16) (groupSteps.size() - 1));
+
+            if (isNew)
+            {
+                for (size_t i = 0; i < cell.size(); ++i)
+                {
+                    entryList.push_back ((uint16) cell[i].second);
+
+                    // a new step starts wherever the round-robin index changes
+                    if (i + 1 == cell.size() || cell[i + 1].first != cell[i].first)
+                        stepEntries.push_back ((uint32) entryList.size());
+                }
+
+                groupSteps.push_back ((uint32) stepEntries.size() - 1);
+            }
+
+            cellGroup[(size_t) (note * 128 + velocity)] = it->second;
+        }
+    }
+}
+
+int ZoneMap::findEntry (int zoneId, const SampleData* source) const noexcept
+{
+    for (size_t i = 0; i < entries.size(); ++i)
+        if (entries[i].zoneId == zoneId && entries[i].source.get() == source)
+            return (int) i;
+    return -1;
+}
+
+int ZoneMap::getGroup (int note, int velocity) const noexcept
+{
+    return cellGroup[(size_t) (juce::jlimit (0, 127, note) * 128 + juce::jlimit (0, 127, velocity))];
+}
+
+int ZoneMap::getNumSteps (int note, int velocity) const noexcept
+{
+    const int group = getGroup (note, velocity);
+    return (int) (groupSteps[(size_t) group + 1] - groupSteps[(size_t) group]);
+}
+
+const uint16* ZoneMap::getStepEntries (int note, int velocity, int step, int& count) const noexcept
+{
+    const auto s = (size_t) groupSteps[(size_t) getGroup (note, velocity)] + (size_t) step;
+    count = (int) (stepEntries[s + 1] - stepEntries[s]);
+    return entryList.data() + stepEntries[s];
+}
+
+juce::String ZoneMap::curveToString (VelocityCurve curve)
+{
+    switch (curve)
+    {
+        case VelocityCurve::linear: return "linear";
+        case VelocityCurve::soft:   return "soft";
+        case VelocityCurve::hard:   return "hard";
+        case VelocityCurve::fixed:  break;
+    }
+    return "fixed";
+}
+
+VelocityCurve ZoneMap::curveFromString (const juce::String& name)
+{
+    if (name == "linear")
+        return VelocityCurve::linear;
+    if (name == "soft")
+        return VelocityCurve::soft;
+    if (name == "hard")
+        return VelocityCurve::hard;
+    return VelocityCurve::fixed;
+}
@@ -0,0 +1,70 @@
+#pragma once
+
+#include <JuceHeader.h>
+#include <array>
+#include <memory>
+#include <vector>
+#include "SampleData.h"
+#include "SampleLoop.h"
+
+// Where one sample sits in a player: the keys and velocities it answers and
+// its place in the round-robin cycle for them.
+struct Zone
+{
+    int keyLow { 0 };
+    int keyHigh { 127 };
+    int velocityLow { 1 };
+    int velocityHigh { 127 };
+    int roundRobin { 0 };   // overlapping zones alternate in this order; equal values layer
+    int rootKey { -1 };     // -1 plays at the player's root key
+};
+
+// How note velocity scales a voice's level.
+enum class VelocityCurve { fixed, linear, soft, hard };
+
+// A player's loaded zones as the audio thread sees them. Built on a control
+// thread and never changed once published. Every note and velocity is
+// resolved up front to a group of round-robin steps, each listing the zones
+// that sound together, so starting a note costs the same however many zones
+// the player has. Cells with identical zone lists share one group.
+class ZoneMap
+{
+public:
+    struct Entry
+    {
+        int zoneId { 0 };
+        Zone zone;
+        SampleDataPtr data;     // playback data, at the host rate once converted
+        SampleDataPtr source;   // the decoded file; tells rate conversions of it apart from a reload
+        SampleLoopPtr loop;     // over `data`; nullptr when the zone does not loop
+    };
+
+    ZoneMap (std::vector<Entry> entriesToUse, VelocityCurve curve);
+
+    int getNumEntries() const noexcept { return (int) entries.size(); }
+    const Entry& getEntry (int index) const noexcept { return entries[(size_t) index]; }
+    // -1 unless the map holds zoneId with the same source
+    int findEntry (int zoneId, const SampleData* source) const noexcept;
+
+    // Steps in the round-robin cycle for a note; 0 when no zone plays it.
+    int getNumSteps (int note, int velocity) const noexcept;
+    // Entry indices sounding at one step of that cycle.
+    const uint16* getStepEntries (int note, int velocity, int step, int& count) const noexcept;
+
+    float getVelocityGain (int velocity) const noexcept { return velocityGain[(size_t) juce::jlimit (0, 127, velocity)]; }
+
+    static juce::String curveToString (VelocityCurve curve);
+    static VelocityCurve curveFromString (const juce::String& name);
+
+private:
+    int getGroup (int note, int velocity) const noexcept;
+
+    std::vector<Entry> entries;
+    std::vector<uint16> cellGroup;     // 128 notes x 128 velocities; group 0 is empty
+    std::vector<uint32> groupSteps;    // group g owns steps [groupSteps[g], groupSteps[g + 1])
+    std::vector<uint32> stepEntries;   // step s owns entryList[stepEntries[s] .. stepEntries[s + 1])
+    std::vector<uint16> entryList;
+    std::array<float, 128> velocityGain {};
+};
+
+using ZoneMapPtr = std::shared_ptr<const ZoneMap>;
@@ -0,0 +1,122 @@
+#include <JuceHeader.h>
+#include <cmath>
+#include <cstring>
+#include <limits>
+#include <vector>
+#include "CompactStorage.h"
+
+// Round trips through the 16-bit formats. Buffers are longer than eight
+// samples and not a multiple of eight, so both the vector decode and its
+// scalar tail are covered.
+class CompactStorageTests : public juce::UnitTest
+{
+public:
+    CompactStorageTests() : juce::UnitTest ("CompactStorage", "Sampler") {}
+
+    void runTest() override
+    {
+        beginTest ("int16 keeps -1.0 and clamps +1.0 and louder to the largest step");
+        {
+            const auto out = roundTrip (CompactStorage::Format::int16, { -1.0f, 1.0f, 1.5f, 100.0f, -1.5f, -100.0f });
+            const float largest = 32767.0f / 32768.0f;
+            expectEquals (out[0], -1.0f);
+            expectEquals (out[1], largest);
+            expectEquals (out[2], largest);
+            expectEquals (out[3], largest);
+            expectEquals (out[4], -1.0f);
+            expectEquals (out[5], -1.0f);
+        }
+
+        beginTest ("int16 flushes denormals to zero");
+        {
+            const float denormal = std::numeric_limits<float>::denorm_min();
+            const auto out = roundTrip (CompactStorage::Format::int16, { denormal, -denormal, 1.0e-39f, 0.0f });
+            for (auto v : out)
+                expectEquals (v, 0.0f);
+        }
+
+        beginTest ("int16 is exact on its own steps and rounds to the nearest");
+        {
+            std::vector<float> steps;
+            for (int k = -32768; k < 32768; k += 97)
+                steps.push_back ((float) k / 32768.0f);
+            expect (roundTrip (CompactStorage::Format::int16, steps) == steps);
+
+            const auto in = randomSamples (1000, 1.0f);
+            const auto out = roundTrip (CompactStorage::Format::int16, in);
+            for (size_t i = 0; i < in.size(); ++i)
+                expectWithinAbsoluteError (out[i], in[i], 0.5f / 32768.0f);
+        }
+
+        beginTest ("float16 keeps +-1.0 and headroom above it");
+        {
+            const std::vector<float> in { 1.0f, -1.0f, 2.0f, -4.5f, 1000.0f, 65504.0f, -65504.0f };
+            expect (roundTrip (CompactStorage::Format::float16, in) == in);
+
+            const auto over = roundTrip (CompactStorage::Format::float16, { 1.0e5f, -1.0e5f });
+            expect (std::isinf (over[0]) && over[0] > 0.0f);
+            expect (std::isinf (over[1]) && over[1] < 0.0f);
+        }
+
+        beginTest ("float16 keeps its own subnormals and flushes float denormals");
+        {
+            const float smallest = std::ldexp (1.0f, -24);
+            const std::vector<float> halfSubnormals { smallest, -smallest, 3.0f * smallest, 1023.0f * smallest };
+            expect (roundTrip (CompactStorage::Format::float16, halfSubnormals) == halfSubnormals);
+
+            const float denormal = std::numeric_limits<float>::denorm_min();
+            const auto out = roundTrip (CompactStorage::Format::float16, { denormal, -denormal, 1.0e-39f, 0.4f * smallest });
+            for (auto v : out)
+                expectEquals (v, 0.0f);
+            expect (std::signbit (out[1]));
+        }
+
+        beginTest ("float16 rounds to within half a step of 11 bits");
+        {
+            for (float range : { 1.0f, 8.0f })
+            {
+                const auto in = randomSamples (1000, range);
+                const auto out = roundTrip (CompactStorage::Format::float16, in);
+                for (size_t i = 0; i < in.size(); ++i)
+                    expectWithinAbsoluteError (out[i], in[i], std::abs (in[i]) * std::ldexp (1.0f, -11) + std::ldexp (1.0f, -25));
+            }
+        }
+    }
+
+private:
+    // Encodes and decodes in, and checks the vector decode against decoding
+    // one sample at a time, which only takes the scalar path.
+    std::vector<float> roundTrip (CompactStorage::Format format, std::vector<float> in)
+    {
+        // pad to 8n + 3 so the vector loop and the scalar tail both run
+        const size_t size = in.size();
+        const size_t padded = (size + 7) / 8 * 8 + 3;
+        in.resize (padded, 0.0f);
+
+        std::vector<uint16> packed (padded);
+        std::vector<float> out (padded);
+        CompactStorage::encode (format, in.data(), packed.data(), (int) padded);
+        CompactStorage::decode (format, packed.data(), out.data(), (int) padded);
+
+        for (size_t i = 0; i < padded; ++i)
+        {
+            float scalar = 0.0f;
+            CompactStorage::decode (format, packed.data() + i, &scalar, 1);
+            expect (std::memcmp (&scalar, &out[i], sizeof (float)) == 0, "vector and scalar decode differ");
+        }
+
+        out.resize (size);
+        return out;
+    }
+
+    std::vector<float> randomSamples (int num, float range)
+    {
+        auto random = getRandom();
+        std::vector<float> samples ((size_t) num);
+        for (auto& s : samples)
+            s = (random.nextFloat() * 2.0f - 1.0f) * range;
+        return samples;
+    }
+};
+
+static CompactStorageTests compactStorageTests;
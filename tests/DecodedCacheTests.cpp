@@ -0,0 +1,213 @@
+#include <JuceHeader.h>
+#include <cstring>
+#include <vector>
+#include "DecodedCache.h"
+#include "TestFixtures.h"
+
+// Entries round trip in both float and packed form; anything damaged,
+// truncated or written for another key or rate is refused rather than
+// played; and the least recently used entries go once the directory passes
+// its size limit.
+class DecodedCacheTests : public juce::UnitTest
+{
+public:
+    DecodedCacheTests() : juce::UnitTest ("DecodedCache", "Sampler") {}
+
+    void runTest() override
+    {
+        beginTest ("a float32 entry maps back with its frames and metadata");
+        {
+            const TestFixtures::ScopedTempDirectory tempDirectory ("DecodedCache");
+            DecodedCache cache (tempDirectory.getDirectory());
+            const auto data = makeData (2, numFrames);
+            cache.store ("a.wav", 0.0, *data);
+
+            const auto loaded = cache.load ("a.wav", 0.0);
+            expect (loaded != nullptr && loaded->cacheMapping != nullptr);
+            if (loaded != nullptr)
+            {
+                expectEquals (loaded->getNumChannels(), 2);
+                expectEquals (loaded->lengthInSamples, (int64) numFrames);
+                expectEquals (loaded->sampleRate, data->sampleRate);
+                expectEquals (loaded->fileLoopStart, data->fileLoopStart);
+                expectEquals (loaded->fileLoopEnd, data->fileLoopEnd);
+                expectEquals (loaded->waveformSVG, data->waveformSVG);
+                expectEquals (loaded->poolKey, juce::String ("a.wav"));
+                for (int ch = 0; ch < 2; ++ch)
+                    expect (std::memcmp (loaded->getFloatChannel (ch), data->buffer.getReadPointer (ch), numFrames * sizeof (float)) == 0);
+            }
+        }
+
+        beginTest ("a packed entry keeps its format and frames");
+        {
+            const TestFixtures::ScopedTempDirectory tempDirectory ("DecodedCache");
+            DecodedCache cache (tempDirectory.getDirectory());
+            auto data = makeData (1, numFrames);
+            data->packed.resize ((size_t) numFrames);
+            CompactStorage::encode (CompactStorage::Format::int16, data->buffer.getReadPointer (0), data->packed.data(), numFrames);
+            data->packedFormat = CompactStorage::Format::int16;
+            data->packedFrames = data->packed.data();
+            data->packedChannels = 1;
+            data->buffer.setSize (0, 0);
+            cache.store ("a.wav", 0.0, *data);
+
+            const auto loaded = cache.load ("a.wav", 0.0);
+            expect (loaded != nullptr && loaded->isPacked() && loaded->packedFormat == CompactStorage::Format::int16);
+            if (loaded != nullptr && loaded->isPacked())
+                expect (std::memcmp (loaded->getPackedChannel (0), data->packed.data(), numFrames * sizeof (uint16)) == 0);
+        }
+
+        beginTest ("partial loads and data already from the cache are not stored");
+        {
+            const TestFixtures::ScopedTempDirectory tempDirectory ("DecodedCache");
+            DecodedCache cache (tempDirectory.getDirectory());
+
+            auto partial = makeData (1, numFrames);
+            partial->framesLoaded.store (numFrames / 2);
+            cache.store ("partial.wav", 0.0, *partial);
+            expect (cache.load ("partial.wav", 0.0) == nullptr);
+
+            cache.store ("", 0.0, *makeData (1, numFrames));
+            expectEquals (countEntries (tempDirectory.getDirectory()), 0);
+
+            cache.store ("a.wav", 0.0, *makeData (1, numFrames));
+            const auto loaded = cache.load ("a.wav", 0.0);
+            cache.store ("copy.wav", 0.0, *loaded);
+            expect (cache.load ("copy.wav", 0.0) == nullptr);
+        }
+
+        beginTest ("entries are keyed by pool key and rate");
+        {
+            const TestFixtures::ScopedTempDirectory tempDirectory ("DecodedCache");
+            DecodedCache cache (tempDirectory.getDirectory());
+            cache.store ("a.wav", 48000.0, *makeData (1, numFrames));
+
+            expect (cache.load ("a.wav", 48000.0) != nullptr);
+            expect (cache.load ("a.wav", 44100.0) == nullptr);
+            expect (cache.load ("a.wav", 0.0) == nullptr);
+            // a pool key carries the file's size and time, so an edited file misses
+            expect (cache.load ("b.wav", 48000.0) == nullptr);
+        }
+
+        beginTest ("damaged or truncated entries are refused and deleted");
+        {
+            for (const auto damage : { Damage::payloadByte, Damage::lastPayloadByte, Damage::headerByte, Damage::truncate, Damage::extend })
+            {
+                const TestFixtures::ScopedTempDirectory tempDirectory ("DecodedCache");
+                DecodedCache cache (tempDirectory.getDirectory());
+                cache.store ("a.wav", 0.0, *makeData (2, numFrames));
+
+                const auto entry = findEntries (tempDirectory.getDirectory())[0];
+                applyDamage (entry, damage);
+
+                expect (cache.load ("a.wav", 0.0) == nullptr, "damage " + juce::String ((int) damage) + " was not caught");
+                expect (! entry.existsAsFile(), "damage " + juce::String ((int) damage) + " left the entry behind");
+            }
+        }
+
+        beginTest ("an entry under another key's name is not played, and is left for its owner");
+        {
+            const TestFixtures::ScopedTempDirectory tempDirectory ("DecodedCache");
+            DecodedCache cache (tempDirectory.getDirectory());
+            cache.store ("a.wav", 0.0, *makeData (1, numFrames));
+            const auto entryA = findEntries (tempDirectory.getDirectory())[0];
+
+            cache.store ("b.wav", 0.0, *makeData (1, numFrames));
+            juce::File entryB;
+            for (const auto& f : findEntries (tempDirectory.getDirectory()))
+                if (f != entryA)
+                    entryB = f;
+
+            // as if the two keys hashed to the same name
+            expect (entryA.copyFileTo (entryB));
+            expect (cache.load ("b.wav", 0.0) == nullptr);
+            expect (entryB.existsAsFile());
+            expect (cache.load ("a.wav", 0.0) != nullptr);
+        }
+
+        beginTest ("past the size limit, the least recently used entries are deleted");
+        {
+            const TestFixtures::ScopedTempDirectory tempDirectory ("DecodedCache");
+            DecodedCache cache (tempDirectory.getDirectory());
+
+            cache.store ("first.wav", 0.0, *makeData (1, numFrames));
+            const int64 entryBytes = findEntries (tempDirectory.getDirectory())[0].getSize();
+            cache.setMaxBytes (entryBytes * 5 / 2);
+
+            cache.store ("second.wav", 0.0, *makeData (1, numFrames));
+            expectEquals (countEntries (tempDirectory.getDirectory()), 2);
+
+            // opening the first entry makes the second the least recently used
+            juce::Thread::sleep (50);
+            expect (cache.load ("first.wav", 0.0) != nullptr);
+            juce::Thread::sleep (50);
+
+            cache.store ("third.wav", 0.0, *makeData (1, numFrames));
+            expectEquals (countEntries (tempDirectory.getDirectory()), 2);
+            expect (cache.load ("first.wav", 0.0) != nullptr);
+            expect (cache.load ("second.wav", 0.0) == nullptr);
+            expect (cache.load ("third.wav", 0.0) != nullptr);
+
+            // a lower limit applies from the next store
+            cache.setMaxBytes (entryBytes);
+            juce::Thread::sleep (50);
+            cache.store ("fourth.wav", 0.0, *makeData (1, numFrames));
+            expectEquals (countEntries (tempDirectory.getDirectory()), 1);
+            expect (cache.load ("fourth.wav", 0.0) != nullptr);
+        }
+    }
+
+private:
+    static constexpr int numFrames = 20000;
+
+    enum class Damage { payloadByte, lastPayloadByte, headerByte, truncate, extend };
+
+    static std::shared_ptr<SampleData> makeData (int numChannels, int length)
+    {
+        auto data = std::make_shared<SampleData>();
+        data->sampleRate = 48000.0;
+        data->lengthInSamples = length;
+        data->fileLoopStart = 100;
+        data->fileLoopEnd = 900;
+        data->waveformSVG = "<svg/>";
+        data->buffer.setSize (numChannels, length);
+        TestFixtures::fillSines (data->buffer);
+        return data;
+    }
+
+    static std::vector<juce::File> findEntries (const juce::File& directory)
+    {
+        std::vector<juce::File> entries;
+        for (const auto& f : directory.findChildFiles (juce::File::findFiles, false, "*.sdc"))
+            entries.push_back (f);
+        return entries;
+    }
+
+    static int countEntries (const juce::File& directory) { return (int) findEntries (directory).size(); }
+
+    static void applyDamage (const juce::File& entry, Damage damage)
+    {
+        juce::MemoryBlock bytes;
+        entry.loadFileAsData (bytes);
+        auto* raw = static_cast<char*> (bytes.getData());
+
+        // frames start on the first 4 KB page boundary after the header; the
+        // rate's lowest byte still leaves a plausible header, so only the
+        // header checksum can catch it
+        constexpr size_t payloadStart = 4096;
+        constexpr size_t rateByte = 24;
+
+        switch (damage)
+        {
+            case Damage::payloadByte:     raw[payloadStart + 5] ^= 0x40; break;
+            case Damage::lastPayloadByte: raw[bytes.getSize() - 1] ^= 0x40; break;
+            case Damage::headerByte:      raw[rateByte] ^= 0x01; break;
+            case Damage::truncate:        bytes.setSize (bytes.getSize() - 4096); break;
+            case Damage::extend:          bytes.setSize (bytes.getSize() + 16, true); break;
+        }
+
+        entry.replaceWithData (bytes.getData(), bytes.getSize());
+    }
+};
+
+static DecodedCacheTests decodedCacheTests;
@@ -0,0 +1,158 @@
+#include <JuceHeader.h>
+#include <vector>
+#include "SamplerEngine.h"
+#include "TestFixtures.h"
+
+// Envelope segments and the moves between them, read straight off the
+// output: the file is a constant 0.5 played at its own pitch, so every
+// output sample is half the envelope level.
+class EnvelopeTests : public juce::UnitTest
+{
+public:
+    EnvelopeTests() : juce::UnitTest ("Envelope", "Sampler") {}
+
+    void runTest() override
+    {
+        const TestFixtures::ScopedTempDirectory tempDirectory ("Envelope");
+        juce::AudioBuffer<float> dc (2, (int) sampleRate);
+        for (int ch = 0; ch < dc.getNumChannels(); ++ch)
+            juce::FloatVectorOperations::fill (dc.getWritePointer (ch), 0.5f, dc.getNumSamples());
+        file = tempDirectory.getChildFile ("dc.wav");
+        TestFixtures::writeAudioFile (file, dc, sampleRate);
+
+        beginTest ("linear attack, decay, sustain and release each run their length and meet");
+        {
+            // 480 samples of attack, 960 of decay and 480 of release
+            const auto env = render (makeEnvelope (10.0f, 20.0f, 0.5f, 10.0f, SamplePlayer::EnvelopeCurve::linear), 4000);
+
+            expectSegment (env, 0, 480, [] (int i) { return (float) i / 480.0f; }, "attack");
+            expectSegment (env, 480, 1440, [] (int i) { return 1.0f - 0.5f * (float) (i - 480) / 960.0f; }, "decay");
+            expectSegment (env, 1440, 4000, [] (int) { return 0.5f; }, "sustain");
+            expectSegment (env, 4000, 4480, [] (int i) { return 0.5f * (1.0f - (float) (i - 4000) / 480.0f); }, "release");
+            expectSegment (env, 4480, (int) env.size(), [] (int) { return 0.0f; }, "after the release");
+            expect (! lastBlockAudible, "the voice outlived its release");
+        }
+
+        beginTest ("an exponential decay closes on the sustain level by 60 dB over its length");
+        {
+            const auto env = render (makeEnvelope (0.0f, 20.0f, 0.25f, 10.0f, SamplePlayer::EnvelopeCurve::exponential), -1);
+
+            expectWithinAbsoluteError (env[0], 1.0f, 1.0e-6f);
+            expectWithinAbsoluteError (env[480], 0.25f + 0.75f * std::sqrt (0.001f), 2.0e-3f);
+
+            bool falling = true;
+            for (size_t i = 1; i < 960; ++i)
+                falling = falling && env[i] <= env[i - 1];
+            expect (falling, "the decay rose");
+
+            expectSegment (env, 960, (int) env.size(), [] (int) { return 0.25f; }, "sustain after the decay");
+        }
+
+        beginTest ("a release during the attack starts from the level reached");
+        {
+            const auto env = render (makeEnvelope (20.0f, 0.0f, 1.0f, 10.0f, SamplePlayer::EnvelopeCurve::linear), 480);
+
+            expectSegment (env, 0, 480, [] (int i) { return (float) i / 960.0f; }, "attack");
+            expectSegment (env, 480, 960, [] (int i) { return 0.5f * (1.0f - (float) (i - 480) / 480.0f); }, "release");
+            expectSegment (env, 960, (int) env.size(), [] (int) { return 0.0f; }, "after the release");
+        }
+
+        beginTest ("a decay to zero sustain ends the voice with the note still held");
+        {
+            const auto env = render (makeEnvelope (0.0f, 10.0f, 0.0f, 10.0f, SamplePlayer::EnvelopeCurve::linear), -1);
+
+            expectSegment (env, 0, 480, [] (int i) { return 1.0f - (float) i / 480.0f; }, "decay");
+            expectSegment (env, 480, (int) env.size(), [] (int) { return 0.0f; }, "after the decay");
+            expect (! lastBlockAudible, "the voice outlived its decay");
+        }
+
+        beginTest ("a release is never shorter than the fade of a stolen voice");
+        {
+            // 5 ms at 48 kHz
+            const auto env = render (makeEnvelope (0.0f, 0.0f, 1.0f, 0.0f, SamplePlayer::EnvelopeCurve::linear), 1000);
+
+            expectSegment (env, 1000, 1240, [] (int i) { return 1.0f - (float) (i - 1000) / 240.0f; }, "release");
+            expectSegment (env, 1240, (int) env.size(), [] (int) { return 0.0f; }, "after the release");
+        }
+
+        beginTest ("a one-shot plays through its note-off");
+        {
+            auto envelope = makeEnvelope (0.0f, 0.0f, 1.0f, 10.0f, SamplePlayer::EnvelopeCurve::linear);
+            envelope.oneShot = true;
+            const auto env = render (envelope, 1000);
+
+            expectSegment (env, 0, (int) env.size(), [] (int) { return 1.0f; }, "one-shot");
+        }
+
+        file = {};
+    }
+
+private:
+    static constexpr double sampleRate = 48000.0;
+    static constexpr int blockSize = 256;
+    static constexpr int numBlocks = 24;
+
+    juce::File file;
+    bool lastBlockAudible { false };
+
+    static SamplePlayer::Envelope makeEnvelope (float attackMs, float decayMs, float sustain, float releaseMs,
+                                                SamplePlayer::EnvelopeCurve curve)
+    {
+        SamplePlayer::Envelope envelope;
+        envelope.attackMs = attackMs;
+        envelope.decayMs = decayMs;
+        envelope.sustain = sustain;
+        envelope.releaseMs = releaseMs;
+        envelope.curve = curve;
+        envelope.oneShot = false;
+        return envelope;
+    }
+
+    // Plays the root key from sample 0, releases it at noteOffSample unless
+    // that is negative, and returns the envelope level of each sample.
+    std::vector<float> render (const SamplePlayer::Envelope& envelope, int noteOffSample)
+    {
+        SamplerEngine engine;
+        engine.prepareToPlay (sampleRate, blockSize);
+        const int id = engine.addSamplePlayer();
+        engine.setMidiRange (id, 0, 127);
+        engine.setEnvelope (id, envelope);
+        engine.loadSampleAsync (id, file, nullptr);
+        while (engine.getLoadProgress().size() > 0)
+            juce::Thread::sleep (5);
+
+        juce::AudioBuffer<float> buffer (2, blockSize);
+        juce::MidiBuffer midi;
+        std::vector<float> env;
+
+        for (int block = 0; block < numBlocks; ++block)
+        {
+            const int blockStart = block * blockSize;
+            midi.clear();
+            if (block == 0)
+                midi.addEvent (juce::MidiMessage::noteOn (1, 60, (juce::uint8) 127), 0);
+            if (noteOffSample >= blockStart && noteOffSample < blockStart + blockSize)
+                midi.addEvent (juce::MidiMessage::noteOff (1, 60), noteOffSample - blockStart);
+
+            lastBlockAudible = engine.processBlock (buffer, midi);
+            for (int i = 0; i < blockSize; ++i)
+                env.push_back (buffer.getSample (0, i) * 2.0f);
+        }
+
+        return env;
+    }
+
+    template <typename Expected>
+    void expectSegment (const std::vector<float>& env, int start, int end, Expected expected, const juce::String& segment)
+    {
+        int firstWrong = -1;
+        for (int i = start; i < end && firstWrong < 0; ++i)
+            if (std::abs (env[(size_t) i] - expected (i)) > 1.0e-4f)
+                firstWrong = i;
+
+        expect (firstWrong < 0, segment + " is off at sample " + juce::String (firstWrong) + ": "
+                                    + juce::String (firstWrong < 0 ? 0.0f : env[(size_t) firstWrong]));
+    }
+};
+
+static EnvelopeTests envelopeTests;
@@ -0,0 +1,155 @@
+#include <JuceHeader.h>
+#include <vector>
+#include "EventList.h"
+#include "SamplerEngine.h"
+#include "TestFixtures.h"
+
+// The per-block event list on its own, then through the engine: a block is
+// rendered in stretches split at each event, so a note sounds from its own
+// sample offset, and events past the list's capacity are dropped and counted.
+class EventListTests : public juce::UnitTest
+{
+public:
+    EventListTests() : juce::UnitTest ("EventList", "Sampler") {}
+
+    void runTest() override
+    {
+        beginTest ("events are kept in time order, ties in the order they arrived");
+        {
+            EventList list;
+            list.prepare (8);
+
+            for (int offset : { 10, 30, 20, 20, 0 })
+                expect (list.add (makeEvent (offset, list.size())));
+
+            const std::vector<std::pair<int, int>> expected { { 0, 4 }, { 10, 0 }, { 20, 2 }, { 20, 3 }, { 30, 1 } };
+            std::vector<std::pair<int, int>> got;
+            for (const auto& ev : list)
+                got.push_back ({ ev.sampleOffset, ev.number });
+            expect (got == expected);
+        }
+
+        beginTest ("events past the capacity are dropped and counted, and the count survives clear");
+        {
+            EventList list;
+            list.prepare (4);
+            expectEquals (list.getCapacity(), 4);
+
+            for (int i = 0; i < 7; ++i)
+                expect (list.add (makeEvent (i, i)) == (i < 4));
+
+            expectEquals (list.size(), 4);
+            expectEquals (list.getNumDropped(), 3);
+
+            list.clear();
+            expectEquals (list.size(), 0);
+            expectEquals (list.getNumDropped(), 3);
+            expect (list.add (makeEvent (0, 0)));
+        }
+
+        beginTest ("prepare never leaves the list without room");
+        {
+            EventList list;
+            list.prepare (0);
+            expectEquals (list.getCapacity(), 1);
+        }
+
+        const TestFixtures::ScopedTempDirectory tempDirectory ("EventList");
+        const auto file = TestFixtures::writeSineFile (tempDirectory.getChildFile ("events.wav"), sampleRate, (int) sampleRate);
+
+        beginTest ("a note-on mid-block sounds from its own sample, as it would from the block start");
+        {
+            constexpr int offset = 100;
+            const auto fromStart = renderNote (file, 0);
+            const auto midBlock = renderNote (file, offset);
+
+            float peak = 0.0f;
+            for (auto s : fromStart)
+                peak = juce::jmax (peak, std::abs (s));
+            expect (peak > 0.01f, "the note was silent");
+
+            bool silentBefore = true;
+            for (int i = 0; i < offset; ++i)
+                silentBefore = silentBefore && std::abs (midBlock[(size_t) i]) < 1.0e-9f;
+            expect (silentBefore, "output before the note-on");
+
+            bool matches = true;
+            for (size_t i = 0; i + offset < midBlock.size(); ++i)
+                matches = matches && std::abs (midBlock[i + offset] - fromStart[i]) < 1.0e-6f;
+            expect (matches, "the note started at another sample, or differently");
+        }
+
+        beginTest ("a block with more events than the list holds drops the rest and reports them");
+        {
+            SamplerEngine engine;
+            engine.prepareToPlay (sampleRate, blockSize);
+            expectEquals (getDroppedEvents (engine), 0);
+
+            // controllers cost nothing to handle but still take a slot each
+            constexpr int numEvents = 5000;
+            juce::MidiBuffer midi;
+            for (int i = 0; i < numEvents; ++i)
+                midi.addEvent (juce::MidiMessage::controllerEvent (1, 7, i % 128), i % blockSize);
+
+            juce::AudioBuffer<float> buffer (2, blockSize);
+            engine.processBlock (buffer, midi);
+            const int dropped = getDroppedEvents (engine);
+            expect (dropped > 0 && dropped < numEvents, "dropped " + juce::String (dropped) + " events");
+
+            // a later block that fits drops nothing more
+            midi.clear();
+            midi.addEvent (juce::MidiMessage::controllerEvent (1, 7, 0), 0);
+            engine.processBlock (buffer, midi);
+            expectEquals (getDroppedEvents (engine), dropped);
+        }
+    }
+
+private:
+    static constexpr double sampleRate = 48000.0;
+    static constexpr int blockSize = 256;
+
+    static SamplerEvent makeEvent (int offset, int number)
+    {
+        SamplerEvent ev;
+        ev.type = SamplerEvent::Type::controller;
+        ev.sampleOffset = offset;
+        ev.number = number;
+        return ev;
+    }
+
+    // Plays the root key at `offset` in the first of four blocks and returns
+    // the left channel.
+    static std::vector<float> renderNote (const juce::File& file, int offset)
+    {
+        SamplerEngine engine;
+        engine.prepareToPlay (sampleRate, blockSize);
+        const int id = engine.addSamplePlayer();
+        engine.setMidiRange (id, 0, 127);
+        engine.loadSampleAsync (id, file, nullptr);
+        while (engine.getLoadProgress().size() > 0)
+            juce::Thread::sleep (5);
+
+        juce::AudioBuffer<float> buffer (2, blockSize);
+        juce::MidiBuffer midi;
+        std::vector<float> output;
+
+        for (int block = 0; block < 4; ++block)
+        {
+            midi.clear();
+            if (block == 0)
+                midi.addEvent (juce::MidiMessage::noteOn (1, 60, (juce::uint8) 100), offset);
+
+            engine.processBlock (buffer, midi);
+            output.insert (output.end(), buffer.getReadPointer (0), buffer.getReadPointer (0) + blockSize);
+        }
+
+        return output;
+    }
+
+    static int getDroppedEvents (const SamplerEngine& engine)
+    {
+        return (int) juce::JSON::parse (juce::String (engine.getVuJson()))["droppedEvents"];
+    }
+};
+
+static EventListTests eventListTests;
@@ -0,0 +1,139 @@
+#include <JuceHeader.h>
+#include <atomic>
+#include <functional>
+#include <mutex>
+#include <vector>
+#include "LoaderPool.h"
+
+// Queue order and cancellation. Each case holds the pool's only thread on a
+// gate job, started before anything else is queued, so the order the rest
+// run in is decided by the queue alone.
+class LoaderPoolTests : public juce::UnitTest
+{
+public:
+    LoaderPoolTests() : juce::UnitTest ("LoaderPool", "Sampler") {}
+
+    void runTest() override
+    {
+        beginTest ("thread count is kept between one and maxThreads");
+        {
+            expectEquals (LoaderPool (0).getNumThreads(), 1);
+            expectEquals (LoaderPool (100).getNumThreads(), LoaderPool::maxThreads);
+        }
+
+        beginTest ("jobs run highest priority first, in the order added within a priority");
+        {
+            LoaderPool pool (1);
+            std::atomic<bool> open { false };
+            expect (waitUntil ([held = pool.add (0, gate (open))] { return held->hasStarted(); }));
+
+            std::mutex ranLock;
+            std::vector<int> ran;
+            std::vector<LoaderPool::JobPtr> jobs;
+            const std::pair<int, int> queued[] = { { 5, 1 }, { 1, 2 }, { 9, 3 }, { 5, 4 }, { -1, 5 }, { 9, 6 }, { 1, 7 } };
+
+            for (const auto& [priority, tag] : queued)
+                jobs.push_back (pool.add (priority, [&ranLock, &ran, tag = tag] (LoaderPool::Job&)
+                                          {
+                                              const std::lock_guard<std::mutex> guard (ranLock);
+                                              ran.push_back (tag);
+                                          }));
+
+            expect (! jobs.front()->hasStarted());
+            expectEquals (jobs.front()->getElapsedMs(), 0.0);
+
+            open = true;
+            expect (waitUntil ([&] { const std::lock_guard<std::mutex> guard (ranLock); return ran.size() == jobs.size(); }));
+
+            const std::lock_guard<std::mutex> guard (ranLock);
+            expect (ran == std::vector<int> { 3, 6, 1, 4, 2, 7, 5 });
+        }
+
+        beginTest ("a job cancelled while queued never runs, and the queue carries on");
+        {
+            LoaderPool pool (1);
+            std::atomic<bool> open { false };
+            expect (waitUntil ([held = pool.add (0, gate (open))] { return held->hasStarted(); }));
+
+            std::atomic<bool> cancelledRan { false }, laterRan { false };
+            auto cancelled = pool.add (10, [&] (LoaderPool::Job&) { cancelledRan = true; });
+            pool.add (5, [&] (LoaderPool::Job&) { laterRan = true; });
+            cancelled->cancel();
+
+            open = true;
+            expect (waitUntil ([&] { return laterRan.load(); }));
+            expect (! cancelledRan);
+            expect (! cancelled->hasStarted());
+        }
+
+        beginTest ("a running job sees its cancellation and returns early");
+        {
+            LoaderPool pool (1);
+            std::atomic<bool> returned { false };
+            auto job = pool.add (0, [&] (LoaderPool::Job& self)
+                                 {
+                                     self.setTotalBytes (1000);
+                                     while (! self.isCancelled())
+                                     {
+                                         if (self.getBytesDone() < 1000)
+                                             self.addBytesDone (100);
+                                         juce::Thread::sleep (1);
+                                     }
+                                     returned = true;
+                                 });
+
+            expect (waitUntil ([&] { return job->getBytesDone() == 1000; }));
+            expect (job->hasStarted() && ! returned);
+            expectEquals (job->getTotalBytes(), (int64) 1000);
+
+            job->cancel();
+            expect (waitUntil ([&] { return returned.load(); }));
+        }
+
+        beginTest ("destroying the pool cancels running jobs and drops queued ones");
+        {
+            std::atomic<bool> runningReturned { false }, queuedRan { false };
+            LoaderPool::JobPtr running, queued;
+
+            {
+                LoaderPool pool (1);
+                running = pool.add (1, [&] (LoaderPool::Job& self)
+                                    {
+                                        while (! self.isCancelled())
+                                            juce::Thread::sleep (1);
+                                        runningReturned = true;
+                                    });
+                queued = pool.add (0, [&] (LoaderPool::Job&) { queuedRan = true; });
+
+                expect (waitUntil ([&] { return running->hasStarted(); }));
+            }
+
+            expect (runningReturned && running->isCancelled());
+            expect (! queuedRan && ! queued->hasStarted());
+        }
+    }
+
+private:
+    // Holds the thread that runs it until `open` is set, or the pool goes.
+    static std::function<void (LoaderPool::Job&)> gate (std::atomic<bool>& open)
+    {
+        return [&open] (LoaderPool::Job& self)
+        {
+            while (! open && ! self.isCancelled())
+                juce::Thread::sleep (1);
+        };
+    }
+
+    static bool waitUntil (const std::function<bool()>& done)
+    {
+        for (int i = 0; i < 5000; ++i)
+        {
+            if (done())
+                return true;
+            juce::Thread::sleep (1);
+        }
+        return done();
+    }
+};
+
+static LoaderPoolTests loaderPoolTests;
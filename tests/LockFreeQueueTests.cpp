@@ -0,0 +1,194 @@
+#include <JuceHeader.h>
+#include <cstring>
+#include <thread>
+#include <vector>
+#include "LockFreeQueue.h"
+#include "SamplerEngine.h"
+#include "TestFixtures.h"
+
+// The command queue on its own, then as the engine uses it: commands that
+// do not fit while the audio thread is stalled are deferred, not dropped or
+// reordered, up to a limit past which they are refused.
+class LockFreeQueueTests : public juce::UnitTest
+{
+public:
+    LockFreeQueueTests() : juce::UnitTest ("LockFreeQueue", "Sampler") {}
+
+    void runTest() override
+    {
+        beginTest ("capacity rounds up to a power of two");
+        {
+            expectEquals (LockFreeQueue<int> (1).getCapacity(), 2);
+            expectEquals (LockFreeQueue<int> (5).getCapacity(), 8);
+            expectEquals (LockFreeQueue<int> (1024).getCapacity(), 1024);
+        }
+
+        beginTest ("push fails when full and pop when empty, leaving the queue usable");
+        {
+            LockFreeQueue<int> queue (4);
+            int item = 0;
+            expect (! queue.pop (item));
+
+            for (int i = 0; i < 4; ++i)
+                expect (queue.push (int (i)));
+            expect (! queue.push (99));
+
+            for (int i = 0; i < 4; ++i)
+            {
+                expect (queue.pop (item));
+                expectEquals (item, i);
+            }
+            expect (! queue.pop (item));
+            expect (queue.push (5));
+        }
+
+        beginTest ("items stay in order as the positions wrap many times round");
+        {
+            LockFreeQueue<int> queue (4);
+            int next = 0, expected = 0, item = 0;
+
+            // fill by a varying amount each round so the start moves around the cells
+            for (int round = 0; round < 5000; ++round)
+            {
+                const int fill = 1 + round % 4;
+                for (int i = 0; i < fill; ++i)
+                    expect (queue.push (int (next++)));
+
+                while (queue.pop (item))
+                    expectEquals (item, expected++);
+            }
+            expectEquals (expected, next);
+        }
+
+        beginTest ("two producers and a consumer: nothing lost, each producer's items in order");
+        {
+            constexpr int perProducer = 100000;
+            LockFreeQueue<int> queue (64);
+
+            const auto produce = [&queue] (int first)
+            {
+                for (int i = first; i < first + perProducer; ++i)
+                    while (! queue.push (int (i)))
+                        std::this_thread::yield();
+            };
+            std::thread a (produce, 0), b (produce, perProducer);
+
+            int lastA = -1, lastB = perProducer - 1, received = 0, item = 0;
+            bool ordered = true;
+            while (received < 2 * perProducer)
+            {
+                if (! queue.pop (item))
+                {
+                    std::this_thread::yield();
+                    continue;
+                }
+
+                auto& last = item < perProducer ? lastA : lastB;
+                ordered = ordered && item == last + 1;
+                last = item;
+                ++received;
+            }
+            a.join();
+            b.join();
+
+            expect (ordered, "a producer's items arrived out of order");
+            expectEquals (lastA, perProducer - 1);
+            expectEquals (lastB, 2 * perProducer - 1);
+        }
+
+        checkEngineOverflow();
+    }
+
+private:
+    static constexpr double sampleRate = 48000.0;
+    static constexpr int blockSize = 256;
+
+    static float gainFor (int i) { return 0.1f + 0.8f * (float) (i % 97) / 97.0f; }
+
+    // Floods a stalled engine with gain changes, then lets the audio thread
+    // run again. The last accepted gain must be the one that sounds, exactly
+    // as if it had been the only change.
+    void checkEngineOverflow()
+    {
+        const TestFixtures::ScopedTempDirectory tempDirectory ("LockFreeQueue");
+        const auto file = TestFixtures::writeSineFile (tempDirectory.getChildFile ("queue.wav"), sampleRate, (int) sampleRate);
+
+        beginTest ("a stalled audio thread defers commands in order and refuses them past the limit");
+
+        SamplerEngine engine;
+        const int id = addPlayer (engine, file);
+
+        int accepted = 0;
+        bool refusedThenAccepted = false;
+        for (int i = 0; i < 8000; ++i)
+        {
+            if (engine.setGain (id, gainFor (i)))
+            {
+                refusedThenAccepted = refusedThenAccepted || accepted < i;
+                ++accepted;
+            }
+        }
+
+        expect (accepted > 1024, "no command was deferred past the queue");
+        expect (accepted < 8000, "deferred commands were never refused");
+        expect (! refusedThenAccepted, "a command was accepted after an earlier one was refused");
+
+        // the trigger is refused until the audio thread has made room
+        juce::AudioBuffer<float> buffer (2, blockSize);
+        juce::MidiBuffer midi;
+        for (int tries = 0; tries < 1000 && ! engine.trigger (id); ++tries)
+        {
+            engine.processBlock (buffer, midi);
+            juce::Thread::sleep (2);
+        }
+
+        const auto flooded = renderFirstAudibleBlock (engine);
+
+        SamplerEngine reference;
+        const int referenceId = addPlayer (reference, file);
+        reference.setGain (referenceId, gainFor (accepted - 1));
+        reference.trigger (referenceId);
+        const auto expected = renderFirstAudibleBlock (reference);
+
+        expect (flooded.size() == expected.size() && ! flooded.empty(), "the trigger never sounded");
+        expect (flooded.size() == expected.size()
+                    && std::memcmp (flooded.data(), expected.data(), flooded.size() * sizeof (float)) == 0,
+                "the last accepted gain is not the one that sounds");
+    }
+
+    static int addPlayer (SamplerEngine& engine, const juce::File& file)
+    {
+        engine.prepareToPlay (sampleRate, blockSize);
+        const int id = engine.addSamplePlayer();
+        engine.loadSampleAsync (id, file, nullptr);
+        while (engine.getLoadProgress().size() > 0)
+            juce::Thread::sleep (5);
+
+        // take in the new player and its sample before any test commands
+        juce::AudioBuffer<float> buffer (2, blockSize);
+        engine.processBlock (buffer, {});
+        return id;
+    }
+
+    static std::vector<float> renderFirstAudibleBlock (SamplerEngine& engine)
+    {
+        juce::AudioBuffer<float> buffer (2, blockSize);
+        juce::MidiBuffer midi;
+
+        // deferred commands reach the audio thread as the reclaimer sends them on
+        for (int block = 0; block < 1000; ++block)
+        {
+            if (engine.processBlock (buffer, midi))
+            {
+                std::vector<float> output;
+                for (int ch = 0; ch < buffer.getNumChannels(); ++ch)
+                    output.insert (output.end(), buffer.getReadPointer (ch), buffer.getReadPointer (ch) + blockSize);
+                return output;
+            }
+            juce::Thread::sleep (2);
+        }
+        return {};
+    }
+};
+
+static LockFreeQueueTests lockFreeQueueTests;
@@ -0,0 +1,204 @@
+#include <JuceHeader.h>
+#include <atomic>
+#include <cstring>
+#include <memory>
+#include "ParallelDecoder.h"
+#include "TestFixtures.h"
+
+// ParallelDecoder must give exactly what one reader decoding the file from
+// the start gives. For each format a fixture long enough for three ranges
+// is written at run time, then decoded both ways and compared bit for bit.
+// A failed seam would only fall back to a serial decode, so each range's
+// start is also read on its own after prerollFrames of preroll, to show the
+// preroll alone makes the seam check and the frames after it match.
+//
+// A stand-in lapped codec runs everywhere, whichever codecs are built in:
+// after a seek its reader gets the first warmUpFrames wrong, the way a
+// Vorbis or AAC decoder does without the previous block.
+class ParallelDecoderTests : public juce::UnitTest
+{
+public:
+    ParallelDecoderTests() : juce::UnitTest ("ParallelDecoder", "Sampler") {}
+
+    void runTest() override
+    {
+        checkLappedCodec();
+
+        const TestFixtures::ScopedTempDirectory tempDirectory ("ParallelDecoder");
+
+        // WAV seeks exactly, so it checks the ranges are stitched together
+        // right whatever the codec does
+        juce::WavAudioFormat wav;
+        checkFormat (tempDirectory.getDirectory(), wav, 24, 0);
+
+       #if JUCE_USE_FLAC
+        juce::FlacAudioFormat flac;
+        checkFormat (tempDirectory.getDirectory(), flac, 24, 0);
+       #endif
+       #if JUCE_USE_OGGVORBIS
+        juce::OggVorbisAudioFormat ogg;
+        checkFormat (tempDirectory.getDirectory(), ogg, 16, ogg.getQualityOptions().size() / 2);
+       #endif
+    }
+
+private:
+    // Plays `source` as float data. Frames within warmUpFrames of the last
+    // seek are off by a quarter, except from frame 0, where a real decoder
+    // starts clean too. Counts every frame it decodes in `decoded`.
+    class LappedReader : public juce::AudioFormatReader
+    {
+    public:
+        LappedReader (const juce::AudioBuffer<float>& sourceAudio, int warmUp, std::atomic<int64>& decodedCount)
+            : juce::AudioFormatReader (nullptr, "Lapped"), source (sourceAudio), warmUpFrames (warmUp), decoded (decodedCount)
+        {
+            sampleRate = 44100.0;
+            bitsPerSample = 32;
+            usesFloatingPointData = true;
+            numChannels = (unsigned int) source.getNumChannels();
+            lengthInSamples = source.getNumSamples();
+        }
+
+        bool readSamples (int* const* destChannels, int numDestChannels, int startOffsetInDestBuffer,
+                          int64 startSampleInFile, int numSamples) override
+        {
+            if (startSampleInFile != nextFrame)
+                seekFrame = startSampleInFile;
+
+            for (int ch = 0; ch < numDestChannels; ++ch)
+            {
+                if (destChannels[ch] == nullptr)
+                    continue;
+
+                auto* dest = reinterpret_cast<float*> (destChannels[ch]) + startOffsetInDestBuffer;
+                const auto* src = source.getReadPointer (juce::jmin (ch, source.getNumChannels() - 1));
+
+                for (int i = 0; i < numSamples; ++i)
+                {
+                    const int64 frame = startSampleInFile + i;
+                    const bool warm = seekFrame == 0 || frame - seekFrame >= warmUpFrames;
+                    dest[i] = frame < lengthInSamples ? src[frame] + (warm ? 0.0f : 0.25f) : 0.0f;
+                }
+            }
+
+            nextFrame = startSampleInFile + numSamples;
+            decoded += numSamples;
+            return true;
+        }
+
+    private:
+        const juce::AudioBuffer<float>& source;
+        const int warmUpFrames;
+        std::atomic<int64>& decoded;
+        int64 nextFrame { 0 };
+        int64 seekFrame { 0 };
+    };
+
+    void checkLappedCodec()
+    {
+        juce::AudioBuffer<float> source (2, numFrames);
+        TestFixtures::fillSines (source, noiseLevel);
+
+        const int numRanges = numFrames / (int) ParallelDecoder::framesPerRange;
+        const int64 splitCost = numFrames + (int64) (numRanges - 1) * ParallelDecoder::prerollFrames;
+
+        // warms up within the preroll, like a Vorbis block: every seam holds
+        // and nothing is decoded twice; and one that needs more than the
+        // preroll, where every seam fails and the caller decodes serially
+        for (int warmUp : { 2048, ParallelDecoder::prerollFrames + 4096 })
+        {
+            beginTest ("lapped codec warming up over " + juce::String (warmUp) + " frames: parallel decode matches the source");
+
+            std::atomic<int64> decoded { 0 };
+            const auto openReader = [&]
+            {
+                return std::unique_ptr<juce::AudioFormatReader> (new LappedReader (source, warmUp, decoded));
+            };
+
+            SampleData data;
+            data.lengthInSamples = numFrames;
+            data.buffer.setSize (2, numFrames);
+
+            {
+                LoaderPool pool (3);
+                auto reader = openReader();
+                expect (ParallelDecoder::decode (*reader, openReader, data, numFrames, ParallelDecoder::framesPerRead,
+                                                 pool, 0, nullptr, nullptr));
+            }
+
+            for (int ch = 0; ch < 2; ++ch)
+                expect (std::memcmp (source.getReadPointer (ch), data.buffer.getReadPointer (ch), (size_t) numFrames * sizeof (float)) == 0,
+                        "channel " + juce::String (ch) + " differs");
+
+            if (warmUp <= ParallelDecoder::prerollFrames)
+                expect (decoded.load() <= splitCost, "a seam failed and part of the file was decoded again");
+            else
+                expect (decoded.load() > splitCost, "seams that cannot match were accepted");
+        }
+    }
+
+    static constexpr double sampleRate = 44100.0;
+    static constexpr int numFrames = (int) ParallelDecoder::framesPerRange * 3 + 12345;
+
+    // low noise under the sines, so no two codec frames are alike
+    static constexpr float noiseLevel = 0.05f;
+
+    void checkFormat (const juce::File& directory, juce::AudioFormat& format, int bitsPerSample, int qualityIndex)
+    {
+        beginTest (format.getFormatName() + ": parallel decode matches a serial decode");
+
+        const auto file = TestFixtures::writeSineFile (directory.getChildFile ("parallel" + format.getFileExtensions()[0]),
+                                                       sampleRate, numFrames, bitsPerSample, &format, qualityIndex, noiseLevel);
+        const auto openReader = [&format, file]
+        {
+            return std::unique_ptr<juce::AudioFormatReader> (format.createReaderFor (new juce::FileInputStream (file), true));
+        };
+
+        auto reader = openReader();
+        expect (reader != nullptr, "could not write or reopen the fixture");
+        if (reader == nullptr)
+            return;
+
+        const int length = (int) reader->lengthInSamples;
+        juce::AudioBuffer<float> serial (2, length);
+        reader->read (&serial, 0, length, 0, true, true);
+
+        SampleData data;
+        data.lengthInSamples = length;
+        data.buffer.setSize (2, length);
+
+        LoaderPool pool (3);
+        reader = openReader();
+        expect (ParallelDecoder::decode (*reader, openReader, data, length, ParallelDecoder::framesPerRead,
+                                         pool, 0, nullptr, nullptr));
+        expect (data.framesLoaded.load() >= (int64) length);
+
+        for (int ch = 0; ch < 2; ++ch)
+            expect (std::memcmp (serial.getReadPointer (ch), data.buffer.getReadPointer (ch), (size_t) length * sizeof (float)) == 0,
+                    "channel " + juce::String (ch) + " differs");
+
+        beginTest (format.getFormatName() + ": a range's preroll makes its seam sample-exact");
+
+        const int numRanges = juce::jlimit (1, ParallelDecoder::maxRanges, length / (int) ParallelDecoder::framesPerRange);
+        expect (numRanges > 1);
+
+        constexpr int framesAfterSeam = 4096;
+        juce::AudioBuffer<float> piece (2, ParallelDecoder::prerollFrames + framesAfterSeam);
+
+        for (int i = 1; i < numRanges; ++i)
+        {
+            const int start = (int) ((int64) length * i / numRanges);
+            const int checkFrom = start - ParallelDecoder::seamCheckFrames;
+
+            auto rangeReader = openReader();
+            rangeReader->read (&piece, 0, piece.getNumSamples(), start - ParallelDecoder::prerollFrames, true, true);
+
+            for (int ch = 0; ch < 2; ++ch)
+                expect (std::memcmp (serial.getReadPointer (ch, checkFrom),
+                                     piece.getReadPointer (ch, ParallelDecoder::prerollFrames - ParallelDecoder::seamCheckFrames),
+                                     (size_t) (ParallelDecoder::seamCheckFrames + framesAfterSeam) * sizeof (float)) == 0,
+                        "range " + juce::String (i) + " channel " + juce::String (ch) + " differs after its preroll");
+        }
+    }
+};
+
+static ParallelDecoderTests parallelDecoderTests;
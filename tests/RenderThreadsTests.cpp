@@ -0,0 +1,92 @@
+#include <JuceHeader.h>
+#include <cstring>
+#include <vector>
+#include "SamplerEngine.h"
+#include "TestFixtures.h"
+
+// Render workers must not change the output: the same players and MIDI
+// rendered on the audio thread alone and on four threads give the same bits.
+class RenderThreadsTests : public juce::UnitTest
+{
+public:
+    RenderThreadsTests() : juce::UnitTest ("RenderThreads", "Sampler") {}
+
+    void runTest() override
+    {
+        const TestFixtures::ScopedTempDirectory tempDirectory ("RenderThreads");
+        const auto file = TestFixtures::writeSineFile (tempDirectory.getChildFile ("render.wav"),
+                                                       sampleRate, (int) sampleRate * 2, 24);
+
+        beginTest ("one thread and four threads render identical output");
+        {
+            const auto single = render (file, 0);
+            const auto four = render (file, 3);
+
+            expect (single.size() == four.size());
+            expect (std::memcmp (single.data(), four.data(), single.size() * sizeof (float)) == 0,
+                    "output differs with render workers");
+
+            float peak = 0.0f;
+            for (auto s : single)
+                peak = juce::jmax (peak, std::abs (s));
+            expect (peak > 0.01f, "render was silent");
+        }
+    }
+
+private:
+    static constexpr double sampleRate = 48000.0;
+    static constexpr int maxBlockSize = 256;
+    static constexpr int numPlayers = 24;
+
+    // Renders a fixed MIDI sequence through players spread over two output
+    // buses, with assorted gains, root keys and interpolation modes, in
+    // blocks of varying size. Returns every output sample in order.
+    static std::vector<float> render (const juce::File& file, int renderThreads)
+    {
+        SamplerEngine engine;
+        engine.prepareToPlay (sampleRate, maxBlockSize);
+        engine.setRenderThreads (renderThreads);
+
+        const char* modes[] = { "linear", "hermite", "sinc" };
+        for (int i = 0; i < numPlayers; ++i)
+        {
+            const int id = engine.addSamplePlayer();
+            engine.setMidiRange (id, 0, 127);
+            engine.setGain (id, 0.2f + 0.05f * (float) i);
+            engine.setPitchSettings (id, 48 + i % 24, modes[i % 3]);
+            engine.setOutputBus (id, i % 2);
+            engine.loadSampleAsync (id, file, nullptr);
+        }
+
+        while (engine.getLoadProgress().size() > 0)
+            juce::Thread::sleep (5);
+
+        const SamplerEngine::OutputBus buses[] = { { 0, 2 }, { 2, 2 } };
+        const int blockSizes[] = { maxBlockSize, 37, 128 };
+
+        juce::AudioBuffer<float> buffer (4, maxBlockSize);
+        juce::MidiBuffer midi;
+        std::vector<float> output;
+
+        for (int block = 0; block < 300; ++block)
+        {
+            const int numSamples = blockSizes[block % 3];
+            buffer.setSize (4, numSamples, false, false, true);
+
+            midi.clear();
+            if (block % 5 == 0)
+                midi.addEvent (juce::MidiMessage::noteOn (1, 40 + block % 36, (juce::uint8) (60 + block % 60)), block % numSamples);
+            if (block % 5 == 3)
+                midi.addEvent (juce::MidiMessage::noteOff (1, 40 + (block - 3) % 36), 0);
+
+            engine.processBlock (buffer, midi, buses, 2);
+
+            for (int ch = 0; ch < buffer.getNumChannels(); ++ch)
+                output.insert (output.end(), buffer.getReadPointer (ch), buffer.getReadPointer (ch) + numSamples);
+        }
+
+        return output;
+    }
+};
+
+static RenderThreadsTests renderThreadsTests;
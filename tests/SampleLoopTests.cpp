@@ -0,0 +1,142 @@
+#include <JuceHeader.h>
+#include <cmath>
+#include <cstring>
+#include <vector>
+#include "SampleLoop.h"
+
+// Reads through a loop's seam: plain sample frames up to the crossfade, the
+// baked crossfade up to the end, then straight back to the loop start, for
+// as many turns as are read at once.
+class SampleLoopTests : public juce::UnitTest
+{
+public:
+    SampleLoopTests() : juce::UnitTest ("SampleLoop", "Sampler") {}
+
+    void runTest() override
+    {
+        const auto data = makeData (10000);
+
+        beginTest ("wrap leaves frames before the end and folds later ones into the loop");
+        {
+            const auto loop = SampleLoop::create (*data, 1000, 3000, 0);
+            expect (loop != nullptr);
+            expectEquals (loop->wrap (0), (int64) 0);
+            expectEquals (loop->wrap (2999), (int64) 2999);
+            expectEquals (loop->wrap (3000), (int64) 1000);
+            expectEquals (loop->wrap (3000 + 2000 * 5 + 17), (int64) 1017);
+        }
+
+        beginTest ("without a crossfade, reads across several turns are the sample frames wrapped");
+        {
+            const auto loop = SampleLoop::create (*data, 1000, 1500, 0);
+            for (int ch = 0; ch < 2; ++ch)
+            {
+                const auto got = read (*loop, *data, ch, 900, 2345);
+                bool exact = true;
+                for (int i = 0; i < (int) got.size(); ++i)
+                    exact = exact && equalBits (got[(size_t) i], data->buffer.getSample (ch, (int) loop->wrap (900 + i)));
+                expect (exact, "channel " + juce::String (ch));
+            }
+        }
+
+        beginTest ("the seam blends the frames before the end into those before the start");
+        {
+            constexpr int crossfade = 200;
+            const auto loop = SampleLoop::create (*data, 1000, 3000, crossfade);
+            expectEquals (loop->seamStart, (int64) 3000 - crossfade);
+
+            for (int ch = 0; ch < 2; ++ch)
+            {
+                const auto got = read (*loop, *data, ch, 2700, 600);
+                float worst = 0.0f;
+
+                for (int i = 0; i < (int) got.size(); ++i)
+                {
+                    const int64 frame = loop->wrap (2700 + i);
+                    float expected = data->buffer.getSample (ch, (int) frame);
+
+                    if (frame >= loop->seamStart)
+                    {
+                        const int k = (int) (frame - loop->seamStart);
+                        const double t = ((double) k + 0.5) / crossfade * juce::MathConstants<double>::halfPi;
+                        expected = (float) (std::cos (t) * data->buffer.getSample (ch, (int) frame)
+                                            + std::sin (t) * data->buffer.getSample (ch, 1000 - crossfade + k));
+                    }
+
+                    worst = juce::jmax (worst, std::abs (got[(size_t) i] - expected));
+                }
+
+                expectLessThan (worst, 1.0e-6f);
+            }
+        }
+
+        beginTest ("a crossfade closes the jump a hard seam makes back to the loop start");
+        {
+            // a slow ramp jumps by the whole loop length at a hard seam
+            const auto ramp = makeData (10000, true);
+            const auto hard = SampleLoop::create (*ramp, 1000, 3000, 0);
+            const auto soft = SampleLoop::create (*ramp, 1000, 3000, 500);
+
+            const auto hardRun = read (*hard, *ramp, 0, 2990, 20);
+            const auto softRun = read (*soft, *ramp, 0, 2990, 20);
+            const float step = ramp->buffer.getSample (0, 1) - ramp->buffer.getSample (0, 0);
+
+            expectGreaterThan (std::abs (hardRun[10] - hardRun[9]), 1000.0f * step);
+            // the fade ends half a frame short of the lead-in, leaving a trace
+            // of the end frame in the last seam frame
+            expectLessThan (std::abs (softRun[10] - softRun[9]), 5.0f * step);
+        }
+
+        beginTest ("the crossfade is shortened to fit before the start and within the loop");
+        {
+            expectEquals (SampleLoop::create (*data, 100, 3000, 1000)->seam.getNumSamples(), 100);
+            expectEquals (SampleLoop::create (*data, 5000, 5300, 1000)->seam.getNumSamples(), 300);
+            expectEquals (SampleLoop::create (*data, 0, 3000, 1000)->seam.getNumSamples(), 0);
+        }
+
+        beginTest ("loops that are too short, or not all in RAM, are refused");
+        {
+            expect (SampleLoop::create (*data, 1000, 1001, 0) == nullptr);
+            expect (SampleLoop::create (*data, -1, 1000, 0) == nullptr);
+            expect (SampleLoop::create (*data, 9999, 20000, 0) == nullptr);
+
+            // the end is clamped to the sample
+            const auto clamped = SampleLoop::create (*data, 5000, 20000, 0);
+            expect (clamped != nullptr && clamped->end == 10000);
+
+            const auto partial = makeData (10000);
+            partial->framesLoaded.store (4000);
+            expect (SampleLoop::create (*partial, 1000, 3000, 0) != nullptr);
+            expect (SampleLoop::create (*partial, 1000, 5000, 0) == nullptr);
+        }
+    }
+
+private:
+    // Two channels, each of its own; a ramp on request.
+    static std::shared_ptr<SampleData> makeData (int numFrames, bool ramp = false)
+    {
+        auto data = std::make_shared<SampleData>();
+        data->sampleRate = 48000.0;
+        data->lengthInSamples = numFrames;
+        data->buffer.setSize (2, numFrames);
+
+        for (int i = 0; i < numFrames; ++i)
+        {
+            data->buffer.setSample (0, i, ramp ? (float) i * 1.0e-4f : 0.5f * std::sin ((float) i * 0.031f));
+            data->buffer.setSample (1, i, ramp ? (float) -i * 1.0e-4f : 0.5f * std::sin ((float) i * 0.017f));
+        }
+
+        return data;
+    }
+
+    static std::vector<float> read (const SampleLoop& loop, const SampleData& data, int channel, int64 first, int count)
+    {
+        std::vector<float> out ((size_t) count);
+        loop.read (data, channel, first, count, out.data());
+        return out;
+    }
+
+    static bool equalBits (float a, float b) { return std::memcmp (&a, &b, sizeof (float)) == 0; }
+};
+
+static SampleLoopTests sampleLoopTests;
@@ -0,0 +1,19 @@
+// Unit tests for the sampler engine. Each test registers itself as a
+// juce::UnitTest; this runs all of them and fails if any expectation did.
+//
+//   SamplerTests
+
+#include <JuceHeader.h>
+
+int main()
+{
+    juce::UnitTestRunner runner;
+    runner.setAssertOnFailure (false);
+    runner.runAllTests();
+
+    int failures = 0;
+    for (int i = 0; i < runner.getNumResults(); ++i)
+        failures += runner.getResult (i)->failures;
+
+    return failures > 0 ? 1 : 0;
+}
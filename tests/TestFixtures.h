@@ -0,0 +1,76 @@
+#pragma once
+
+#include <JuceHeader.h>
+#include <memory>
+
+// Scratch directories and audio files for the unit tests and SamplerBench.
+namespace TestFixtures
+{
+    // A new directory under the temp directory, deleted with everything in
+    // it when this goes out of scope. Each test makes its own, so no test
+    // can remove another's files.
+    class ScopedTempDirectory
+    {
+    public:
+        explicit ScopedTempDirectory (const juce::String& name)
+            : directory (juce::File::getSpecialLocation (juce::File::tempDirectory)
+                             .getNonexistentChildFile ("SamplerTests_" + name, {}, false))
+        {
+            directory.createDirectory();
+        }
+
+        ~ScopedTempDirectory() { directory.deleteRecursively(); }
+
+        const juce::File& getDirectory() const noexcept { return directory; }
+        juce::File getChildFile (const juce::String& name) const { return directory.getChildFile (name); }
+
+    private:
+        const juce::File directory;
+
+        JUCE_DECLARE_NON_COPYABLE (ScopedTempDirectory)
+    };
+
+    // Two detuned sines, one per channel, so every frame differs and nothing
+    // can take a shortcut on silence. noiseLevel adds seeded noise on top,
+    // so no two blocks of a compressed file are alike either.
+    inline void fillSines (juce::AudioBuffer<float>& audio, float noiseLevel = 0.0f)
+    {
+        juce::Random random (1234);
+        for (int i = 0; i < audio.getNumSamples(); ++i)
+            for (int ch = 0; ch < audio.getNumChannels(); ++ch)
+                audio.setSample (ch, i, 0.45f * std::sin ((float) i * (ch == 0 ? 0.031f : 0.029f))
+                                          + noiseLevel * (random.nextFloat() - 0.5f));
+    }
+
+    // Writes audio to file, as a WAV unless another format is given. Returns
+    // false if the format cannot write these settings.
+    inline bool writeAudioFile (const juce::File& file, const juce::AudioBuffer<float>& audio, double sampleRate,
+                                int bitsPerSample = 16, juce::AudioFormat* format = nullptr, int qualityIndex = 0)
+    {
+        file.deleteFile();
+
+        juce::WavAudioFormat wav;
+        auto& writerFormat = format != nullptr ? *format : static_cast<juce::AudioFormat&> (wav);
+
+        // the writer owns the stream only once it has been created
+        auto stream = std::make_unique<juce::FileOutputStream> (file);
+        std::unique_ptr<juce::AudioFormatWriter> writer (writerFormat.createWriterFor (stream.get(), sampleRate,
+                                                                                       (unsigned int) audio.getNumChannels(),
+                                                                                       bitsPerSample, {}, qualityIndex));
+        if (writer == nullptr)
+            return false;
+
+        stream.release();
+        return writer->writeFromAudioSampleBuffer (audio, 0, audio.getNumSamples());
+    }
+
+    // A stereo file of fillSines; returns {} if it could not be written.
+    inline juce::File writeSineFile (const juce::File& file, double sampleRate, int numFrames,
+                                     int bitsPerSample = 16, juce::AudioFormat* format = nullptr, int qualityIndex = 0,
+                                     float noiseLevel = 0.0f)
+    {
+        juce::AudioBuffer<float> audio (2, numFrames);
+        fillSines (audio, noiseLevel);
+        return writeAudioFile (file, audio, sampleRate, bitsPerSample, format, qualityIndex) ? file : juce::File();
+    }
+}
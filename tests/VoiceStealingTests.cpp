@@ -0,0 +1,129 @@
+#include <JuceHeader.h>
+#include <vector>
+#include "SamplerEngine.h"
+#include "TestFixtures.h"
+
+// Which voice makes room at full polyphony, under each steal policy. Every
+// note plays the same file at its own pitch, so the voices left sounding
+// can be told apart: once the stolen voice has faded, the output must match
+// a render in which it never played, and differ from one in which another
+// voice was stolen instead.
+class VoiceStealingTests : public juce::UnitTest
+{
+public:
+    VoiceStealingTests() : juce::UnitTest ("VoiceStealing", "Sampler") {}
+
+    void runTest() override
+    {
+        const TestFixtures::ScopedTempDirectory tempDirectory ("VoiceStealing");
+        file = TestFixtures::writeSineFile (tempDirectory.getChildFile ("voices.wav"), sampleRate, (int) sampleRate * 2);
+
+        const Note a { 0, 60, 127 }, b { 2, 64, 127 }, c { 4, 67, 127 };
+
+        beginTest ("oldest steals the first note");
+        checkSteal ("oldest", 2, {}, { a, b, c }, { b, c }, { a, c });
+
+        beginTest ("quietest steals the softest note, not the oldest");
+        {
+            const Note soft { 2, 64, 20 };
+            checkSteal ("quietest", 2, {}, { a, soft, c }, { a, c }, { soft, c });
+        }
+
+        beginTest ("a released note is stolen before an older held one");
+        {
+            SamplePlayer::Envelope envelope;
+            envelope.oneShot = false;
+            envelope.releaseMs = 1000.0f;
+            const Note releasedB { 2, 64, 127, 3 };
+            checkSteal ("oldest", 2, envelope, { a, releasedB, c }, { a, c }, { releasedB, c });
+        }
+
+        beginTest ("sameNote fades the note being replayed, below full polyphony");
+        {
+            const Note again { 4, 60, 127 };
+            checkSteal ("sameNote", 4, {}, { a, b, again }, { b, again }, { a, b, again });
+        }
+
+        beginTest ("sameNote steals the oldest other note at full polyphony");
+        checkSteal ("sameNote", 2, {}, { a, b, c }, { b, c }, { a, c });
+
+        file = {};
+    }
+
+private:
+    static constexpr double sampleRate = 48000.0;
+    static constexpr int blockSize = 256;
+    static constexpr int numBlocks = 24;
+    static constexpr int firstCompared = 8;   // well past the 5 ms fade of a stolen voice
+
+    struct Note
+    {
+        int block;
+        int note;
+        int velocity;
+        int offBlock { -1 };   // none if negative
+    };
+
+    juce::File file;
+
+    // Renders `notes` under the policy, and the expected and wrong survivors
+    // with room for every voice and a policy that never steals below full
+    // polyphony, then compares them after the steal.
+    void checkSteal (const juce::String& policy, int polyphony, const SamplePlayer::Envelope& envelope,
+                     const std::vector<Note>& notes, const std::vector<Note>& survivors, const std::vector<Note>& wrongSurvivors)
+    {
+        const auto output = render (policy, polyphony, envelope, notes);
+        const auto expected = render ("oldest", SamplePlayer::maxPolyphony, envelope, survivors);
+        const auto wrong = render ("oldest", SamplePlayer::maxPolyphony, envelope, wrongSurvivors);
+
+        expect (matches (output, expected), "the wrong voice was stolen, or none");
+        expect (! matches (output, wrong), "the renders cannot tell the voices apart");
+    }
+
+    std::vector<float> render (const juce::String& policy, int polyphony, const SamplePlayer::Envelope& envelope,
+                               const std::vector<Note>& notes) const
+    {
+        SamplerEngine engine;
+        engine.prepareToPlay (sampleRate, blockSize);
+        const int id = engine.addSamplePlayer();
+        engine.setMidiRange (id, 0, 127);
+        engine.setVelocityCurve (id, "linear");
+        engine.setVoiceSettings (id, polyphony, policy);
+        engine.setEnvelope (id, envelope);
+        engine.loadSampleAsync (id, file, nullptr);
+        while (engine.getLoadProgress().size() > 0)
+            juce::Thread::sleep (5);
+
+        juce::AudioBuffer<float> buffer (2, blockSize);
+        juce::MidiBuffer midi;
+        std::vector<float> output;
+
+        for (int block = 0; block < numBlocks; ++block)
+        {
+            midi.clear();
+            for (const auto& n : notes)
+            {
+                if (n.block == block)
+                    midi.addEvent (juce::MidiMessage::noteOn (1, n.note, (juce::uint8) n.velocity), 0);
+                if (n.offBlock == block)
+                    midi.addEvent (juce::MidiMessage::noteOff (1, n.note), 0);
+            }
+
+            engine.processBlock (buffer, midi);
+            output.insert (output.end(), buffer.getReadPointer (0), buffer.getReadPointer (0) + blockSize);
+        }
+
+        return output;
+    }
+
+    // Voices may be summed in another order, so allow for rounding.
+    static bool matches (const std::vector<float>& x, const std::vector<float>& y)
+    {
+        for (size_t i = (size_t) (firstCompared * blockSize); i < x.size(); ++i)
+            if (std::abs (x[i] - y[i]) > 1.0e-5f)
+                return false;
+        return true;
+    }
+};
+
+static VoiceStealingTests voiceStealingTests;
@@ -0,0 +1,148 @@
+#include <JuceHeader.h>
+#include <vector>
+#include "ZoneMap.h"
+
+// Lookups in a zone map: which zones a note and velocity reach, how they
+// split into round-robin steps, and the gain each velocity curve gives.
+class ZoneMapTests : public juce::UnitTest
+{
+public:
+    ZoneMapTests() : juce::UnitTest ("ZoneMap", "Sampler") {}
+
+    void runTest() override
+    {
+        beginTest ("velocity layers meet without a gap or overlap");
+        {
+            const ZoneMap map (makeEntries ({ makeZone (40, 80, 1, 63), makeZone (40, 80, 64, 127) }), VelocityCurve::fixed);
+
+            expect (lookup (map, 60, 1) == Steps { { 10 } });
+            expect (lookup (map, 60, 63) == Steps { { 10 } });
+            expect (lookup (map, 60, 64) == Steps { { 11 } });
+            expect (lookup (map, 60, 127) == Steps { { 11 } });
+            expect (lookup (map, 40, 100) == Steps { { 11 } });
+            expect (lookup (map, 80, 20) == Steps { { 10 } });
+        }
+
+        beginTest ("notes and velocities outside every zone find nothing");
+        {
+            const ZoneMap map (makeEntries ({ makeZone (40, 80, 1, 127) }), VelocityCurve::fixed);
+
+            expectEquals (map.getNumSteps (39, 100), 0);
+            expectEquals (map.getNumSteps (81, 100), 0);
+            expectEquals (map.getNumSteps (60, 0), 0);
+            expectEquals (ZoneMap ({}, VelocityCurve::fixed).getNumSteps (60, 100), 0);
+        }
+
+        beginTest ("out-of-range notes and velocities are clamped");
+        {
+            const ZoneMap map (makeEntries ({ makeZone (0, 127, 1, 127) }), VelocityCurve::fixed);
+
+            expect (lookup (map, -5, 200) == Steps { { 10 } });
+            expect (lookup (map, 300, 64) == Steps { { 10 } });
+        }
+
+        beginTest ("round robin steps follow the zones' order, and equal values layer");
+        {
+            const ZoneMap map (makeEntries ({ makeZone (0, 127, 1, 127, 2),
+                                              makeZone (0, 127, 1, 127, 0),
+                                              makeZone (0, 127, 1, 127, 1),
+                                              makeZone (0, 127, 1, 127, 0) }),
+                               VelocityCurve::fixed);
+
+            expect (lookup (map, 60, 100) == Steps { { 11, 13 }, { 12 }, { 10 } });
+        }
+
+        beginTest ("a zone joins the cycle only on its own keys and velocities");
+        {
+            const ZoneMap map (makeEntries ({ makeZone (0, 127, 1, 127, 0),
+                                              makeZone (60, 72, 1, 127, 1),
+                                              makeZone (0, 127, 100, 127, 2) }),
+                               VelocityCurve::fixed);
+
+            expect (lookup (map, 50, 50) == Steps { { 10 } });
+            expect (lookup (map, 60, 50) == Steps { { 10 }, { 11 } });
+            expect (lookup (map, 50, 110) == Steps { { 10 }, { 12 } });
+            expect (lookup (map, 72, 110) == Steps { { 10 }, { 11 }, { 12 } });
+        }
+
+        beginTest ("entries are found by zone id and source");
+        {
+            auto entries = makeEntries ({ makeZone (0, 127, 1, 127), makeZone (0, 127, 1, 127) });
+            entries[1].source = std::make_shared<SampleData>();
+            const auto* source = entries[1].source.get();
+            const ZoneMap map (std::move (entries), VelocityCurve::fixed);
+
+            expectEquals (map.findEntry (11, source), 1);
+            expectEquals (map.findEntry (10, source), -1);
+            expectEquals (map.findEntry (11, nullptr), -1);
+            expectEquals (map.findEntry (99, source), -1);
+        }
+
+        beginTest ("velocity curves");
+        {
+            const ZoneMap fixed ({}, VelocityCurve::fixed), linear ({}, VelocityCurve::linear),
+                          soft ({}, VelocityCurve::soft), hard ({}, VelocityCurve::hard);
+
+            for (int v : { 1, 32, 64, 127 })
+            {
+                const float x = (float) v / 127.0f;
+                expectEquals (fixed.getVelocityGain (v), 1.0f);
+                expectWithinAbsoluteError (linear.getVelocityGain (v), x, 1.0e-6f);
+                expectWithinAbsoluteError (soft.getVelocityGain (v), std::sqrt (x), 1.0e-6f);
+                expectWithinAbsoluteError (hard.getVelocityGain (v), x * x, 1.0e-6f);
+            }
+
+            expectEquals (linear.getVelocityGain (200), 1.0f);
+            expectEquals (linear.getVelocityGain (-1), 0.0f);
+
+            for (auto curve : { VelocityCurve::fixed, VelocityCurve::linear, VelocityCurve::soft, VelocityCurve::hard })
+                expect (ZoneMap::curveFromString (ZoneMap::curveToString (curve)) == curve);
+            expect (ZoneMap::curveFromString ("no such curve") == VelocityCurve::fixed);
+        }
+    }
+
+private:
+    // the zone ids of each round-robin step, in step order
+    using Steps = std::vector<std::vector<int>>;
+
+    static Zone makeZone (int keyLow, int keyHigh, int velocityLow, int velocityHigh, int roundRobin = 0)
+    {
+        Zone zone;
+        zone.keyLow = keyLow;
+        zone.keyHigh = keyHigh;
+        zone.velocityLow = velocityLow;
+        zone.velocityHigh = velocityHigh;
+        zone.roundRobin = roundRobin;
+        return zone;
+    }
+
+    // Entry i gets zone id 10 + i, so ids and entry indices cannot be confused.
+    static std::vector<ZoneMap::Entry> makeEntries (const std::vector<Zone>& zones)
+    {
+        std::vector<ZoneMap::Entry> entries (zones.size());
+        for (size_t i = 0; i < zones.size(); ++i)
+        {
+            entries[i].zoneId = 10 + (int) i;
+            entries[i].zone = zones[i];
+        }
+        return entries;
+    }
+
+    static Steps lookup (const ZoneMap& map, int note, int velocity)
+    {
+        Steps steps;
+        for (int step = 0; step < map.getNumSteps (note, velocity); ++step)
+        {
+            int count = 0;
+            const auto* indices = map.getStepEntries (note, velocity, step, count);
+
+            std::vector<int> ids;
+            for (int i = 0; i < count; ++i)
+                ids.push_back (map.getEntry (indices[i]).zoneId);
+            steps.push_back (ids);
+        }
+        return steps;
+    }
+};
+
+static ZoneMapTests zoneMapTests;